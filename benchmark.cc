@@ -0,0 +1,485 @@
+/******************************************************************************
+  Copyright 2010 Todd Sundsted. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY TODD SUNDSTED ``AS IS'' AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+  EVENT SHALL TODD SUNDSTED OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+  OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  The views and conclusions contained in the software and documentation are
+  those of the authors and should not be interpreted as representing official
+  policies, either expressed or implied, of Todd Sundsted.
+ *****************************************************************************/
+
+/* Micro-benchmarks for the server's hot paths.
+ *
+ * Loads a database the way the server does and then times allocation,
+ * value operations, database lookups, command parsing and the
+ * interpreter on small MOO programs.  Nothing is ever written back to the
+ * database.  Each benchmark is repeated, doubling the number of
+ * iterations, until a run takes at least the minimum time; its result
+ * is printed on standard output as a single line of JSON:
+ *
+ *   {"benchmark": "maplookup", "iterations": 4194304, "seconds": 0.31,
+ *    "ns_per_op": 73.9}
+ *
+ * Log messages go to standard error, as they do for the server.  Build
+ * with `make moo_bench' and run with `make benchmark', or directly:
+ *
+ *   ./moo_bench [-t min-seconds] [-b benchmark] database
+ */
+
+#include "my-stdio.h"
+#include "my-stdlib.h"
+#include "my-string.h"
+#include "my-sys-time.h"
+
+#include "db.h"
+#include "execute.h"
+#include "functions.h"
+#include "list.h"
+#include "log.h"
+#include "map.h"
+#include "parse_cmd.h"
+#include "parser.h"
+#include "program.h"
+#include "server.h"
+#include "storage.h"
+#include "str_intern.h"
+#include "structures.h"
+#include "tasks.h"
+#include "utils.h"
+
+#define NKEYS		4096	/* distinct keys for maps and interning */
+
+static Objid wizard = NOTHING;
+static const char *keys[NKEYS];
+static Var big_map;
+
+/* Targets for the database lookups, found by `find_targets()'. */
+static Objid prop_obj = NOTHING, verb_obj = NOTHING;
+static char prop_name[64], verb_name[64];
+
+static double
+now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**** storage ****/
+
+static void
+bench_alloc(long n)
+{
+    /* a sliding window of small strings and lists of assorted sizes */
+    static const int sizes[] = {1, 7, 12, 24, 40, 3, 90, 17};
+    Var window[64];
+    long i;
+
+    for (i = 0; i < 64; i++)
+	window[i] = new_list(0);
+    for (i = 0; i < n; i++) {
+	int size = sizes[i % 8];
+
+	free_var(window[i % 64]);
+	if (i % 2) {
+	    window[i % 64].type = TYPE_STR;
+	    window[i % 64].v.str = (char *)mymalloc(size, M_STRING);
+	    ((char *)window[i % 64].v.str)[0] = '\0';
+	} else
+	    window[i % 64] = new_list(size % 8);
+    }
+    for (i = 0; i < 64; i++)
+	free_var(window[i]);
+}
+
+/**** value operations ****/
+
+static void
+bench_listappend(long n)
+{
+    Var list = new_list(0);
+    long i;
+
+    for (i = 0; i < n; i++) {
+	if (i % 1000 == 0) {
+	    free_var(list);
+	    list = new_list(0);
+	}
+	list = listappend(list, Var::new_int(i));
+    }
+    free_var(list);
+}
+
+static void
+bench_listconcat(long n)
+{
+    Var a = new_list(100), b = new_list(100);
+    long i;
+
+    for (i = 1; i <= 100; i++) {
+	a.v.list[i] = Var::new_int(i);
+	b.v.list[i] = str_dup_to_var(keys[i]);
+    }
+    for (i = 0; i < n; i++)
+	free_var(listconcat(var_ref(a), var_ref(b)));
+    free_var(a);
+    free_var(b);
+}
+
+static void
+bench_mapinsert(long n)
+{
+    Var map = new_map();
+    long i;
+
+    for (i = 0; i < n; i++) {
+	if (i % 1000 == 0) {
+	    free_var(map);
+	    map = new_map();
+	}
+	map = mapinsert(map, str_ref_to_var(keys[(i * 7) % NKEYS]),
+			Var::new_int(i));
+    }
+    free_var(map);
+}
+
+static void
+bench_maplookup(long n)
+{
+    Var key, value;
+    long i;
+
+    key.type = TYPE_STR;
+    for (i = 0; i < n; i++) {
+	key.v.str = keys[(i * 7919) % NKEYS];
+	if (!maplookup(big_map, key, &value, 0))
+	    panic("BENCH_MAPLOOKUP: missing key");
+    }
+}
+
+static void
+bench_str_intern(long n)
+{
+    long i;
+
+    str_intern_open(NKEYS);
+    for (i = 0; i < n; i++)
+	free_str(str_intern(keys[i % NKEYS]));
+    str_intern_close();
+}
+
+/**** database lookups ****/
+
+static void
+bench_db_find_property(long n)
+{
+    Var obj = Var::new_obj(prop_obj), value;
+    long i;
+
+    for (i = 0; i < n; i++)
+	if (!db_find_property(obj, prop_name, &value).ptr)
+	    panic("BENCH_DB_FIND_PROPERTY: missing property");
+}
+
+static void
+bench_db_find_callable_verb(long n)
+{
+    Var obj = Var::new_obj(verb_obj);
+    long i;
+
+    for (i = 0; i < n; i++)
+	if (!db_find_callable_verb(obj, verb_name).ptr)
+	    panic("BENCH_DB_FIND_CALLABLE_VERB: missing verb");
+}
+
+static void
+bench_parse_command(long n)
+{
+    long i;
+
+    for (i = 0; i < n; i++)
+	free_parsed_command(parse_command("put the red ball in the box",
+					  wizard));
+}
+
+/**** the interpreter ****/
+
+static Program *
+compile(const char *source)
+{
+    Var code = new_list(1), errors;
+    Program *prog;
+
+    code.v.list[1] = str_dup_to_var(source);
+    prog = parse_list_as_program(code, &errors);
+    free_var(code);
+    if (!prog)
+	panic("BENCH: benchmark program doesn't compile");
+    free_var(errors);
+
+    return prog;
+}
+
+static void
+run_program(long n, const char *source)
+{
+    Program *prog = compile(source);
+    Var result;
+    long i;
+
+    for (i = 0; i < n; i++) {
+	if (run_server_program_task(NOTHING, "benchmark", new_list(0),
+				    NOTHING, "benchmark", prog, wizard, 1,
+				    wizard, "", &result) != OUTCOME_DONE)
+	    panic("BENCH: benchmark program didn't finish");
+	free_var(result);
+    }
+    free_program(prog);
+}
+
+static void
+bench_run_arith(long n)
+{
+    run_program(n, "x = 0; for i in [1..100] x = x + i * 2 - 1; endfor "
+		"return x;");
+}
+
+static void
+bench_run_float(long n)
+{
+    run_program(n, "x = 0.0; v = 1.5; for i in [1..100] "
+		"x = x * 0.5 + v * 2.0 - 1.0; endfor return x;");
+}
+
+static void
+bench_run_list(long n)
+{
+    run_program(n, "l = {}; for i in [1..100] l = {@l, i}; endfor "
+		"return l[$];");
+}
+
+static void
+bench_run_string(long n)
+{
+    run_program(n, "s = \"\"; for i in [1..100] s = s + tostr(i); "
+		"endfor return length(s);");
+}
+
+static void
+bench_run_map(long n)
+{
+    run_program(n, "m = []; for i in [1..100] m[i] = i; endfor "
+		"for i in [1..100] m[i] = m[i] + 1; endfor return m[100];");
+}
+
+static struct {
+    const char *name;
+    void (*func) (long n);
+} benchmarks[] = {
+    {"alloc", bench_alloc},
+    {"listappend", bench_listappend},
+    {"listconcat", bench_listconcat},
+    {"mapinsert", bench_mapinsert},
+    {"maplookup", bench_maplookup},
+    {"str_intern", bench_str_intern},
+    {"db_find_property", bench_db_find_property},
+    {"db_find_callable_verb", bench_db_find_callable_verb},
+    {"parse_command", bench_parse_command},
+    {"run_arith", bench_run_arith},
+    {"run_float", bench_run_float},
+    {"run_list", bench_run_list},
+    {"run_string", bench_run_string},
+    {"run_map", bench_run_map},
+};
+
+/**** setup ****/
+
+static int
+first_name(void *data, const char *names)
+{
+    char *name = (char *) data;
+    int i;
+
+    for (i = 0; i < 63 && names[0] && names[0] != ' '; names++)
+	if (names[0] != '*')
+	    name[i++] = names[0];
+    name[i] = '\0';
+
+    return 1;			/* stop after the first */
+}
+
+/* Finds an object to look up `*name' on, preferring one that inherits
+ * it, so that the lookup has to search the ancestors as most lookups
+ * in a real core do.  Falls back on an object that defines it.
+ */
+static Objid
+find_target(int (*for_all) (Var, int (*)(void *, const char *), void *),
+	    char *name)
+{
+    Objid oid, max = db_last_used_objid(), found = NOTHING;
+
+    for (oid = 0; oid <= max; oid++) {
+	Var parents;
+
+	if (!valid(oid))
+	    continue;
+	parents = db_object_parents(oid);
+	if (parents.type == TYPE_LIST && parents.v.list[0].v.num > 0)
+	    parents = parents.v.list[1];
+	if (parents.type == TYPE_OBJ && valid(parents.v.obj)
+	    && (*for_all) (parents, first_name, name))
+	    return oid;
+	if (found == NOTHING && (*for_all) (Var::new_obj(oid), first_name,
+					    name))
+	    found = oid;
+    }
+
+    if (found != NOTHING)
+	(*for_all) (Var::new_obj(found), first_name, name);
+
+    return found;
+}
+
+static void
+find_targets(void)
+{
+    Objid oid, max = db_last_used_objid();
+
+    prop_obj = find_target(db_for_all_propdefs, prop_name);
+    verb_obj = find_target(db_for_all_verbs, verb_name);
+    if (verb_obj != NOTHING
+	&& !db_find_callable_verb(Var::new_obj(verb_obj), verb_name).ptr)
+	verb_obj = NOTHING;	/* not executable */
+
+    for (oid = 0; oid <= max && wizard == NOTHING; oid++)
+	if (valid(oid) && is_wizard(oid))
+	    wizard = oid;
+}
+
+static void
+setup_values(void)
+{
+    char buffer[32];
+    int i;
+
+    big_map = new_map();
+    for (i = 0; i < NKEYS; i++) {
+	sprintf(buffer, "key-%d", i);
+	keys[i] = str_dup(buffer);
+	big_map = mapinsert(big_map, str_ref_to_var(keys[i]),
+			    Var::new_int(i));
+    }
+}
+
+static int
+disabled(const char *name)
+{
+    if (!strcmp(name, "db_find_property"))
+	return prop_obj == NOTHING;
+    if (!strcmp(name, "db_find_callable_verb"))
+	return verb_obj == NOTHING;
+    if (!strcmp(name, "parse_command") || !strncmp(name, "run_", 4))
+	return wizard == NOTHING;
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *this_program = argv[0];
+    const char *only = 0;
+    double min_time = 0.25;
+    char *db_args[2];
+    char **pargv = db_args;
+    int pargc = 2;
+    int ran = 0;
+    unsigned i;
+
+    for (argc--, argv++; argc > 1 && argv[0][0] == '-'; argc -= 2, argv += 2) {
+	if (!strcmp(argv[0], "-t"))
+	    min_time = atof(argv[1]);
+	else if (!strcmp(argv[0], "-b"))
+	    only = argv[1];
+	else
+	    break;
+    }
+    if (argc != 1 || min_time <= 0) {
+	fprintf(stderr, "Usage: %s [-t min-seconds] [-b benchmark] database\n",
+		this_program);
+	exit(1);
+    }
+
+    set_log_file(stderr);
+
+    db_args[0] = argv[0];
+    db_args[1] = (char *) "/dev/null";	/* never dumped */
+    if (!db_initialize(&pargc, &pargv))
+	exit(1);
+
+    register_bi_functions();
+
+    if (!db_load())
+	exit(1);
+
+    free_reordered_rt_env_values();
+
+    load_server_options();
+
+    find_targets();
+    setup_values();
+
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+	const char *name = benchmarks[i].name;
+	double start, elapsed;
+	long n = 1000;
+
+	if (only && strcmp(only, name))
+	    continue;
+	ran++;
+	if (disabled(name)) {
+	    errlog("BENCH: %s: nothing suitable in the database\n", name);
+	    continue;
+	}
+
+	for (;;) {
+	    start = now();
+	    (*benchmarks[i].func) (n);
+	    elapsed = now() - start;
+	    if (elapsed >= min_time || n >= (1L << 30))
+		break;
+	    n *= 2;
+	}
+
+	printf("{\"benchmark\": \"%s\", \"iterations\": %ld, "
+	       "\"seconds\": %.6f, \"ns_per_op\": %.1f}\n",
+	       name, n, elapsed, elapsed * 1e9 / n);
+	fflush(stdout);
+    }
+
+    if (only && !ran) {
+	errlog("BENCH: no benchmark named `%s'\n", only);
+	exit(1);
+    }
+
+    return 0;
+}
@@ -18,12 +18,16 @@
 #include <limits.h>
 
 #include "ast.h"
+#include "code_gen.h"
+#include "functions.h"
+#include "numbers.h"
 #include "opcode.h"
 #include "program.h"
 #include "server.h"
 #include "storage.h"
 #include "structures.h"
 #include "str_intern.h"
+#include "sym_table.h"
 #include "utils.h"
 #include "version.h"
 #include "my-stdlib.h"
@@ -53,6 +57,15 @@ struct gstate {
     Var *literals;
     unsigned num_fork_vectors, max_fork_vectors;
     Bytecodes *fork_vectors;
+    unsigned num_prop_sites;	/* for sizing the property caches */
+    /* For CG_OPTIMIZE's dead store removal; the bit sets only cover the
+     * slots below NUM_READY_VARS.
+     */
+    unsigned first_user_slot;
+    unsigned max_slot;		/* highest variable slot used at all */
+    unsigned pushed;		/* slots whose values are ever pushed */
+    unsigned stored;		/* slots assigned in statements of their own */
+    unsigned dead;		/* ... whose assignments are left out */
 };
 typedef struct gstate GState;
 
@@ -66,6 +79,17 @@ struct loop {
 };
 typedef struct loop Loop;
 
+/* Where control goes after the last statement of a block, when that's a
+ * jump: back to the top of a loop, or to the end of an enclosing IF or
+ * TRY (whose chain of end labels is given).  With CG_OPTIMIZE, the jumps
+ * ending the arms of a statement in that position go there directly.
+ */
+struct tail {
+    const Fixup *top;
+    int *end_label;
+};
+typedef struct tail Tail;
+
 struct state {
     unsigned max_literal, max_fork, max_var_ref;
     /* For telling how big the refs must be */
@@ -103,6 +127,93 @@ typedef struct state State;
 #define DECR_TRY_DEPTH(SSS)
 #endif				/* BYTECODE_REDUCE_REF */
 
+static unsigned features = CG_DEFAULT;
+
+/* Built-in functions that get opcodes of their own, for calls with
+ * exactly NARGS arguments (or any number, if NARGS is -1).  The
+ * interpreter falls back on the usual calling sequence whenever the
+ * function is protected.  Entries are in opcode order.
+ */
+static struct intrinsic {
+    Extended_Opcode eop;
+    const char *name;
+    int nargs;
+    unsigned func;		/* looked up on first use */
+} intrinsics[] = {
+    {EOP_BF_LENGTH, "length", 1},
+    {EOP_BF_TYPEOF, "typeof", 1},
+    {EOP_BF_VALID, "valid", 1},
+    {EOP_BF_IS_MEMBER, "is_member", 2},
+    {EOP_BF_LISTAPPEND, "listappend", 2},
+    {EOP_BF_TOSTR, "tostr", -1}
+};
+
+#define NUM_INTRINSICS	(sizeof(intrinsics) / sizeof(*intrinsics))
+
+static void
+init_intrinsics(void)
+{
+    static int initialized = 0;
+    unsigned i;
+
+    if (!initialized) {
+	for (i = 0; i < NUM_INTRINSICS; i++)
+	    intrinsics[i].func = number_func_by_name(intrinsics[i].name);
+	initialized = 1;
+    }
+}
+
+static struct intrinsic *
+find_intrinsic(Extended_Opcode eop)
+{
+    init_intrinsics();
+    if (eop >= EOP_BF_LENGTH && eop < EOP_BF_LENGTH + NUM_INTRINSICS)
+	return &intrinsics[eop - EOP_BF_LENGTH];
+    return 0;
+}
+
+unsigned
+intrinsic_func(Extended_Opcode eop)
+{
+    struct intrinsic *in = find_intrinsic(eop);
+
+    return in ? in->func : FUNC_NOT_FOUND;
+}
+
+int
+intrinsic_nargs(Extended_Opcode eop)
+{
+    struct intrinsic *in = find_intrinsic(eop);
+
+    return in ? in->nargs : 0;
+}
+
+/* Returns the intrinsic opcode for a call to FUNC with NARGS arguments,
+ * or EOP_BI_FUNC_CALL if there isn't one.
+ */
+static Extended_Opcode
+intrinsic_opcode(unsigned func, unsigned nargs)
+{
+    unsigned i;
+
+    init_intrinsics();
+    for (i = 0; i < NUM_INTRINSICS; i++)
+	if (intrinsics[i].func == func
+	    && (intrinsics[i].nargs == -1
+		|| intrinsics[i].nargs == (int) nargs))
+	    return intrinsics[i].eop;
+    return EOP_BI_FUNC_CALL;
+}
+
+unsigned
+set_code_gen_features(unsigned new_features)
+{
+    unsigned old = features;
+
+    features = new_features;
+    return old;
+}
+
 static void
 init_gstate(GState * gstate)
 {
@@ -111,6 +222,10 @@ init_gstate(GState * gstate)
     gstate->max_literals = gstate->max_fork_vectors = 0;
     gstate->fork_vectors = 0;
     gstate->literals = 0;
+    gstate->num_prop_sites = 0;
+    gstate->first_user_slot = 0;
+    gstate->max_slot = 0;
+    gstate->pushed = gstate->stored = gstate->dead = 0;
 }
 
 static void
@@ -323,6 +438,8 @@ add_var_ref(unsigned slot, State * state)
     state->num_var_refs++;
     if (slot > state->max_var_ref)
 	state->max_var_ref = slot;
+    if (slot > state->gstate->max_slot)
+	state->gstate->max_slot = slot;
     state->gstate->total_var_refs++;
 }
 
@@ -505,6 +622,13 @@ emit_ending_op(Opcode op, State * state)
 static void
 emit_var_op(Opcode op, unsigned slot, State * state)
 {
+    GState *gstate = state->gstate;
+
+    if (slot > gstate->max_slot)
+	gstate->max_slot = slot;
+    if (op == OP_PUSH && slot < NUM_READY_VARS)
+	gstate->pushed |= 1u << slot;
+
     if (slot >= NUM_READY_VARS) {
 	emit_byte(op + NUM_READY_VARS, state);
 	add_var_ref(slot, state);
@@ -586,6 +710,7 @@ push_lvalue(Expr * expr, int indexed_above, State * state)
 	generate_expr(expr->e.bin.rhs, state);
 	if (indexed_above) {
 	    emit_byte(OP_PUSH_GET_PROP, state);
+	    state->gstate->num_prop_sites++;
 	    push_stack(1, state);
 	}
 	break;
@@ -606,22 +731,80 @@ generate_codes(Arg_List * codes, State * state)
 }
 
 static void
-generate_expr(Expr * expr, State * state)
+generate_literal(Var v, State * state)
 {
+    if (v.type == TYPE_INT && IN_OPTIM_NUM_RANGE(v.v.num))
+	emit_byte(OPTIM_NUM_TO_OPCODE(v.v.num), state);
+    else {
+	emit_byte(OP_IMM, state);
+	add_literal(v, state);
+    }
+    push_stack(1, state);
+}
+
+/* With CG_OPTIMIZE, arithmetic on integer constants is done here instead
+ * of at run time, as long as it doesn't raise an error.  Returns true,
+ * with the value in *RESULT, if EXPR could be folded.
+ */
+static int
+fold_constant(Expr * expr, Var * result)
+{
+    Var lhs, rhs;
+
     switch (expr->kind) {
     case EXPR_VAR:
-	{
-	    Var v;
-
-	    v = expr->e.var;
-	    if (v.type == TYPE_INT && IN_OPTIM_NUM_RANGE(v.v.num))
-		emit_byte(OPTIM_NUM_TO_OPCODE(v.v.num), state);
-	    else {
-		emit_byte(OP_IMM, state);
-		add_literal(v, state);
-	    }
-	    push_stack(1, state);
+	*result = expr->e.var;
+	return result->type == TYPE_INT;
+    case EXPR_NEGATE:
+	if (!fold_constant(expr->e.expr, result))
+	    return 0;
+	result->v.num = -result->v.num;
+	return 1;
+    case EXPR_PLUS:
+    case EXPR_MINUS:
+    case EXPR_TIMES:
+    case EXPR_DIVIDE:
+    case EXPR_MOD:
+	if (!fold_constant(expr->e.bin.lhs, &lhs)
+	    || !fold_constant(expr->e.bin.rhs, &rhs))
+	    return 0;
+	switch (expr->kind) {
+	case EXPR_PLUS:
+	    *result = do_add(lhs, rhs);
+	    break;
+	case EXPR_MINUS:
+	    *result = do_subtract(lhs, rhs);
+	    break;
+	case EXPR_TIMES:
+	    *result = do_multiply(lhs, rhs);
+	    break;
+	case EXPR_DIVIDE:
+	    *result = do_divide(lhs, rhs);
+	    break;
+	default:
+	    *result = do_modulus(lhs, rhs);
+	    break;
 	}
+	return result->type == TYPE_INT;
+    default:
+	return 0;
+    }
+}
+
+static void
+generate_expr(Expr * expr, State * state)
+{
+    Var folded;
+
+    if ((features & CG_OPTIMIZE) && expr->kind != EXPR_VAR
+	&& fold_constant(expr, &folded)) {
+	generate_literal(folded, state);
+	return;
+    }
+
+    switch (expr->kind) {
+    case EXPR_VAR:
+	generate_literal(expr->e.var, state);
 	break;
     case EXPR_ID:
 	emit_var_op(OP_PUSH, expr->e.id, state);
@@ -706,6 +889,7 @@ generate_expr(Expr * expr, State * state)
 		break;
 	    case EXPR_PROP:
 		op = OP_GET_PROP;
+		state->gstate->num_prop_sites++;
 		break;
 	    default:
 		panic("Not a binary operator in GENERATE_EXPR()");
@@ -807,9 +991,33 @@ generate_expr(Expr * expr, State * state)
 	generate_arg_list(expr->e.list, state);
 	break;
     case EXPR_CALL:
-	generate_arg_list(expr->e.call.args, state);
-	emit_byte(OP_BI_FUNC_CALL, state);
-	emit_byte(expr->e.call.func, state);
+	{
+	    Arg_List *a;
+	    unsigned nargs = 0;
+
+	    for (a = expr->e.call.args; a; a = a->next, nargs++)
+		if (a->kind != ARG_NORMAL)
+		    break;
+	    if ((features & CG_STACK_ARGS) && !a && nargs <= 255) {
+		Extended_Opcode eop = EOP_BI_FUNC_CALL;
+
+		if (features & CG_INTRINSICS)
+		    eop = intrinsic_opcode(expr->e.call.func, nargs);
+		for (a = expr->e.call.args; a; a = a->next)
+		    generate_expr(a->expr, state);
+		emit_extended_byte(eop, state);
+		if (eop == EOP_BI_FUNC_CALL)
+		    emit_byte(expr->e.call.func, state);
+		if (eop == EOP_BI_FUNC_CALL || intrinsic_nargs(eop) == -1)
+		    emit_byte(nargs, state);
+		pop_stack(nargs, state);
+		push_stack(1, state);
+	    } else {
+		generate_arg_list(expr->e.call.args, state);
+		emit_byte(OP_BI_FUNC_CALL, state);
+		emit_byte(expr->e.call.func, state);
+	    }
+	}
 	break;
     case EXPR_VERB:
 	generate_expr(expr->e.verb.obj, state);
@@ -903,6 +1111,7 @@ generate_expr(Expr * expr, State * state)
 			break;
 		    case EXPR_PROP:
 			emit_byte(OP_PUT_PROP, state);
+			state->gstate->num_prop_sites++;
 			pop_stack(2, state);
 			break;
 		    default:
@@ -957,17 +1166,40 @@ generate_expr(Expr * expr, State * state)
 
 static Bytecodes stmt_to_code(Stmt *, GState *);
 
+/* Emits the jump at the end of an IF or EXCEPT arm: to END_LABEL or, if
+ * there's a TAIL, straight to where the code after END_LABEL would go.
+ */
 static void
-generate_stmt(Stmt * stmt, State * state)
+emit_arm_jump(int *end_label, const Tail * tail, State * state)
 {
+    emit_byte(OP_JUMP, state);
+    if (!tail)
+	*end_label = add_linked_label(*end_label, state);
+    else if (tail->top)
+	add_known_label(*tail->top, state);
+    else
+	*tail->end_label = add_linked_label(*tail->end_label, state);
+}
+
+static void
+generate_stmt(Stmt * stmt, const Tail * block_tail, State * state)
+{
+    GState *gstate = state->gstate;
+
     for (; stmt; stmt = stmt->next) {
+	const Tail *tail = (stmt->next || !(features & CG_OPTIMIZE)
+			    ? 0 : block_tail);
+
 	switch (stmt->kind) {
 	case STMT_COND:
 	    {
 		Opcode if_op = OP_IF;
 		int end_label = -1;
+		Tail arm_tail;
 		Cond_Arm *arms;
 
+		arm_tail.top = 0;
+		arm_tail.end_label = &end_label;
 		for (arms = stmt->s.cond.arms; arms; arms = arms->next) {
 		    int else_label;
 
@@ -975,21 +1207,21 @@ generate_stmt(Stmt * stmt, State * state)
 		    emit_byte(if_op, state);
 		    else_label = add_label(state);
 		    pop_stack(1, state);
-		    generate_stmt(arms->stmt, state);
-		    emit_byte(OP_JUMP, state);
-		    end_label = add_linked_label(end_label, state);
+		    generate_stmt(arms->stmt, tail ? tail : &arm_tail, state);
+		    emit_arm_jump(&end_label, tail, state);
 		    define_label(else_label, state);
 		    if_op = OP_EIF;
 		}
 
 		if (stmt->s.cond.otherwise)
-		    generate_stmt(stmt->s.cond.otherwise, state);
+		    generate_stmt(stmt->s.cond.otherwise, tail, state);
 		define_label(end_label, state);
 	    }
 	    break;
 	case STMT_LIST:
 	    {
 		Fixup loop_top;
+		Tail body_tail;
 		int end_label;
 
 		generate_expr(stmt->s.list.expr, state);
@@ -1009,7 +1241,9 @@ generate_stmt(Stmt * stmt, State * state)
 		end_label = add_label(state);
 		enter_loop(stmt->s.list.id, stmt->s.list.index, loop_top, state->cur_stack,
 			   end_label, state->cur_stack - 2, state);
-		generate_stmt(stmt->s.list.body, state);
+		body_tail.top = &loop_top;
+		body_tail.end_label = 0;
+		generate_stmt(stmt->s.list.body, &body_tail, state);
 		end_label = exit_loop(state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
@@ -1020,6 +1254,7 @@ generate_stmt(Stmt * stmt, State * state)
 	case STMT_RANGE:
 	    {
 		Fixup loop_top;
+		Tail body_tail;
 		int end_label;
 
 		generate_expr(stmt->s.range.from, state);
@@ -1030,7 +1265,9 @@ generate_stmt(Stmt * stmt, State * state)
 		end_label = add_label(state);
 		enter_loop(stmt->s.range.id, -1, loop_top, state->cur_stack,
 			   end_label, state->cur_stack - 2, state);
-		generate_stmt(stmt->s.range.body, state);
+		body_tail.top = &loop_top;
+		body_tail.end_label = 0;
+		generate_stmt(stmt->s.range.body, &body_tail, state);
 		end_label = exit_loop(state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
@@ -1041,6 +1278,7 @@ generate_stmt(Stmt * stmt, State * state)
 	case STMT_WHILE:
 	    {
 		Fixup loop_top;
+		Tail body_tail;
 		int end_label;
 
 		loop_top = capture_label(state);
@@ -1055,7 +1293,9 @@ generate_stmt(Stmt * stmt, State * state)
 		pop_stack(1, state);
 		enter_loop(stmt->s.loop.id, -1, loop_top, state->cur_stack,
 			   end_label, state->cur_stack, state);
-		generate_stmt(stmt->s.loop.body, state);
+		body_tail.top = &loop_top;
+		body_tail.end_label = 0;
+		generate_stmt(stmt->s.loop.body, &body_tail, state);
 		end_label = exit_loop(state);
 		emit_byte(OP_JUMP, state);
 		add_known_label(loop_top, state);
@@ -1074,9 +1314,26 @@ generate_stmt(Stmt * stmt, State * state)
 	    pop_stack(1, state);
 	    break;
 	case STMT_EXPR:
-	    generate_expr(stmt->s.expr, state);
-	    emit_byte(OP_POP, state);
-	    pop_stack(1, state);
+	    {
+		Expr *e = stmt->s.expr;
+
+		/* See generate_code() for how dead stores are found. */
+		if ((features & CG_OPTIMIZE) && e->kind == EXPR_ASGN
+		    && e->e.bin.lhs->kind == EXPR_ID) {
+		    unsigned slot = e->e.bin.lhs->e.id;
+
+		    if (slot >= gstate->first_user_slot
+			&& slot < NUM_READY_VARS) {
+			if (gstate->dead & (1u << slot))
+			    e = e->e.bin.rhs;
+			else
+			    gstate->stored |= 1u << slot;
+		    }
+		}
+		generate_expr(e, state);
+		emit_byte(OP_POP, state);
+		pop_stack(1, state);
+	    }
 	    break;
 	case STMT_RETURN:
 	    if (stmt->s.expr) {
@@ -1089,6 +1346,7 @@ generate_stmt(Stmt * stmt, State * state)
 	case STMT_TRY_EXCEPT:
 	    {
 		int end_label, arm_count = 0;
+		Tail arm_tail;
 		Except_Arm *ex;
 
 		for (ex = stmt->s._catch.excepts; ex; ex = ex->next) {
@@ -1102,11 +1360,13 @@ generate_stmt(Stmt * stmt, State * state)
 		emit_byte(arm_count, state);
 		push_stack(1, state);
 		INCR_TRY_DEPTH(state);
-		generate_stmt(stmt->s._catch.body, state);
+		generate_stmt(stmt->s._catch.body, 0, state);
 		DECR_TRY_DEPTH(state);
 		emit_extended_byte(EOP_END_EXCEPT, state);
 		end_label = add_label(state);
 		pop_stack(2 * arm_count + 1, state);	/* 2(codes,pc) + catch */
+		arm_tail.top = 0;
+		arm_tail.end_label = &end_label;
 		for (ex = stmt->s._catch.excepts; ex; ex = ex->next) {
 		    define_label(ex->label, state);
 		    push_stack(1, state);	/* exception tuple */
@@ -1114,11 +1374,11 @@ generate_stmt(Stmt * stmt, State * state)
 			emit_var_op(OP_PUT, ex->id, state);
 		    emit_byte(OP_POP, state);
 		    pop_stack(1, state);
-		    generate_stmt(ex->stmt, state);
 		    if (ex->next) {
-			emit_byte(OP_JUMP, state);
-			end_label = add_linked_label(end_label, state);
-		    }
+			generate_stmt(ex->stmt, tail ? tail : &arm_tail, state);
+			emit_arm_jump(&end_label, tail, state);
+		    } else
+			generate_stmt(ex->stmt, tail, state);
 		}
 		define_label(end_label, state);
 	    }
@@ -1131,13 +1391,13 @@ generate_stmt(Stmt * stmt, State * state)
 		handler_label = add_label(state);
 		push_stack(1, state);
 		INCR_TRY_DEPTH(state);
-		generate_stmt(stmt->s.finally.body, state);
+		generate_stmt(stmt->s.finally.body, 0, state);
 		DECR_TRY_DEPTH(state);
 		emit_extended_byte(EOP_END_FINALLY, state);
 		pop_stack(1, state);	/* FINALLY marker */
 		define_label(handler_label, state);
 		push_stack(2, state);	/* continuation value, reason */
-		generate_stmt(stmt->s.finally.handler, state);
+		generate_stmt(stmt->s.finally.handler, 0, state);
 		emit_extended_byte(EOP_CONTINUE, state);
 		pop_stack(2, state);
 	    }
@@ -1224,7 +1484,7 @@ stmt_to_code(Stmt * stmt, GState * gstate)
 
     init_state(&state, gstate);
 
-    generate_stmt(stmt, &state);
+    generate_stmt(stmt, 0, &state);
     emit_ending_op(OP_DONE, &state);
 
     if (state.cur_stack != 0)
@@ -1385,45 +1645,105 @@ stmt_to_code(Stmt * stmt, GState * gstate)
     return bc;
 }
 
-Program *
-generate_code(Stmt * stmt, DB_Version version)
+static Bytecodes
+generate_main_vector(Stmt * stmt, DB_Version version, unsigned dead,
+		     GState * gstate)
 {
-    Program *prog = new_program();
-    GState gstate;
+    init_gstate(gstate);
+    gstate->first_user_slot = first_user_slot(version);
+    gstate->dead = dead;
+
+    return stmt_to_code(stmt, gstate);
+}
+
+static void
+discard_code(Bytecodes main_vector, GState * gstate)
+{
+    unsigned i;
+
+    for (i = 0; i < gstate->num_literals; i++)
+	free_var(gstate->literals[i]);
+    for (i = 0; i < gstate->num_fork_vectors; i++)
+	myfree(gstate->fork_vectors[i].vector, M_BYTECODES);
+    myfree(main_vector.vector, M_BYTECODES);
+
+    free_gstate(*gstate);
+}
 
-    init_gstate(&gstate);
+static Program *
+make_program(Bytecodes main_vector, DB_Version version, GState * gstate)
+{
+    Program *prog = new_program();
 
-    prog->main_vector = stmt_to_code(stmt, &gstate);
+    prog->main_vector = main_vector;
     prog->version = version;
+    prog->cg_features = features;
+    prog->num_prop_sites = gstate->num_prop_sites;
 
-    if (gstate.literals) {
+    if (gstate->literals) {
 	unsigned i;
 
-	prog->literals = (Var *)mymalloc(sizeof(Var) * gstate.num_literals,
+	prog->literals = (Var *)mymalloc(sizeof(Var) * gstate->num_literals,
 					 M_LIT_LIST);
-	prog->num_literals = gstate.num_literals;
-	for (i = 0; i < gstate.num_literals; i++)
-	    prog->literals[i] = gstate.literals[i];
+	prog->num_literals = gstate->num_literals;
+	for (i = 0; i < gstate->num_literals; i++)
+	    prog->literals[i] = gstate->literals[i];
     } else {
 	prog->literals = 0;
 	prog->num_literals = 0;
     }
 
-    if (gstate.fork_vectors) {
+    if (gstate->fork_vectors) {
 	unsigned i;
 
 	prog->fork_vectors =
-	    (Bytecodes *)mymalloc(sizeof(Bytecodes) * gstate.num_fork_vectors,
+	    (Bytecodes *)mymalloc(sizeof(Bytecodes) * gstate->num_fork_vectors,
 				  M_FORK_VECTORS);
-	prog->fork_vectors_size = gstate.num_fork_vectors;
-	for (i = 0; i < gstate.num_fork_vectors; i++)
-	    prog->fork_vectors[i] = gstate.fork_vectors[i];
+	prog->fork_vectors_size = gstate->num_fork_vectors;
+	for (i = 0; i < gstate->num_fork_vectors; i++)
+	    prog->fork_vectors[i] = gstate->fork_vectors[i];
     } else {
 	prog->fork_vectors = 0;
 	prog->fork_vectors_size = 0;
     }
 
-    free_gstate(gstate);
+    free_gstate(*gstate);
+
+    return prog;
+}
+
+Program *
+generate_code(Stmt * stmt, DB_Version version)
+{
+    unsigned old_features = features, dead;
+    Bytecodes main_vector;
+    Program *prog;
+    GState gstate;
+
+    if (features == CG_DEFAULT) {
+	features = CG_ALL_FEATURES;
+	if (!server_flag_option_cached(SVO_OPTIMIZE_BYTECODE))
+	    features &= ~CG_OPTIMIZE;
+    }
+
+    main_vector = generate_main_vector(stmt, version, 0, &gstate);
+
+    /* Whether an assignment is a dead store isn't known until all of the
+     * code has been generated and every read of the variable seen, so the
+     * code is generated over again without them.  The variables involved
+     * drop out of the decompiled source, and recompiling that mustn't
+     * change the length of any instruction (or the PC of a suspended task
+     * would be off), so this is only done when every variable fits in a
+     * one-byte PUSH or PUT.
+     */
+    if ((features & CG_OPTIMIZE) && gstate.max_slot < NUM_READY_VARS
+	&& (dead = gstate.stored & ~gstate.pushed) != 0) {
+	discard_code(main_vector, &gstate);
+	main_vector = generate_main_vector(stmt, version, dead, &gstate);
+    }
+
+    prog = make_program(main_vector, version, &gstate);
 
+    features = old_features;
     return prog;
 }
@@ -16,7 +16,54 @@
  *****************************************************************************/
 
 #include "ast.h"
+#include "opcode.h"
 #include "program.h"
 #include "version.h"
 
+/* The instruction sequences produced by generate_code() have changed
+ * over time.  A suspended task's saved PC and runtime stack only make
+ * sense for the sequences its program was compiled into, so programs
+ * remember which of the following features they were compiled with
+ * (see write_activ()), and the program of a task saved before a feature
+ * existed is recompiled without it.
+ */
+#define CG_STACK_ARGS	0x1	/* Arguments to built-in functions are left
+				 * on the stack rather than collected into a
+				 * list, unless there's an `@' among them.
+				 */
+#define CG_INTRINSICS	0x2	/* Calls to a few very common built-in
+				 * functions get opcodes of their own (see
+				 * intrinsic_func() below).
+				 */
+#define CG_OPTIMIZE	0x4	/* Integer constant expressions are folded,
+				 * jumps at the ends of IF and EXCEPT arms go
+				 * straight to where the jump after them
+				 * would, and assignments to variables that
+				 * are never read are left out.  Only used by
+				 * default if $server_options.optimize_bytecode
+				 * is true.
+				 */
+#define CG_ALL_FEATURES	(CG_STACK_ARGS | CG_INTRINSICS | CG_OPTIMIZE)
+#define CG_DEFAULT	(~0u)	/* CG_ALL_FEATURES, less CG_OPTIMIZE if the
+				 * server option is off.
+				 */
+
+extern unsigned set_code_gen_features(unsigned);
+				/* Sets the features used by subsequent calls
+				 * to generate_code(), returning the previous
+				 * setting.  The default is CG_DEFAULT.
+				 */
+
 extern Program *generate_code(Stmt *, DB_Version);
+
+extern unsigned intrinsic_func(Extended_Opcode);
+				/* Returns the number of the built-in function
+				 * that an intrinsic opcode (EOP_BF_LENGTH and
+				 * friends) calls, or FUNC_NOT_FOUND if the
+				 * opcode isn't one of them.
+				 */
+extern int intrinsic_nargs(Extended_Opcode);
+				/* Returns the number of arguments the
+				 * intrinsic takes from the stack, or -1 if
+				 * that number follows the opcode as a byte.
+				 */
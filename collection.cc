@@ -71,24 +71,22 @@ ismember(Var lhs, Var rhs, int case_matters)
 /**** built in functions ****/
 
 static package
-bf_is_member(Var arglist, Byte next, void *vdata, Objid progr)
+bf_is_member(Var *args, int nargs, Objid progr)
 {
     Var r;
-    Var rhs = arglist.v.list[2];
+    Var rhs = args[1];
 
-    if (rhs.type != TYPE_LIST && rhs.type != TYPE_MAP) {
-	free_var(arglist);
+    if (rhs.type != TYPE_LIST && rhs.type != TYPE_MAP)
 	return make_error_pack(E_INVARG);
-    }
 
     r.type = TYPE_INT;
-    r.v.num = ismember(arglist.v.list[1], rhs, 1);
-    free_var(arglist);
+    r.v.num = ismember(args[0], rhs, 1);
     return make_var_pack(r);
 }
 
 void
 register_collection(void)
 {
-    register_function("is_member", 2, 2, bf_is_member, TYPE_ANY, TYPE_ANY);
+    register_stack_function("is_member", 2, 2, bf_is_member, TYPE_ANY,
+			    TYPE_ANY);
 }
@@ -52,6 +52,13 @@ extern const char *db_usage_string(void);
 				 * command-line arguments.
 				 */
 
+extern int db_set_output_format(const char *format);
+				/* Selects the format ("text" or "binary") of
+				 * databases written by this server.  Returns
+				 * false if FORMAT isn't recognized.  Input
+				 * databases may be in either format.
+				 */
+
 extern int db_initialize(int *pargc, char ***pargv);
 				/* (*pargc) and (*pargv) refer to the database
 				 * command-line arguments and perhaps others.
@@ -423,6 +430,48 @@ extern db_prop_handle db_find_property(Var obj, const char *name,
 				 * leave the handle intact.
 				 */
 
+#define DB_PROP_CACHE_HOPS 4
+
+/* An inline cache remembers where one property reference site last
+ * found its property.  The interpreter keeps one per property
+ * reference opcode (see `Program'); only the `site' field belongs to
+ * the caller, the rest is private to the DB layer.
+ */
+typedef struct db_prop_cache {
+    const void *site;		/* null iff the cache slot is unused */
+    const char *name;		/* null iff the cache is empty */
+    enum bi_prop built_in;
+    void *definer;
+    const char *defname;	/* definer's propdef name at fill time */
+    int index;			/* index of the propdef on the definer */
+    int nhops;
+    struct {
+	void *object;
+	unsigned int nonce;
+	int offset;
+    } hops[DB_PROP_CACHE_HOPS];	/* the slots to try, in order, when
+				 * skipping over `clear' values */
+} db_prop_cache;
+
+extern db_prop_handle db_find_property_cached(Var obj, const char *name,
+					      Var * value,
+					      db_prop_cache * cache);
+				/* Like `db_find_property()', but if `cache'
+				 * is non-null, first tries the location it
+				 * remembers, and remembers the location found
+				 * otherwise.  The cache is keyed on the
+				 * object's nonce, so any change to the layout
+				 * of the object's property values simply
+				 * causes a miss.
+				 */
+
+extern void db_init_prop_cache(db_prop_cache *, const void *site);
+extern void db_clear_prop_cache(db_prop_cache *);
+				/* Respectively initialize an unused cache slot
+				 * for the given site and release the
+				 * references held by a cache slot.
+				 */
+
 extern Var db_property_value(db_prop_handle);
 extern void db_set_property_value(db_prop_handle, Var);
 				/* For non-built-in properties, these functions
@@ -45,6 +45,16 @@ static char *input_db_name, *dump_db_name;
 static int dump_generation = 0;
 static const char *header_format_string
   = "** LambdaMOO Database, Format Version %u **\n";
+static const char *binary_header_format_string
+  = "** Stunt Binary Database, Format Version %u **\n";
+
+/* In the binary format, everything up to and including the list of
+ * formerly active connections is still written as text, exactly as
+ * in the text format; objects and verb programs that follow are
+ * written using the binary encoding in `db_io.cc'.
+ */
+static int binary_input = 0;
+static int binary_output = 0;
 
 DB_Version dbio_input_version;
 
@@ -179,6 +189,7 @@ read_verbdef(Verbdef * v)
     v->prep = dbio_read_num();
     v->next = 0;
     v->program = 0;
+    v->source = 0;
 }
 
 static void
@@ -232,7 +243,7 @@ v4_read_object(void)
     Verbdef *v, **prevv;
     int nprops;
 
-    if (dbio_scanf("#%d", &oid) != 1 || oid != dbv4_last_used_objid() + 1)
+    if (dbio_scanf("#%" SCNdN, &oid) != 1 || oid != dbv4_last_used_objid() + 1)
 	return 0;
     dbio_read_line(s, sizeof(s));
 
@@ -277,7 +288,7 @@ v4_read_object(void)
 	    o->propdefs.l[i] = read_propdef();
 #define CHECK_PROP_NAME(PROPERTY, property) !mystrcasecmp(o->propdefs.l[i].name, #property) ||
 	    if (BUILTIN_PROPERTIES(CHECK_PROP_NAME) 0)
-		oklog("DB_WARNING: Property #%d.%s has a reserved name\n", o->id, o->propdefs.l[i].name);
+		oklog("DB_WARNING: Property #%" PRIdN ".%s has a reserved name\n", o->id, o->propdefs.l[i].name);
 #undef CHECK_PROP
 	}
     }
@@ -295,6 +306,18 @@ v4_read_object(void)
     return 1;
 }
 
+/* Reads a count of verbs or properties.  In the binary format, a
+ * count the rest of the file couldn't hold means the object is bad.
+ */
+static int
+read_object_count(int *n)
+{
+    if (binary_input)
+	return dbpriv_read_binary_count(n);
+    *n = dbio_read_num();
+    return 1;
+}
+
 static int
 ng_read_object(int anonymous)
 {
@@ -303,17 +326,27 @@ ng_read_object(int anonymous)
     char s[20];
     int i;
     Verbdef *v, **prevv;
-    int nprops;
+    int nverbs, npropdefs, nprops;
 
-    if (dbio_scanf("#%d", &oid) != 1)
-	return 0;
-    dbio_read_line(s, sizeof(s));
+    if (binary_input) {
+	oid = dbio_read_num();
+	if (!anonymous && oid != db_last_used_objid() + 1)
+	    return 0;
+	if (dbio_read_num()) {
+	    dbpriv_new_recycled_object();
+	    return 1;
+	}
+    } else {
+	if (dbio_scanf("#%" SCNdN, &oid) != 1)
+	    return 0;
+	dbio_read_line(s, sizeof(s));
 
-    if (strcmp(s, " recycled\n") == 0) {
-	dbpriv_new_recycled_object();
-	return 1;
-    } else if (strcmp(s, "\n") != 0)
-	return 0;
+	if (strcmp(s, " recycled\n") == 0) {
+	    dbpriv_new_recycled_object();
+	    return 1;
+	} else if (strcmp(s, "\n") != 0)
+	    return 0;
+    }
 
     /* At the point at which we're reading anonymous objects, we know
      * we've already created all of the anonymous objects (they were
@@ -321,7 +354,8 @@ ng_read_object(int anonymous)
      * of values pending finalization).
      */
     if (anonymous) {
-	o = dbpriv_find_object(oid);
+	if (!(o = dbpriv_find_object(oid)))
+	    return 0;
     }
     else {
 	o = dbpriv_new_object();
@@ -341,7 +375,9 @@ ng_read_object(int anonymous)
 
     o->verbdefs = 0;
     prevv = &(o->verbdefs);
-    for (i = dbio_read_num(); i > 0; i--) {
+    if (!read_object_count(&nverbs))
+	return 0;
+    for (i = nverbs; i > 0; i--) {
 	v = (Verbdef *)mymalloc(sizeof(Verbdef), M_VERBDEF);
 	read_verbdef(v);
 	*prevv = v;
@@ -351,20 +387,25 @@ ng_read_object(int anonymous)
     o->propdefs.cur_length = 0;
     o->propdefs.max_length = 0;
     o->propdefs.l = 0;
-    if ((i = dbio_read_num()) != 0) {
-	o->propdefs.l = (Propdef *)mymalloc(i * sizeof(Propdef), M_PROPDEF);
-	o->propdefs.cur_length = i;
-	o->propdefs.max_length = i;
+    if (!read_object_count(&npropdefs))
+	return 0;
+    if (npropdefs != 0) {
+	o->propdefs.l = (Propdef *)mymalloc(npropdefs * sizeof(Propdef),
+					    M_PROPDEF);
+	o->propdefs.cur_length = npropdefs;
+	o->propdefs.max_length = npropdefs;
 	for (i = 0; i < o->propdefs.cur_length; i++) {
 	    o->propdefs.l[i] = read_propdef();
 #define CHECK_PROP_NAME(PROPERTY, property) !mystrcasecmp(o->propdefs.l[i].name, #property) ||
 	    if (BUILTIN_PROPERTIES(CHECK_PROP_NAME) 0)
-		oklog("DB_WARNING: Property #%d.%s has a reserved name\n", o->id, o->propdefs.l[i].name);
+		oklog("DB_WARNING: Property #%" PRIdN ".%s has a reserved name\n", o->id, o->propdefs.l[i].name);
 #undef CHECK_PROP
 	}
     }
 
-    o->nval = nprops = dbio_read_num();
+    if (!read_object_count(&nprops))
+	return 0;
+    o->nval = nprops;
     if (nprops)
 	o->propval = (Pval *)mymalloc(nprops * sizeof(Pval), M_PVAL);
     else
@@ -386,12 +427,12 @@ v4_write_object(Objid oid)
     int nverbdefs, nprops;
 
     if (!dbv4_valid(oid)) {
-	dbio_printf("#%d recycled\n", oid);
+	dbio_printf("#%" PRIdN " recycled\n", oid);
 	return;
     }
     o = dbv4_find_object(oid);
 
-    dbio_printf("#%d\n", oid);
+    dbio_printf("#%" PRIdN "\n", oid);
     dbio_write_string(o->name);
     dbio_write_string("");	/* placeholder for old handles string */
     dbio_write_num(o->flags);
@@ -432,13 +473,18 @@ ng_write_object(Objid oid)
     int i;
     int nverbdefs, nprops;
 
-    if (!valid(oid)) {
-	dbio_printf("#%d recycled\n", oid);
+    if (binary_output) {
+	dbio_write_num(oid);
+	dbio_write_num(!valid(oid));
+	if (!valid(oid))
+	    return;
+    } else if (!valid(oid)) {
+	dbio_printf("#%" PRIdN " recycled\n", oid);
 	return;
-    }
+    } else
+	dbio_printf("#%" PRIdN "\n", oid);
     o = dbpriv_find_object(oid);
 
-    dbio_printf("#%d\n", oid);
     dbio_write_string(o->name);
     dbio_write_num(o->flags);
 
@@ -485,7 +531,7 @@ v4_validate_hierarchies()
     {								\
 	if (oid == log_oid) {					\
 	    log_oid += PROGRESS_INTERVAL;			\
-	    oklog("VALIDATE: Done through #%d ...\n", oid);	\
+	    oklog("VALIDATE: Done through #%" PRIdN " ...\n", oid);	\
 	}							\
     }
 
@@ -503,7 +549,7 @@ v4_validate_hierarchies()
 	    {								\
 	        if (o->field != NOTHING					\
 		    && !dbv4_find_object(o->field)) {			\
-		    errlog("VALIDATE: #%d.%s = #%d <invalid> ... fixed.\n", \
+		    errlog("VALIDATE: #%" PRIdN ".%s = #%" PRIdN " <invalid> ... fixed.\n", \
 			   oid, name, o->field);			\
 		    o->field = NOTHING;				  	\
 		}							\
@@ -537,7 +583,7 @@ v4_validate_hierarchies()
 		for (; oid2 != NOTHING					\
 		     ; oid2 = dbv4_find_object(oid2)->field) {		\
 		    if (++count > size)	{				\
-			errlog("VALIDATE: Cycle in `%s' chain of #%d\n",\
+			errlog("VALIDATE: Cycle in `%s' chain of #%" PRIdN "\n",\
 			       name, oid);				\
 			broken = 1;					\
 			break;						\
@@ -577,7 +623,7 @@ v4_validate_hierarchies()
 			    break;					\
 		    }							\
 		    if (oid2 == NOTHING) { /* didn't find it */		\
-			errlog("VALIDATE: #%d not in %s (#%d)'s %s list.\n", \
+			errlog("VALIDATE: #%" PRIdN " not in %s (#%" PRIdN ")'s %s list.\n", \
 			       oid, up_name, up, down_name);	        \
 			broken = 1;					\
 		    }							\
@@ -598,7 +644,7 @@ v4_validate_hierarchies()
 		     oid2 = dbv4_find_object(oid2)->across) {		\
 		    if (dbv4_find_object(oid2)->up != oid) {		\
 			errlog(						\
-			    "VALIDATE: #%d erroneously on #%d's %s list.\n", \
+			    "VALIDATE: #%" PRIdN " erroneously on #%" PRIdN "'s %s list.\n", \
 			    oid2, oid, down_name);			\
 			broken = 1;					\
 		    }							\
@@ -634,7 +680,7 @@ ng_validate_hierarchies()
     {								\
         if (oid == log_oid) {					\
 	    log_oid += PROGRESS_INTERVAL;			\
-	    oklog("VALIDATE: Done through #%d ...\n", oid);	\
+	    oklog("VALIDATE: Done through #%" PRIdN " ...\n", oid);	\
 	}							\
     }
 
@@ -644,22 +690,22 @@ ng_validate_hierarchies()
 	MAYBE_LOG_PROGRESS;
 	if (o) {
 	    if (!is_obj_or_list_of_objs(o->parents)) {
-		errlog("VALIDATE: #%d.parents is not an object or list of objects.\n",
+		errlog("VALIDATE: #%" PRIdN ".parents is not an object or list of objects.\n",
 		       oid);
 		broken = 1;
 	    }
 	    if (!is_list_of_objs(o->children)) {
-		errlog("VALIDATE: #%d.children is not a list of objects.\n",
+		errlog("VALIDATE: #%" PRIdN ".children is not a list of objects.\n",
 		       oid);
 		broken = 1;
 	    }
 	    if (!o->location.is_obj()) {
-		errlog("VALIDATE: #%d.location is not an object.\n",
+		errlog("VALIDATE: #%" PRIdN ".location is not an object.\n",
 		       oid);
 		broken = 1;
 	    }
 	    if (!is_list_of_objs(o->contents)) {
-		errlog("VALIDATE: #%d.contents is not a list of objects.\n",
+		errlog("VALIDATE: #%" PRIdN ".contents is not a list of objects.\n",
 		       oid);
 		broken = 1;
 	    }
@@ -670,8 +716,8 @@ ng_validate_hierarchies()
 		    FOR_EACH(tmp, o->field, i, c) {			\
 			if (tmp.v.obj != NOTHING			\
 			    && !dbpriv_find_object(tmp.v.obj)) {	\
-			    errlog("VALIDATE: #%d.%s = #%d <invalid> ... removed.\n", \
-			           oid, name, tmp);			\
+			    errlog("VALIDATE: #%" PRIdN ".%s = #%" PRIdN " <invalid> ... removed.\n", \
+			           oid, name, tmp.v.obj);			\
 			    o->field = setremove(o->field, tmp);	\
 			}						\
 		    }							\
@@ -679,7 +725,7 @@ ng_validate_hierarchies()
 		else {							\
 		    if (o->field.v.obj != NOTHING			\
 		        && !dbpriv_find_object(o->field.v.obj)) {	\
-			errlog("VALIDATE: #%d.%s = #%d <invalid> ... fixed.\n", \
+			errlog("VALIDATE: #%" PRIdN ".%s = #%" PRIdN " <invalid> ... fixed.\n", \
 			       oid, name, o->field.v.obj);		\
 			o->field.v.obj = NOTHING;			\
 		    }							\
@@ -709,7 +755,7 @@ ng_validate_hierarchies()
 	    {								\
 		Var all = func(start, false);				\
 		if (ismember(start, all, 1)) {				\
-			errlog("VALIDATE: Cycle in %s chain of #%d.\n",	\
+			errlog("VALIDATE: Cycle in %s chain of #%" PRIdN ".\n",	\
 			       name, oid);				\
 			broken = 1;					\
 		}							\
@@ -746,7 +792,7 @@ ng_validate_hierarchies()
 			    continue;					\
 			}						\
 			else {						\
-			    errlog("VALIDATE: #%d not in it's %s's (#%d) %s.\n", \
+			    errlog("VALIDATE: #%" PRIdN " not in it's %s's (#%" PRIdN ") %s.\n", \
 			           oid, up_name, otmp->id, down_name); \
 			    free_var(t2);				\
 			    broken = 1;					\
@@ -786,7 +832,7 @@ v4_upgrade_objects()
     {								\
         if (oid == log_oid) {					\
 	    log_oid += PROGRESS_INTERVAL;			\
-	    oklog("UPGRADE: Done through #%d ...\n", oid);	\
+	    oklog("UPGRADE: Done through #%" PRIdN " ...\n", oid);	\
 	}							\
     }
 
@@ -862,6 +908,14 @@ fmt_verb_name(void *data)
     return reset_stream(s);
 }
 
+static int
+read_count(int *n)
+{
+    if (binary_input)
+	return dbpriv_read_binary_count(n);
+    return dbio_scanf("%d\n", n) == 1;
+}
+
 static int
 read_db_file(void)
 {
@@ -871,15 +925,34 @@ read_db_file(void)
     int i, vnum, dummy;
     db_verb_handle h;
     Program *program;
+#ifdef LAZY_VERB_COMPILATION
+    const char *source;
+    int npending = 0;
+#endif
 
-    if (dbio_scanf(header_format_string, &dbio_input_version) != 1)
-	dbio_input_version = DBV_Prehistory;
+    /* Both headers begin with the same "** ", so if the text header
+     * doesn't match, what's left of the line can be checked against
+     * the rest of the binary one.
+     */
+    binary_input = 0;
+    if (dbio_scanf(header_format_string, &dbio_input_version) != 1) {
+	if (dbio_scanf(binary_header_format_string + 3,
+		       &dbio_input_version) == 1)
+	    binary_input = 1;
+	else
+	    dbio_input_version = DBV_Prehistory;
+    }
 
     if (!check_db_version(dbio_input_version)) {
 	errlog("READ_DB_FILE: Unknown DB version number: %d\n",
 	       dbio_input_version);
 	return 0;
     }
+    if (binary_input && DBV_Anon > dbio_input_version) {
+	errlog("READ_DB_FILE: Unsupported binary DB version number: %d\n",
+	       dbio_input_version);
+	return 0;
+    }
 
     /* I use a `dummy' variable here and elsewhere instead of the `*'
      * assignment-suppression syntax of `scanf' because it allows more
@@ -930,11 +1003,14 @@ read_db_file(void)
 	}
     }
 
+    if (binary_input)
+	dbpriv_begin_binary_input();
+
     /* First, read the permanent objects.  Then, read successive
      * iterations of anonymous objects.
      */
     if (DBV_Anon <= dbio_input_version) {
-	if (dbio_scanf("%d\n", &nobjs) != 1) {
+	if (!read_count(&nobjs)) {
 	    errlog("READ_DB_FILE: Bad object count\n");
 	    return 0;
 	}
@@ -960,7 +1036,7 @@ read_db_file(void)
 
     if (DBV_Anon <= dbio_input_version) {
 	while (1) {
-	    if (dbio_scanf("%d\n", &nobjs) != 1) {
+	    if (!read_count(&nobjs)) {
 		errlog("READ_DB_FILE: Bad object count header\n");
 		return 0;
 	    }
@@ -999,7 +1075,7 @@ read_db_file(void)
     }
 
     if (DBV_Anon <= dbio_input_version) {
-	if (dbio_scanf("%d\n", &nprogs) != 1) {
+	if (!read_count(&nprogs)) {
 	    errlog("READ_DB_FILE: Bad verb count header\n");
 	    return 0;
 	}
@@ -1007,29 +1083,49 @@ read_db_file(void)
 
     oklog("LOADING: Reading %d MOO verb programs ...\n", nprogs);
     for (i = 1; i <= nprogs; i++) {
-	if (dbio_scanf("#%d:%d\n", &oid, &vnum) != 2) {
+	if (binary_input) {
+	    oid = dbio_read_num();
+	    vnum = dbio_read_num();
+	} else if (dbio_scanf("#%" SCNdN ":%d\n", &oid, &vnum) != 2) {
 	    errlog("READ_DB_FILE: Bad program header, i = %d.\n", i);
 	    return 0;
 	}
 	if (!valid(oid)) {
-	    errlog("READ_DB_FILE: Verb for non-existant object: #%d:%d.\n", oid, vnum);
+	    errlog("READ_DB_FILE: Verb for non-existant object: #%" PRIdN ":%d.\n", oid, vnum);
 	    return 0;
 	}
 	h = db_find_indexed_verb(Var::new_obj(oid), vnum + 1);	/* DB file is 0-based. */
 	if (!h.ptr) {
-	    errlog("READ_DB_FILE: Unknown verb index: #%d:%d.\n", oid, vnum);
+	    errlog("READ_DB_FILE: Unknown verb index: #%" PRIdN ":%d.\n", oid, vnum);
 	    return 0;
 	}
+#ifdef LAZY_VERB_COMPILATION
+	program = dbpriv_read_program_or_source(dbio_input_version,
+						fmt_verb_name, &h, &source);
+	if (source) {
+	    dbpriv_set_verb_source(h, source);
+	    npending++;
+	} else
+#else
 	program = dbio_read_program(dbio_input_version, fmt_verb_name, &h);
+#endif
 	if (!program) {
-	    errlog("READ_DB_FILE: Unparsable program #%d:%d.\n", oid, vnum);
+	    errlog("READ_DB_FILE: Unparsable program #%" PRIdN ":%d.\n", oid, vnum);
 	    return 0;
-	}
-	db_set_verb_program(h, program);
+	} else
+	    db_set_verb_program(h, program);
 	if (i % 5000 == 0 || i == nprogs)
 	    oklog("LOADING: Done reading %d verb programs ...\n", i);
     }
 
+    dbpriv_end_binary_io();
+
+#ifdef LAZY_VERB_COMPILATION
+    if (npending)
+	oklog("LOADING: Compilation of %d verb programs deferred until use\n",
+	      npending);
+#endif
+
     if (DBV_Anon > dbio_input_version) {
 	oklog("LOADING: Reading forked and suspended tasks ...\n");
 	if (!read_task_queue()) {
@@ -1053,6 +1149,15 @@ read_db_file(void)
 
 /*********** File-level Output ***********/
 
+static void
+write_count(int n)
+{
+    if (binary_output)
+	dbio_write_num(n);
+    else
+	dbio_printf("%d\n", n);
+}
+
 static int
 write_db_file(const char *reason)
 {
@@ -1065,7 +1170,9 @@ write_db_file(const char *reason)
     volatile int success = 1;
 
     try {
-	dbio_printf(header_format_string, current_db_version);
+	dbio_printf(binary_output ? binary_header_format_string
+				  : header_format_string,
+		    current_db_version);
 
 	user_list = db_all_users();
 
@@ -1083,38 +1190,57 @@ write_db_file(const char *reason)
 	oklog("%s: Writing list of formerly active connections ...\n", reason);
 	write_active_connections();
 
+	if (binary_output)
+	    dbpriv_begin_binary_output();
+
 	while (last_oid > max_oid) {
-	    dbio_printf("%d\n", last_oid - max_oid);
+	    write_count(last_oid - max_oid);
 
-	    oklog("%s: Writing %d objects ...\n", reason, last_oid - max_oid);
+	    oklog("%s: Writing %" PRIdN " objects ...\n", reason, last_oid - max_oid);
 	    for (oid = max_oid + 1; oid <= last_oid; oid++) {
 		ng_write_object(oid);
 		if ((oid + 1) % 10000 == 0 || oid == last_oid)
-		    oklog("%s: Done writing %d objects ...\n", reason, oid + 1);
+		    oklog("%s: Done writing %" PRIdN " objects ...\n", reason, oid + 1);
 	    }
 	    max_oid = last_oid;
 	    last_oid = db_last_used_objid();
 	}
 
-	dbio_printf("%d\n", 0);
+	write_count(0);
 
 	for (oid = 0; oid <= max_oid; oid++) {
 	    if (valid(oid))
 		for (v = dbpriv_find_object(oid)->verbdefs; v; v = v->next)
-		    if (v->program)
+		    if (v->program || v->source)
 			nprogs++;
 	}
 
-	dbio_printf("%d\n", nprogs);
+	write_count(nprogs);
 
 	oklog("%s: Writing %d MOO verb programs ...\n", reason, nprogs);
 	for (i = 0, oid = 0; oid <= max_oid; oid++) {
 	    if (valid(oid)) {
 		int vcount = 0;
 		for (v = dbpriv_find_object(oid)->verbdefs; v; v = v->next) {
-		    if (v->program) {
-			dbio_printf("#%d:%d\n", oid, vcount);
-			dbio_write_program(v->program);
+		    if (v->program || v->source) {
+			if (binary_output) {
+			    dbio_write_num(oid);
+			    dbio_write_num(vcount);
+			} else
+			    dbio_printf("#%" PRIdN ":%d\n", oid, vcount);
+			/* Verbs that haven't been compiled yet are written
+			 * out as is, except in the binary format, which
+			 * needs their bytecode.
+			 */
+			if (v->source && !binary_output)
+			    dbpriv_write_program_source(v->source);
+			else {
+			    dbio_write_program(dbpriv_verb_program(v, oid));
+			    if (v->source)
+				errlog("%s: Verb #%" PRIdN ":%d doesn't compile; "
+				       "writing an empty program\n",
+				       reason, oid, vcount);
+			}
 			if (++i % 5000 == 0 || i == nprogs)
 			    oklog("%s: Done writing %d verb programs ...\n",
 			          reason, i);
@@ -1127,6 +1253,7 @@ write_db_file(const char *reason)
     catch (dbpriv_dbio_failed& exception) {
 	success = 0;
     }
+    dbpriv_end_binary_io();
 
     return success;
 }
@@ -1229,6 +1356,18 @@ dump_database(Dump_Reason reason)
 
 /*********** External interface ***********/
 
+int
+db_set_output_format(const char *format)
+{
+    if (!strcmp(format, "text"))
+	binary_output = 0;
+    else if (!strcmp(format, "binary"))
+	binary_output = 1;
+    else
+	return 0;
+    return 1;
+}
+
 const char *
 db_usage_string(void)
 {
@@ -1264,12 +1403,22 @@ db_initialize(int *pargc, char ***pargv)
 int
 db_load(void)
 {
+    int loaded;
+
     dbpriv_set_dbio_input(input_db);
 
     str_intern_open(0);
 
     oklog("LOADING: %s\n", input_db_name);
-    if (!read_db_file()) {
+    try {
+	loaded = read_db_file();
+    }
+    catch (dbpriv_dbio_failed& exception) {
+	/* a truncated or corrupt binary region */
+	dbpriv_end_binary_io();
+	loaded = 0;
+    }
+    if (!loaded) {
 	errlog("DB_LOAD: Cannot load database!\n");
 	return 0;
     }
@@ -21,6 +21,8 @@
 
 #include "my-ctype.h"
 #include <float.h>
+#include <limits.h>
+#include "my-stat.h"
 #include "my-stdarg.h"
 #include "my-stdio.h"
 #include "my-stdlib.h"
@@ -28,10 +30,12 @@
 #include "db.h"
 #include "db_io.h"
 #include "db_private.h"
+#include "functions.h"
 #include "list.h"
 #include "log.h"
 #include "map.h"
 #include "numbers.h"
+#include "opcode.h"
 #include "parser.h"
 #include "server.h"
 #include "storage.h"
@@ -39,9 +43,48 @@
 #include "structures.h"
 #include "str_intern.h"
 #include "unparse.h"
+#include "utils.h"
 #include "version.h"
 
 
+/*********** Binary encoding ***********/
+
+/* In the binary region of a database, numbers are written as
+ * zigzag-encoded variable-length integers (seven bits per byte, low
+ * bits first), floats as their eight IEEE bytes in little-endian
+ * order, and strings as a length followed by the raw bytes.  Verb
+ * programs carry their compiled bytecode next to their source; the
+ * bytecode is only used if it was written by a server with the same
+ * version, opcode set and builtin function table, which is what the
+ * stamp below identifies.  Increment DBIO_BYTECODE_REVISION whenever
+ * the code generator or the opcode numbering changes.
+ */
+#define DBIO_BYTECODE_REVISION	6
+
+static const char *
+bytecode_stamp(void)
+{
+    static char buffer[200];
+
+    if (!buffer[0]) {
+	const char *not_found = name_func_by_num(~0u);
+	const char *name;
+	unsigned hash = 0, n;
+
+	for (n = 0; (name = name_func_by_num(n)) != not_found; n++)
+	    hash = hash * 31 + str_hash(name);
+	sprintf(buffer, "%s/%d/%d/%u", server_version,
+		DBIO_BYTECODE_REVISION, (int) OPTIM_NUM_START, hash);
+    }
+    return buffer;
+}
+
+static int binary_input = 0;	/* reading the binary region of a DB? */
+static int trust_bytecode = 0;	/* ... and written by this very server? */
+static int binary_output = 0;	/* writing the binary region of a DB? */
+static long input_size;		/* size of the DB file being read */
+
+
 /*********** Input ***********/
 
 static FILE *input;
@@ -52,6 +95,85 @@ dbpriv_set_dbio_input(FILE * f)
     input = f;
 }
 
+/* Running off the end of the binary region means the file was
+ * truncated, and there's no sensible value to go on with, so these
+ * throw `dbpriv_dbio_failed' and let `read_db_file()' give up.
+ */
+static void
+read_bytes(void *p, size_t n)
+{
+    if (fread(p, 1, n, input) != n) {
+	errlog("DBIO_READ: Unexpected end of file at file pos. %ld\n",
+	       ftell(input));
+	throw dbpriv_dbio_failed();
+    }
+}
+
+static UNum
+read_varint(void)
+{
+    UNum u = 0;
+    int shift = 0, c;
+
+    do {
+	if ((c = fgetc(input)) == EOF) {
+	    errlog("DBIO_READ_NUM: Unexpected end of file at file pos. %ld\n",
+		   ftell(input));
+	    throw dbpriv_dbio_failed();
+	}
+	u |= (UNum) (c & 0x7f) << shift;
+	shift += 7;
+    } while ((c & 0x80) && shift < (int) sizeof(UNum) * 8);
+
+    return u;
+}
+
+/* Every item in a count or length takes at least one byte, so one
+ * that's negative or longer than the rest of the file is corrupt.
+ */
+static int
+valid_length(Num n)
+{
+    return n >= 0 && n <= input_size - ftell(input);
+}
+
+/* Checks a string length (written unsigned) or a count (written with
+ * dbio_write_num()) before anything is allocated for it.
+ */
+static int
+checked_length(Num n)
+{
+    if (!valid_length(n)) {
+	errlog("DBIO_READ: Bad length (%" PRIdN ") at file pos. %ld\n",
+	       n, ftell(input));
+	throw dbpriv_dbio_failed();
+    }
+    return n;
+}
+
+int
+dbpriv_read_binary_count(int *n)
+{
+    Num c = dbio_read_num();
+
+    *n = c;
+    return valid_length(c);
+}
+
+int
+dbpriv_begin_binary_input(void)
+{
+    struct stat st;
+
+    binary_input = 1;
+    input_size = fstat(fileno(input), &st) == 0 ? st.st_size : LONG_MAX;
+    trust_bytecode = !strcmp(dbio_read_string(), bytecode_stamp());
+    if (!trust_bytecode)
+	oklog("LOADING: Database was written by a different server build; "
+	      "recompiling verbs from source ...\n");
+    return trust_bytecode;
+}
+
 void
 dbio_read_line(char *s, int n)
 {
@@ -80,6 +202,8 @@ dbio_scanf(const char *format,...)
     for (ptr = format; *ptr; ptr++) {
 	int c, n, *ip;
 	unsigned *up;
+	long *lp;
+	long long *llp;
 	char *cp;
 
 	if (isspace(*ptr)) {
@@ -108,6 +232,18 @@ dbio_scanf(const char *format,...)
 		up = va_arg(args, unsigned *);
 		n = fscanf(input, "%u", up);
 		goto finish;
+	    case 'l':		/* `SCNdN' for a 64-bit Num */
+		if (ptr[1] == 'l' && ptr[2] == 'd') {
+		    llp = va_arg(args, long long *);
+		    n = fscanf(input, "%lld", llp);
+		    ptr += 2;
+		} else if (ptr[1] == 'd') {
+		    lp = va_arg(args, long *);
+		    n = fscanf(input, "%ld", lp);
+		    ptr++;
+		} else
+		    panic("DBIO_SCANF: Unsupported directive!");
+		goto finish;
 	    case 'c':
 		cp = va_arg(args, char *);
 		n = fscanf(input, "%c", cp);
@@ -129,15 +265,20 @@ dbio_scanf(const char *format,...)
     return count;
 }
 
-int
+Num
 dbio_read_num(void)
 {
-    char s[20];
+    char s[32];
     char *p;
-    int i;
+    Num i;
+
+    if (binary_input) {
+	UNum u = read_varint();
+	return (Num) (u >> 1) ^ -(Num) (u & 1);
+    }
 
-    fgets(s, 20, input);
-    i = strtol(s, &p, 10);
+    fgets(s, sizeof(s), input);
+    i = strtoimax(s, &p, 10);
     if (isspace(*s) || *p != '\n')
 	errlog("DBIO_READ_NUM: Bad number: \"%s\" at file pos. %ld\n",
 	       s, ftell(input));
@@ -151,6 +292,18 @@ dbio_read_float(void)
     char *p;
     double d;
 
+    if (binary_input) {
+	unsigned char b[8];
+	uint64_t bits = 0;
+	int i;
+
+	read_bytes(b, 8);
+	for (i = 7; i >= 0; i--)
+	    bits = (bits << 8) | b[i];
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+    }
+
     fgets(s, 40, input);
     d = strtod(s, &p);
     if (isspace(*s) || *p != '\n')
@@ -175,6 +328,25 @@ dbio_read_string(void)
     if (str == 0)
 	str = new_stream(1024);
 
+    if (binary_input) {
+	len = checked_length(read_varint());
+	if (len < (int) sizeof(buffer)) {
+	    read_bytes(buffer, len);
+	    buffer[len] = '\0';
+	    return buffer;
+	}
+	while (len > 0) {
+	    int n = len < (int) sizeof(buffer) - 1
+		    ? len : (int) sizeof(buffer) - 1;
+
+	    read_bytes(buffer, n);
+	    buffer[n] = '\0';
+	    stream_add_string(str, buffer);
+	    len -= n;
+	}
+	return reset_stream(str);
+    }
+
   try_again:
     fgets(buffer, sizeof(buffer), input);
     len = strlen(buffer);
@@ -236,7 +408,7 @@ dbio_read_var(void)
 	r = new_float(dbio_read_float());
 	break;
     case _TYPE_MAP:
-	l = dbio_read_num();
+	l = binary_input ? checked_length(dbio_read_num()) : dbio_read_num();
 	r = new_map();
 	for (i = 0; i < l; i++) {
 	    Var key, value;
@@ -246,7 +418,7 @@ dbio_read_var(void)
 	}
 	break;
     case _TYPE_LIST:
-	l = dbio_read_num();
+	l = binary_input ? checked_length(dbio_read_num()) : dbio_read_num();
 	r = new_list(l);
 	for (i = 0; i < l; i++)
 	    r.v.list[i + 1] = dbio_read_var();
@@ -270,6 +442,7 @@ struct state {
     char prev_char;
     const char *(*fmtr) (void *);
     void *data;
+    const char *source;		/* non-null if parsing from a string */
 };
 
 static const char *
@@ -301,6 +474,9 @@ my_getc(void *data)
     struct state *s = (state *)data;
     int c;
 
+    if (s->source)
+	return *s->source ? (unsigned char) *s->source++ : EOF;
+
     c = fgetc(input);
     if (c == '.' && s->prev_char == '\n') {
 	/* end-of-verb marker in DB */
@@ -316,6 +492,78 @@ my_getc(void *data)
 static Parser_Client parser_client =
 {my_error, my_warning, my_getc};
 
+static void
+read_bytecodes(Bytecodes * bc)
+{
+    bc->numbytes_label = dbio_read_num();
+    bc->numbytes_literal = dbio_read_num();
+    bc->numbytes_fork = dbio_read_num();
+    bc->numbytes_var_name = dbio_read_num();
+    bc->numbytes_stack = dbio_read_num();
+    bc->max_stack = dbio_read_num();
+    bc->size = checked_length(dbio_read_num());
+    bc->vector = (Byte *)mymalloc(bc->size, M_BYTECODES);
+    read_bytes(bc->vector, bc->size);
+}
+
+static Program *
+read_binary_program(DB_Version version, struct state *s,
+		    const char **source_out)
+{
+    Program *p;
+    char *source = 0;
+    unsigned i;
+    int len = checked_length(read_varint());
+
+    /* Skip the source if we can use the compiled code. */
+    if (trust_bytecode)
+	fseek(input, len, SEEK_CUR);
+    else {
+	source = (char *)mymalloc(len + 1, M_STRING);
+	read_bytes(source, len);
+	source[len] = '\0';
+    }
+
+    p = new_program();
+    p->version = (DB_Version) dbio_read_num();
+    p->cg_features = dbio_read_num();
+    p->first_lineno = dbio_read_num();
+    p->num_prop_sites = dbio_read_num();
+    read_bytecodes(&p->main_vector);
+
+    p->num_literals = checked_length(dbio_read_num());
+    p->literals = p->num_literals
+	? (Var *)mymalloc(sizeof(Var) * p->num_literals, M_LIT_LIST) : 0;
+    for (i = 0; i < p->num_literals; i++)
+	p->literals[i] = dbio_read_var();
+
+    p->fork_vectors_size = checked_length(dbio_read_num());
+    p->fork_vectors = p->fork_vectors_size
+	? (Bytecodes *)mymalloc(sizeof(Bytecodes) * p->fork_vectors_size,
+				M_FORK_VECTORS) : 0;
+    for (i = 0; i < p->fork_vectors_size; i++)
+	read_bytecodes(&p->fork_vectors[i]);
+
+    p->num_var_names = checked_length(dbio_read_num());
+    p->var_names = (const char **)mymalloc(sizeof(char *) * p->num_var_names,
+					   M_NAMES);
+    for (i = 0; i < p->num_var_names; i++)
+	p->var_names[i] = dbio_read_string_intern();
+
+    if (source) {
+	free_program(p);
+	if (source_out) {
+	    *source_out = source;
+	    return 0;
+	}
+	s->source = source;
+	p = parse_program(version, parser_client, s);
+	myfree(source, M_STRING);
+    }
+
+    return p;
+}
+
 Program *
 dbio_read_program(DB_Version version, const char *(*fmtr) (void *), void *data)
 {
@@ -324,6 +572,55 @@ dbio_read_program(DB_Version version, const char *(*fmtr) (void *), void *data)
     s.prev_char = '\n';
     s.fmtr = fmtr;
     s.data = data;
+    s.source = 0;
+    if (binary_input)
+	return read_binary_program(version, &s, 0);
+    return parse_program(version, parser_client, &s);
+}
+
+Program *
+dbpriv_read_program_or_source(DB_Version version,
+			      const char *(*fmtr) (void *), void *data,
+			      const char **source)
+{
+    static Stream *str = 0;
+    struct state s;
+    const char *line;
+
+    *source = 0;
+    if (binary_input) {
+	s.prev_char = '\n';
+	s.fmtr = fmtr;
+	s.data = data;
+	s.source = 0;
+	return read_binary_program(version, &s, source);
+    }
+
+    if (str == 0)
+	str = new_stream(1000);
+    while (strcmp(line = dbio_read_string(), ".") != 0) {
+	if (feof(input)) {
+	    errlog("DBIO_READ_PROGRAM: Unexpected end of file in %s\n",
+		   fmtr ? (*fmtr) (data) : (const char *)data);
+	    reset_stream(str);
+	    return 0;
+	}
+	stream_printf(str, "%s\n", line);
+    }
+    *source = str_dup(reset_stream(str));
+    return 0;
+}
+
+Program *
+dbpriv_compile_program(DB_Version version, const char *source,
+		       const char *name)
+{
+    struct state s;
+
+    s.prev_char = '\n';
+    s.fmtr = 0;
+    s.data = (void *)name;
+    s.source = source;
     return parse_program(version, parser_client, &s);
 }
 
@@ -338,6 +635,42 @@ dbpriv_set_dbio_output(FILE * f)
     output = f;
 }
 
+static void
+write_bytes(const void *p, size_t n)
+{
+    if (fwrite(p, 1, n, output) != n)
+	throw dbpriv_dbio_failed();
+}
+
+static void
+write_varint(UNum u)
+{
+    unsigned char b[(sizeof(UNum) * 8 + 6) / 7];
+    int n = 0;
+
+    do {
+	b[n] = u & 0x7f;
+	u >>= 7;
+	if (u)
+	    b[n] |= 0x80;
+	n++;
+    } while (u);
+    write_bytes(b, n);
+}
+
+void
+dbpriv_begin_binary_output(void)
+{
+    binary_output = 1;
+    dbio_write_string(bytecode_stamp());
+}
+
+void
+dbpriv_end_binary_io(void)
+{
+    binary_input = binary_output = 0;
+}
+
 void
 dbio_printf(const char *format,...)
 {
@@ -350,9 +683,13 @@ dbio_printf(const char *format,...)
 }
 
 void
-dbio_write_num(int n)
+dbio_write_num(Num n)
 {
-    dbio_printf("%d\n", n);
+    if (binary_output)
+	write_varint(((UNum) n << 1)
+		     ^ (UNum) (n >> (sizeof(Num) * 8 - 1)));
+    else
+	dbio_printf("%" PRIdN "\n", n);
 }
 
 void
@@ -361,6 +698,18 @@ dbio_write_float(double d)
     static const char *fmt = 0;
     static char buffer[10];
 
+    if (binary_output) {
+	unsigned char b[8];
+	uint64_t bits;
+	int i;
+
+	memcpy(&bits, &d, sizeof(d));
+	for (i = 0; i < 8; i++, bits >>= 8)
+	    b[i] = bits & 0xff;
+	write_bytes(b, 8);
+	return;
+    }
+
     if (!fmt) {
 	sprintf(buffer, "%%.%dg\n", DBL_DIG + 4);
 	fmt = buffer;
@@ -377,7 +726,13 @@ dbio_write_objid(Objid oid)
 void
 dbio_write_string(const char *s)
 {
-    dbio_printf("%s\n", s ? s : "");
+    if (binary_output) {
+	size_t len = s ? strlen(s) : 0;
+
+	write_varint(len);
+	write_bytes(s, len);
+    } else
+	dbio_printf("%s\n", s ? s : "");
 }
 
 static int
@@ -419,7 +774,7 @@ dbio_write_var(Var v)
 	dbio_write_num(v.v.num);
 	break;
     case TYPE_FLOAT:
-	dbio_write_float(*v.v.fnum);
+	dbio_write_float(v.v.fnum);
 	break;
     case TYPE_MAP:
         dbio_write_num(maplength(v));
@@ -445,13 +800,71 @@ receiver(void *data, const char *line)
     dbio_printf("%s\n", line);
 }
 
+static void
+stream_receiver(void *data, const char *line)
+{
+    stream_printf((Stream *)data, "%s\n", line);
+}
+
+static void
+write_bytecodes(Bytecodes * bc)
+{
+    dbio_write_num(bc->numbytes_label);
+    dbio_write_num(bc->numbytes_literal);
+    dbio_write_num(bc->numbytes_fork);
+    dbio_write_num(bc->numbytes_var_name);
+    dbio_write_num(bc->numbytes_stack);
+    dbio_write_num(bc->max_stack);
+    dbio_write_num(bc->size);
+    write_bytes(bc->vector, bc->size);
+}
+
+static void
+write_binary_program(Program * program)
+{
+    Stream *s = new_stream(1000);
+    unsigned i;
+
+    unparse_program(program, stream_receiver, s, 1, 0, MAIN_VECTOR);
+    dbio_write_string(stream_contents(s));
+    free_stream(s);
+
+    dbio_write_num(program->version);
+    dbio_write_num(program->cg_features);
+    dbio_write_num(program->first_lineno);
+    dbio_write_num(program->num_prop_sites);
+    write_bytecodes(&program->main_vector);
+
+    dbio_write_num(program->num_literals);
+    for (i = 0; i < program->num_literals; i++)
+	dbio_write_var(program->literals[i]);
+
+    dbio_write_num(program->fork_vectors_size);
+    for (i = 0; i < program->fork_vectors_size; i++)
+	write_bytecodes(&program->fork_vectors[i]);
+
+    dbio_write_num(program->num_var_names);
+    for (i = 0; i < program->num_var_names; i++)
+	dbio_write_string(program->var_names[i]);
+}
+
 void
 dbio_write_program(Program * program)
 {
+    if (binary_output) {
+	write_binary_program(program);
+	return;
+    }
     unparse_program(program, receiver, 0, 1, 0, MAIN_VECTOR);
     dbio_printf(".\n");
 }
 
+void
+dbpriv_write_program_source(const char *source)
+{
+    dbio_printf("%s.\n", source);
+}
+
 void
 dbio_write_forked_program(Program * program, int f_index)
 {
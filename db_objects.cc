@@ -131,6 +131,76 @@ dbpriv_assign_nonce(Object *o)
     o->nonce = nonce++;
 }
 
+/* Appends the ancestors of `o' not already in the list, in the same
+ * depth-first order `db_ancestors()' uses.  Hierarchies are shallow,
+ * so a linear search for duplicates beats clearing the bit array.
+ */
+static void
+add_ancestors(Object *o, Object ***plist, int *pn, int *pmax)
+{
+    int i, c, k;
+    Var parent, parents = o->parents;
+
+    if (TYPE_OBJ == parents.type) {
+	if (NOTHING == parents.v.obj)
+	    return;
+	parents = enlist_var(var_ref(parents));
+    } else
+	parents = var_ref(parents);
+
+    FOR_EACH(parent, parents, i, c) {
+	Object *p = dbpriv_find_object(parent.v.obj);
+
+	if (!p)
+	    continue;
+	for (k = 0; k < *pn; k++)
+	    if ((*plist)[k] == p)
+		break;
+	if (k < *pn)
+	    continue;
+
+	if (*pn == *pmax) {
+	    *pmax = *pmax ? *pmax * 2 : 8;
+	    *plist = *plist
+		     ? (Object **)myrealloc(*plist, *pmax * sizeof(Object *),
+					    M_ANCESTORS)
+		     : (Object **)mymalloc(*pmax * sizeof(Object *),
+					   M_ANCESTORS);
+	}
+	(*plist)[(*pn)++] = p;
+	add_ancestors(p, plist, pn, pmax);
+    }
+
+    free_var(parents);
+}
+
+Object **
+dbpriv_ancestors(Object *o, int *count)
+{
+    if (o->nancestors < 0 || o->ancestors_nonce != o->nonce) {
+	Object **list = o->ancestors;
+	int n = 0, max = list ? o->nancestors : 0;
+
+	add_ancestors(o, &list, &n, &max);
+
+	o->ancestors = list;
+	o->nancestors = n;
+	o->ancestors_nonce = o->nonce;
+    }
+
+    *count = o->nancestors;
+    return o->ancestors;
+}
+
+void
+dbpriv_free_ancestors(Object *o)
+{
+    if (o->ancestors)
+	myfree(o->ancestors, M_ANCESTORS);
+    o->ancestors = 0;
+    o->nancestors = -1;
+}
+
 void
 dbpriv_after_load(void)
 {
@@ -157,6 +227,8 @@ dbpriv_new_object(void)
     ensure_new_object();
     o = objects[num_objects] = (Object *)mymalloc(sizeof(Object), M_OBJECT);
     o->id = num_objects;
+    o->ancestors = 0;
+    o->nancestors = -1;
     num_objects++;
 
     return o;
@@ -170,6 +242,8 @@ dbpriv_new_anonymous_object(void)
     ensure_new_object();
     o = objects[num_objects] = (Object *)mymalloc(sizeof(Object), M_ANON);
     o->id = NOTHING;
+    o->ancestors = 0;
+    o->nancestors = -1;
     num_objects++;
 
     return o;
@@ -202,6 +276,8 @@ db_init_object(Object *o)
     o->propdefs.l = 0;
 
     o->verbdefs = 0;
+
+    dbpriv_assign_nonce(o);
 }
 
 Objid
@@ -222,11 +298,11 @@ db_destroy_object(Objid oid)
     Verbdef *v, *w;
     int i;
 
-    db_priv_affected_callable_verb_lookup();
-
     if (!o)
 	panic("DB_DESTROY_OBJECT: Invalid object!");
 
+    db_priv_affected_callable_verb_lookup(o, VC_OBJECT_DESTROYED);
+
     if (o->location.v.obj != NOTHING ||
 	o->contents.v.list[0].v.num != 0 ||
 	(o->parents.type == TYPE_OBJ && o->parents.v.obj != NOTHING) ||
@@ -263,13 +339,14 @@ db_destroy_object(Objid oid)
     o->nval = 0;
 
     for (v = o->verbdefs; v; v = w) {
-	if (v->program)
-	    free_program(v->program);
+	dbpriv_free_verb_program(v);
 	free_str(v->name);
 	w = v->next;
 	myfree(v, M_VERBDEF);
     }
 
+    dbpriv_free_ancestors(o);
+
     myfree(objects[oid], M_OBJECT);
     objects[oid] = 0;
 }
@@ -369,6 +446,9 @@ db_destroy_anonymous_object(void *obj)
     Verbdef *v, *w;
     int i;
 
+    if (o->verbdefs)
+	db_priv_affected_callable_verb_lookup(o, VC_OBJECT_DESTROYED);
+
     free_str(o->name);
     o->name = NULL;
 
@@ -385,13 +465,14 @@ db_destroy_anonymous_object(void *obj)
     o->nval = 0;
 
     for (v = o->verbdefs; v; v = w) {
-	if (v->program)
-	    free_program(v->program);
+	dbpriv_free_verb_program(v);
 	free_str(v->name);
 	w = v->next;
 	myfree(v, M_VERBDEF);
     }
 
+    dbpriv_free_ancestors(o);
+
     dbpriv_set_object_flag(o, FLAG_INVALID);
 
     /* Since this object could possibly be the root of a cycle, final
@@ -560,6 +641,8 @@ db_object_bytes(Var obj)
 	count += memo_strlen(v->name) + 1;
 	if (v->program)
 	    count += program_bytes(v->program);
+	else if (v->source)
+	    count += memo_strlen(v->source) + 1;
     }
 
     count += sizeof(Propdef) * o->propdefs.cur_length;
@@ -886,7 +969,7 @@ db_change_parents(Var obj, Var new_parents, Var anon_kids)
 	/* In any case, don't clear the cache. */
 	;
     } else {
-	db_priv_affected_callable_verb_lookup();
+	db_priv_affected_callable_verb_lookup(o, VC_PARENT_CHANGE);
     }
 
     Var old_parents = o->parents;
@@ -1072,29 +1155,18 @@ db_object_isa(Var object, Var parent)
     if (equality(object, parent, 0))
 	return 1;
 
-    Object *o, *t;
-
-    o = (TYPE_OBJ == object.type) ?
-        dbpriv_find_object(object.v.obj) :
-        object.v.anon;
+    /* anonymous objects are never ancestors */
+    if (TYPE_OBJ != parent.type)
+	return 0;
 
-    Var ancestor, ancestors = enlist_var(var_ref(o->parents));
+    Object *o, *t;
+    int i, c;
 
-    while (listlength(ancestors) > 0) {
-	POP_TOP(ancestor, ancestors);
+    o = dbpriv_dereference(object);
 
-	if (ancestor.v.obj == NOTHING)
-	    continue;
-
-	if (equality(ancestor, parent, 0)) {
-	    free_var(ancestors);
+    FOR_EACH_ANCESTOR(t, o, i, c)
+	if (t->id == parent.v.obj)
 	    return 1;
-	}
-
-	t = dbpriv_find_object(ancestor.v.obj);
-
-	ancestors = listconcat(ancestors, enlist_var(var_ref(t->parents)));
-    }
 
     return 0;
 }
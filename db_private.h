@@ -30,6 +30,7 @@ typedef struct Verbdef Verbdef;
 struct Verbdef {
     const char *name;
     Program *program;
+    const char *source;		/* program text not yet compiled, if any */
     Objid owner;
     short perms;
     short prep;
@@ -80,6 +81,16 @@ typedef struct Object {
      * globally unique.
      */
     unsigned int nonce;
+
+    /* A lazily built, flat copy of the object's ancestors, in the
+     * order `db_ancestors()' returns them.  It is only good while
+     * `ancestors_nonce' matches `nonce' -- changing the parents of an
+     * object or of any of its ancestors gives it a new nonce.  A
+     * count of -1 means it hasn't been built.
+     */
+    struct Object **ancestors;
+    int nancestors;
+    unsigned int ancestors_nonce;
 } Object;
 
 /*
@@ -100,15 +111,24 @@ typedef struct Object {
  */
 
 #ifdef RONG
-#define db_priv_affected_callable_verb_lookup() (db_verb_generation++)
+#define db_priv_affected_callable_verb_lookup(o, reason) (db_verb_generation++)
                                  /* The choice of a new generation. */
 extern unsigned int db_verb_generation;
 #endif
 
-extern void db_priv_affected_callable_verb_lookup(void);
+enum vc_reason {
+    VC_VERB_CHANGE, VC_PARENT_CHANGE, VC_OBJECT_DESTROYED,
+    VC_NUM_REASONS
+};
+
+/* Evicts the cached lookups that depend on `o' (entries keyed on `o'
+ * or one of its descendants).  `o' must still be intact.
+ */
+extern void db_priv_affected_callable_verb_lookup(Object *o,
+						  enum vc_reason reason);
 
 #else /* no cache */
-#define db_priv_affected_callable_verb_lookup()
+#define db_priv_affected_callable_verb_lookup(o, reason)
 #endif
 
 /*********** Objects ***********/
@@ -118,6 +138,24 @@ extern void db_write_anonymous(Var);
 
 extern void dbpriv_assign_nonce(Object *);
 
+extern Object **dbpriv_ancestors(Object *, int *count);
+				/* Returns the cached ancestors of the object
+				 * (not including the object itself) and sets
+				 * `*count'.  Nothing is allocated unless the
+				 * cache has to be rebuilt.  The array is owned
+				 * by the object; don't hold on to it across
+				 * anything that could change parentage.
+				 */
+extern void dbpriv_free_ancestors(Object *);
+
+/* Iterates `a' over the ancestors of `o', using `i' and `c' as the
+ * index and count.  Every ancestor visited is a valid object.
+ */
+#define FOR_EACH_ANCESTOR(a, o, i, c)					\
+    for (Object **a##_v = ((i) = 0, dbpriv_ancestors(o, &(c)));	\
+	 (i) < (c) && ((a) = a##_v[(i)], 1);				\
+	 (i)++)
+
 extern Objid dbpriv_object_owner(Object *);
 extern void dbpriv_set_object_owner(Object *, Objid owner);
 
@@ -203,6 +241,19 @@ extern void dbpriv_build_prep_table(void);
 				 * prepositional-phrase matching table.
 				 */
 
+extern void dbpriv_set_verb_source(db_verb_handle, const char *source);
+				/* Stores SOURCE (which must be a string that
+				 * the verb can take ownership of) for the
+				 * verb's program to be compiled from the first
+				 * time it's needed.
+				 */
+extern Program *dbpriv_verb_program(Verbdef *, Objid definer);
+				/* Returns the verb's program, compiling its
+				 * pending source if necessary, or null if it
+				 * has none (or its source doesn't compile).
+				 */
+extern void dbpriv_free_verb_program(Verbdef *);
+
 /*********** DBIO ***********/
 
 class dbpriv_dbio_failed: public std::exception
@@ -225,6 +276,42 @@ public:
 extern void dbpriv_set_dbio_input(FILE *);
 extern void dbpriv_set_dbio_output(FILE *);
 
+extern int dbpriv_begin_binary_input(void);
+				/* Switches DBIO input to the binary encoding
+				 * and reads the bytecode stamp written by
+				 * dbpriv_begin_binary_output().  Returns true
+				 * if compiled verb programs in the file can be
+				 * used as is, false if they'll be recompiled.
+				 */
+extern int dbpriv_read_binary_count(int *n);
+				/* Reads a count from the binary region into
+				 * *N.  Returns false if it's negative or
+				 * larger than the rest of the file could hold.
+				 * Hitting the end of the file while reading
+				 * binary input throws `dbpriv_dbio_failed'.
+				 */
+extern Program *dbpriv_read_program_or_source(DB_Version version,
+					     const char *(*fmtr) (void *),
+					     void *data,
+					     const char **source);
+				/* Like dbio_read_program(), except that if the
+				 * file doesn't hold a usable compiled form of
+				 * the program, returns null and sets SOURCE to
+				 * a new string holding its text instead.
+				 */
+extern Program *dbpriv_compile_program(DB_Version version,
+				       const char *source,
+				       const char *name);
+extern void dbpriv_write_program_source(const char *source);
+				/* Writes program text as read by
+				 * dbpriv_read_program_or_source().  Text
+				 * output only.
+				 */
+
+extern void dbpriv_begin_binary_output(void);
+extern void dbpriv_end_binary_io(void);
+				/* Switches DBIO back to the text encoding. */
+
 /****/
 
 static inline Object *
@@ -25,7 +25,9 @@
 #include "config.h"
 #include "db.h"
 #include "db_private.h"
+#include "db_tune.h"
 #include "list.h"
+#include "log.h"
 #include "server.h"
 #include "storage.h"
 #include "utils.h"
@@ -65,6 +67,33 @@ properties_offset(Var target, Var _this)
     return i <= c ? offset : -1;
 }
 
+/*
+ * Like `properties_offset', but uses the cached ancestors of `o' and
+ * allocates nothing.  `o' may be null (an invalid parent).  Only for
+ * use when no change to parentage is in progress.
+ */
+static int
+ancestor_properties_offset(Object *target, Object *o)
+{
+    Object *ancestor;
+    int i, c, offset;
+
+    if (!o)
+	return -1;
+    if (o == target)
+	return 0;
+
+    offset = o->propdefs.cur_length;
+
+    FOR_EACH_ANCESTOR(ancestor, o, i, c) {
+	if (ancestor == target)
+	    return offset;
+	offset += ancestor->propdefs.cur_length;
+    }
+
+    return -1;
+}
+
 /*
  * Returns true iff `o' defines a property named `pname'.
  */
@@ -449,12 +478,127 @@ get_bi_value(db_prop_handle h, Var * value)
     }
 }
 
+static unsigned int prop_cache_hits = 0;
+static unsigned int prop_cache_misses = 0;
+
+void
+db_init_prop_cache(db_prop_cache *cache, const void *site)
+{
+    cache->site = site;
+    cache->name = 0;
+    cache->built_in = BP_NONE;
+    cache->definer = 0;
+    cache->defname = 0;
+    cache->nhops = 0;
+}
+
+void
+db_clear_prop_cache(db_prop_cache *cache)
+{
+    if (cache->name)
+	free_str(cache->name);
+    if (cache->defname)
+	free_str(cache->defname);
+    db_init_prop_cache(cache, cache->site);
+}
+
+/*
+ * Tries the location remembered by `cache'.  Returns true and fills
+ * in `h' (and `value') on a hit.  The property definitions of an
+ * object's ancestors can only change in ways that also change the
+ * object's nonce, with the exception of renaming, which is caught by
+ * checking that the definer's propdef still has the same name.
+ */
+static int
+try_prop_cache(db_prop_cache *cache, Object *o, const char *name,
+	       Var *value, db_prop_handle *h)
+{
+    if (cache->name != name)
+	return 0;
+
+    if (cache->built_in) {
+	h->built_in = cache->built_in;
+	h->definer = 0;
+	h->ptr = o;
+	if (value)
+	    get_bi_value(*h, value);
+	return 1;
+    }
+
+    Object *definer = (Object *)cache->definer;
+
+    if (cache->hops[0].object != o
+	|| cache->hops[0].nonce != o->nonce
+	|| cache->index >= definer->propdefs.cur_length
+	|| definer->propdefs.l[cache->index].name != cache->defname)
+	return 0;
+
+    h->built_in = BP_NONE;
+    h->definer = definer;
+    h->ptr = o->propval + cache->hops[0].offset;
+
+    if (value) {
+	int k;
+
+	for (k = 0; k < cache->nhops; k++) {
+	    Object *t = (Object *)cache->hops[k].object;
+	    Pval *prop;
+
+	    if (t->nonce != cache->hops[k].nonce)
+		return 0;
+	    prop = t->propval + cache->hops[k].offset;
+	    if (prop->var.type != TYPE_CLEAR) {
+		*value = prop->var;
+		return 1;
+	    }
+	}
+	return 0;		/* ran off the end of an incomplete chain */
+    }
+
+    return 1;
+}
+
+static void
+fill_prop_cache(db_prop_cache *cache, const char *name, db_prop_handle h,
+		int index)
+{
+    db_clear_prop_cache(cache);
+    cache->name = str_ref(name);
+    cache->built_in = h.built_in;
+    if (!h.built_in) {
+	Object *definer = (Object *)h.definer;
+
+	cache->definer = definer;
+	cache->defname = str_ref(definer->propdefs.l[index].name);
+	cache->index = index;
+    }
+}
+
+static void
+add_prop_cache_hop(db_prop_cache *cache, Object *o, Pval *prop)
+{
+    if (cache->nhops < DB_PROP_CACHE_HOPS) {
+	cache->hops[cache->nhops].object = o;
+	cache->hops[cache->nhops].nonce = o->nonce;
+	cache->hops[cache->nhops].offset = prop - o->propval;
+	cache->nhops++;
+    }
+}
+
 /* does NOT consume `obj' and `name' */
 db_prop_handle
 db_find_property(Var obj, const char *name, Var *value)
+{
+    return db_find_property_cached(obj, name, value, 0);
+}
+
+/* does NOT consume `obj' and `name' */
+db_prop_handle
+db_find_property_cached(Var obj, const char *name, Var *value,
+			db_prop_cache *cache)
 {
     Object *o = dbpriv_dereference(obj);
-    int hash = str_hash(name);
+    int hash;
 
     static struct {
 	const char *name;
@@ -469,12 +613,23 @@ db_find_property(Var obj, const char *name, Var *value)
     db_prop_handle h;
     int i, n;
 
+    if (cache) {
+	if (try_prop_cache(cache, o, name, value, &h)) {
+	    prop_cache_hits++;
+	    return h;
+	}
+	prop_cache_misses++;
+	db_clear_prop_cache(cache);
+    }
+
     if (!ptable_init) {
 	for (i = 0; i < Arraysize(ptable); i++)
 	    ptable[i].hash = str_hash(ptable[i].name);
 	ptable_init = 1;
     }
 
+    hash = str_hash(name);
+
     h.definer = 0;
     h.ptr = 0;
 
@@ -484,14 +639,14 @@ db_find_property(Var obj, const char *name, Var *value)
 	    h.ptr = o;
 	    if (value)
 		get_bi_value(h, value);
+	    if (cache)
+		fill_prop_cache(cache, name, h, 0);
 	    return h;
 	}
     }
 
     h.built_in = BP_NONE;
 
-    Var ancestor, ancestors = db_ancestors(obj, false);
-
     Proplist *props = &(o->propdefs);
     Propdef *defs = props->l;
     int length = props->cur_length;
@@ -509,12 +664,7 @@ db_find_property(Var obj, const char *name, Var *value)
     Object *t;
     int ai, ac;
 
-    FOR_EACH(ancestor, ancestors, ai, ac) {
-	if (!is_valid(ancestor))
-	    continue;
-
-	t = dbpriv_dereference(ancestor);
-
+    FOR_EACH_ANCESTOR(t, o, ai, ac) {
 	props = &(t->propdefs);
 	defs = props->l;
 	length = props->cur_length;
@@ -530,15 +680,28 @@ db_find_property(Var obj, const char *name, Var *value)
 
  done:
 
-    free_var(ancestors);
-
     if (!h.ptr)
 	return h;
 
+    if (cache) {
+	fill_prop_cache(cache, name, h, i);
+	add_prop_cache_hop(cache, o, (Pval *)h.ptr);
+    }
+
     if (value) {
 	Pval *prop = (Pval *)h.ptr;
-
-	while (prop->var.type == TYPE_CLEAR) {
+	int found = 0;
+
+	/* When filling a cache, keep walking past the value all the
+	 * way up to the definer (or as far as the cache can remember)
+	 * so that the cached chain survives values being cleared.
+	 */
+	while (prop->var.type == TYPE_CLEAR
+	       || (cache && o != h.definer && cache->nhops < DB_PROP_CACHE_HOPS)) {
+	    if (!found && prop->var.type != TYPE_CLEAR) {
+		*value = prop->var;
+		found = 1;
+	    }
 	    /* We take a few liberties at this point.  If a property
 	     * value on an object is clear, then its `definer' must be
 	     * a permanent (not an anonymous) object, because
@@ -547,25 +710,50 @@ db_find_property(Var obj, const char *name, Var *value)
 	     */
 	    if (TYPE_LIST == o->parents.type) {
 		Var parent, parents = o->parents;
-		int i2, c2, offset = 0;
-		FOR_EACH(parent, parents, i2, c2)
-		    if ((offset = properties_offset(Var::new_obj(((Object *)h.definer)->id), parent)) > -1)
+		Object *next = 0;
+		int i2, c2, offset = -1;
+		FOR_EACH(parent, parents, i2, c2) {
+		    next = dbpriv_find_object(parent.v.obj);
+		    if ((offset = ancestor_properties_offset((Object *)h.definer, next)) > -1)
 			break;
-		o = dbpriv_find_object(parent.v.obj);
+		}
+		if (offset < 0)
+		    panic("No parent inherits the property in DB_FIND_PROPERTY_CACHED!");
+		o = next;
 		prop = o->propval + offset + i;
 	    }
 	    else if (TYPE_OBJ == o->parents.type && NOTHING != o->parents.v.obj) {
-		int offset = properties_offset(Var::new_obj(((Object *)h.definer)->id), o->parents);
 		o = dbpriv_find_object(o->parents.v.obj);
-		prop = o->propval + offset + i;
+		prop = o->propval + ancestor_properties_offset((Object *)h.definer, o) + i;
 	    }
+	    if (cache)
+		add_prop_cache_hop(cache, o, prop);
 	}
-	*value = prop->var;
+	if (!found)
+	    *value = prop->var;
     }
 
     return h;
 }
 
+Var
+db_prop_cache_stats(void)
+{
+    Var v = new_list(2);
+
+    v.v.list[1] = Var::new_int(prop_cache_hits);
+    v.v.list[2] = Var::new_int(prop_cache_misses);
+
+    return v;
+}
+
+void
+db_log_prop_cache_stats(void)
+{
+    oklog("Property cache stat summary: %u hits, %u misses\n",
+	  prop_cache_hits, prop_cache_misses);
+}
+
 int
 db_is_property_defined_on(db_prop_handle h, Var obj)
 {
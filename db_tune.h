@@ -4,3 +4,8 @@
 
 extern void db_log_cache_stats(void);
 extern Var db_verb_cache_stats(void);
+
+extern Var db_verb_compilation_stats(void);
+
+extern void db_log_prop_cache_stats(void);
+extern Var db_prop_cache_stats(void);
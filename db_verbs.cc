@@ -27,6 +27,7 @@
 
 #include "config.h"
 #include "db.h"
+#include "db_io.h"
 #include "db_private.h"
 #include "db_tune.h"
 #include "list.h"
@@ -35,6 +36,7 @@
 #include "program.h"
 #include "server.h"
 #include "storage.h"
+#include "streams.h"
 #include "utils.h"
 
 
@@ -206,7 +208,7 @@ db_add_verb(Var obj, const char *vnames, Objid owner, unsigned flags,
     Verbdef *v, *newv;
     int count;
 
-    db_priv_affected_callable_verb_lookup();
+    db_priv_affected_callable_verb_lookup(o, VC_VERB_CHANGE);
 
     newv = (Verbdef *)mymalloc(sizeof(Verbdef), M_VERBDEF);
     newv->name = vnames;
@@ -215,6 +217,7 @@ db_add_verb(Var obj, const char *vnames, Objid owner, unsigned flags,
     newv->prep = prep;
     newv->next = 0;
     newv->program = 0;
+    newv->source = 0;
     if (o->verbdefs) {
 	for (v = o->verbdefs, count = 2; v->next; v = v->next, ++count);
 	v->next = newv;
@@ -282,7 +285,7 @@ db_delete_verb(db_verb_handle vh)
     Verbdef *v = h->verbdef;
     Verbdef *vv;
 
-    db_priv_affected_callable_verb_lookup();
+    db_priv_affected_callable_verb_lookup(o, VC_VERB_CHANGE);
 
     vv = o->verbdefs;
     if (vv == v)
@@ -293,8 +296,7 @@ db_delete_verb(db_verb_handle vh)
 	vv->next = v->next;
     }
 
-    if (v->program)
-	free_program(v->program);
+    dbpriv_free_verb_program(v);
     if (v->name)
 	free_str(v->name);
     myfree(v, M_VERBDEF);
@@ -304,19 +306,18 @@ db_verb_handle
 db_find_command_verb(Objid oid, const char *verb,
 		     db_arg_spec dobj, unsigned prep, db_arg_spec iobj)
 {
-    Object *o;
+    Object *start = dbpriv_find_object(oid), *o;
     Verbdef *v;
     static handle h;
     db_verb_handle vh;
 
-    Var ancestors;
-    Var ancestor;
+    Object **ancestors;
     int i, c;
 
-    ancestors = db_ancestors(Var::new_obj(oid), true);
+    ancestors = dbpriv_ancestors(start, &c);
 
-    FOR_EACH(ancestor, ancestors, i, c) {
-	o = dbpriv_find_object(ancestor.v.obj);
+    for (i = -1; i < c; i++) {
+	o = i < 0 ? start : ancestors[i];
 	for (v = o->verbdefs; v; v = v->next) {
 	    db_arg_spec vdobj = (db_arg_spec)((v->perms >> DOBJSHIFT) & OBJMASK);
 	    db_arg_spec viobj = (db_arg_spec)((v->perms >> IOBJSHIFT) & OBJMASK);
@@ -329,15 +330,11 @@ db_find_command_verb(Objid oid, const char *verb,
 		h.verbdef = v;
 		vh.ptr = &h;
 
-		free_var(ancestors);
-
 		return vh;
 	    }
 	}
     }
 
-    free_var(ancestors);
-
     vh.ptr = 0;
 
     return vh;
@@ -350,6 +347,13 @@ int verbcache_hit = 0;
 int verbcache_neg_hit = 0;
 int verbcache_miss = 0;
 
+/* Per-reason invalidation counters: how many times the cache was
+ * invalidated for each reason, and how many entries were evicted.
+ */
+static const char *vc_reason_names[] = { "verb", "parents", "destroy" };
+static int vc_invalidations[VC_NUM_REASONS];
+static int vc_evictions[VC_NUM_REASONS];
+
 typedef struct vc_entry vc_entry;
 
 struct vc_entry {
@@ -368,26 +372,55 @@ static int vc_size = 0;
 
 #define DEFAULT_VC_SIZE 7507
 
+/* Returns true if `target' is `o' or one of its ancestors.  Uses the
+ * flat, cached ancestor list, so a diamond-shaped hierarchy is walked
+ * once per entry rather than once per path.  Callers invalidate before
+ * touching parentage, so the cache is good here.
+ */
+static int
+vc_depends_on(Object *o, Object *target)
+{
+    Object *a;
+    int i, c;
+
+    if (o == target)
+	return 1;
+
+    FOR_EACH_ANCESTOR(a, o, i, c)
+	if (a == target)
+	    return 1;
+
+    return 0;
+}
+
+/* Every entry in the cache is keyed on the first object with verbs
+ * encountered during a lookup, and the result only depends on that
+ * object and its ancestors.  So when `o' changes, only the entries
+ * keyed on `o' or one of its descendants need to go.
+ */
 void
-db_priv_affected_callable_verb_lookup(void)
+db_priv_affected_callable_verb_lookup(Object *o, enum vc_reason reason)
 {
     int i;
-    vc_entry *vc, *vc_next;
+    vc_entry *vc, **prev;
 
     if (vc_table == NULL)
 	return;
 
     db_verb_generation++;
+    vc_invalidations[reason]++;
 
     for (i = 0; i < vc_size; i++) {
-	vc = vc_table[i];
-	while (vc) {
-	    vc_next = vc->next;
-	    free_str(vc->verbname);
-	    myfree(vc, M_VC_ENTRY);
-	    vc = vc_next;
+	prev = &vc_table[i];
+	while ((vc = *prev) != NULL) {
+	    if (vc_depends_on(vc->object, o)) {
+		*prev = vc->next;
+		free_str(vc->verbname);
+		myfree(vc, M_VC_ENTRY);
+		vc_evictions[reason]++;
+	    } else
+		prev = &vc->next;
 	}
-	vc_table[i] = NULL;
     }
 }
 
@@ -425,7 +458,7 @@ db_verb_cache_stats(void)
 	histogram[depth]++;
     }
 
-    v = new_list(5);
+    v = new_list(6);
     v.v.list[1].type = TYPE_INT;
     v.v.list[1].v.num = verbcache_hit;
     v.v.list[2].type = TYPE_INT;
@@ -439,6 +472,18 @@ db_verb_cache_stats(void)
 	vv.v.list[i + 1].type = TYPE_INT;
 	vv.v.list[i + 1].v.num = histogram[i];
     }
+    vv = (v.v.list[6] = new_list(VC_NUM_REASONS));
+    for (i = 0; i < VC_NUM_REASONS; i++) {
+	Var r = new_list(3);
+
+	r.v.list[1].type = TYPE_STR;
+	r.v.list[1].v.str = str_dup(vc_reason_names[i]);
+	r.v.list[2].type = TYPE_INT;
+	r.v.list[2].v.num = vc_invalidations[i];
+	r.v.list[3].type = TYPE_INT;
+	r.v.list[3].v.num = vc_evictions[i];
+	vv.v.list[i + 1] = r;
+    }
     return v;
 }
 
@@ -463,6 +508,9 @@ db_log_cache_stats(void)
 
     oklog("Verb cache stat summary: %d hits, %d misses, %d generations\n",
 	  verbcache_hit, verbcache_miss, db_verb_generation);
+    for (i = 0; i < VC_NUM_REASONS; i++)
+	oklog("Invalidated by %s: %d times, %d entries evicted\n",
+	      vc_reason_names[i], vc_invalidations[i], vc_evictions[i]);
     oklog("Depth   Count\n");
     for (i = 0; i < VC_CACHE_STATS_MAX + 1; i++)
 	oklog("%-5d   %-5d\n", i, histogram[i]);
@@ -484,45 +532,48 @@ struct verbdef_definer_data {
 static struct verbdef_definer_data
 find_callable_verbdef(Object *start, const char *verb)
 {
-    Object *o = NULL;
-    Verbdef *v = NULL;
+    struct verbdef_definer_data data;
+    Object *o;
+    Verbdef *v;
+    int i, c;
 
-    if ((v = find_verbdef_by_name(start, verb, 1)) != NULL) {
-	struct verbdef_definer_data data;
-	data.o = start;
-	data.v = v;
+    data.o = start;
+    data.v = find_verbdef_by_name(start, verb, 1);
+    if (data.v)
 	return data;
-    }
-
-    Var stack = enlist_var(var_ref(start->parents));
-
-    while (listlength(stack) > 0) {
-	Var top;
 
-	POP_TOP(top, stack);
-
-	o = dbpriv_find_object(top.v.obj);
-	free_var(top);
+    FOR_EACH_ANCESTOR(o, start, i, c)
+	if ((v = find_verbdef_by_name(o, verb, 1)) != NULL) {
+	    data.o = o;
+	    data.v = v;
+	    return data;
+	}
 
-	if (!o) /* if it's invalid, AKA $nothing */
-	    continue;
+    data.o = NULL;
+    return data;
+}
 
-	if ((v = find_verbdef_by_name(o, verb, 1)) != NULL)
-	    break;
+#ifdef VERB_CACHE
+/* The most starting points whose failed lookups we remember while
+ * walking the ancestors in `db_find_callable_verb'.  Past this, we
+ * just probe the cache for starting points we could have skipped.
+ */
+#define VC_MAX_MISSES 8
 
-	if (TYPE_OBJ == o->parents.type)
-	    stack = listinsert(stack, var_ref(o->parents), 1);
-	else
-	    stack = listconcat(var_ref(o->parents), stack);
-    }
+static int
+vc_covered_by_miss(Object *o, Object **misses, int nmisses)
+{
+    Object *ancestor;
+    int k, i, c;
 
-    free_var(stack);
+    for (k = 0; k < nmisses; k++)
+	FOR_EACH_ANCESTOR(ancestor, misses[k], i, c)
+	    if (ancestor == o)
+		return 1;
 
-    struct verbdef_definer_data data;
-    data.o = o;
-    data.v = v;
-    return data;
+    return 0;
 }
+#endif
 
 /* does NOT consume `recv' and `verb' */
 db_verb_handle
@@ -539,44 +590,35 @@ db_find_callable_verb(Var recv, const char *verb)
 #endif
     db_verb_handle vh;
 
+    vh.ptr = 0;
+
+    if (!is_valid(recv))
+	return vh;
+
+    o = dbpriv_dereference(recv);
+
 #ifdef VERB_CACHE
     /*
-     * First, find the `first_parent_with_verbs'.  This is the first
-     * ancestor of a parent that actually defines a verb.  If I define
-     * verbs, then `first_parent_with_verbs' is me.  Otherwise,
-     * iterate through each parent in turn, find the first ancestor
-     * with verbs, and then try to find the verb starting at that
-     * point.
+     * Walk the receiver and its ancestors, in lookup order, looking
+     * for objects that actually define verbs.  Each one found is a
+     * `first_parent_with_verbs' -- a starting point for a lookup,
+     * and the key for the verb cache.  A failed lookup from a
+     * starting point covers all of that object's ancestors, so they
+     * are skipped as the walk continues on to the next branch of the
+     * inheritance graph.
      */
-    Var stack = new_list(0);
-    stack = listappend(stack, var_ref(recv));
-
-    try_again:
-    while (listlength(stack) > 0) {
-	Var top;
-
-	POP_TOP(top, stack);
-
-	if (top.is_object() && is_valid(top)) {
-	    o = dbpriv_dereference(top);
-	    if (o->verbdefs == NULL) {
-		/* keep looking */
-		stack = (TYPE_OBJ == o->parents.type)
-		        ? listinsert(stack, var_ref(o->parents), 1)
-		        : listconcat(var_ref(o->parents), stack);
-		free_var(top);
-		continue;
-	    }
-	}
-	else {
-	    /* just consume it */
-	    free_var(top);
-	    continue;
-	}
+    Object *start = o, **ancestors;
+    Object *misses[VC_MAX_MISSES];
+    int nmisses = 0, ai, ac;
+
+    ancestors = dbpriv_ancestors(start, &ac);
 
-	free_var(top);
+    for (ai = -1; ai < ac; ai++) {
+	o = ai < 0 ? start : ancestors[ai];
 
-	assert(o != NULL);
+	if (o->verbdefs == NULL
+	    || vc_covered_by_miss(o, misses, nmisses))
+	    continue;
 
 	unsigned long first_parent_with_verbs = (unsigned long)o;
 
@@ -597,29 +639,22 @@ db_find_callable_verb(Var recv, const char *verb)
 		if (vc->h.verbdef) {
 		    verbcache_hit++;
 		    vh.ptr = &vc->h;
-		} else {
-		    verbcache_neg_hit++;
-		    vh.ptr = 0;
-		}
-		if (vh.ptr) {
-		    free_var(stack);
 		    return vh;
 		}
-		goto try_again;
+		verbcache_neg_hit++;
+		break;
 	    }
 	}
 
+	if (vc) {
+	    if (nmisses < VC_MAX_MISSES)
+		misses[nmisses++] = o;
+	    continue;
+	}
+
 	/* a swing and a miss */
 	verbcache_miss++;
 
-#else
-	if (recv.is_object() && is_valid(recv))
-	    o = dbpriv_dereference(recv);
-	else
-	    o = NULL;
-#endif
-
-#ifdef VERB_CACHE
 	/*
 	 * Add the entry to the verbcache whether we find it or not.  This
 	 * means we do "negative caching", keeping track of failed lookups
@@ -634,37 +669,31 @@ db_find_callable_verb(Var recv, const char *verb)
 	new_vc->h.verbdef = NULL;
 	new_vc->next = vc_table[bucket];
 	vc_table[bucket] = new_vc;
-#endif
 
 	struct verbdef_definer_data data = find_callable_verbdef(o, verb);
 	if (data.o != NULL && data.v != NULL) {
-
-#ifdef VERB_CACHE
-	    free_var(stack);
-
 	    new_vc->h.definer = data.o;
 	    new_vc->h.verbdef = data.v;
 	    vh.ptr = &new_vc->h;
-#else
-	    h.definer = data.o;
-	    h.verbdef = data.v;
-	    vh.ptr = &h;
-#endif
 	    return vh;
 	}
 
-#ifdef VERB_CACHE
+	if (nmisses < VC_MAX_MISSES)
+	    misses[nmisses++] = o;
+    }
+#else
+    struct verbdef_definer_data data = find_callable_verbdef(o, verb);
+    if (data.o != NULL && data.v != NULL) {
+	h.definer = data.o;
+	h.verbdef = data.v;
+	vh.ptr = &h;
     }
-
-    free_var(stack);
 #endif
 
     /*
      * note that the verbcache has cleared h.verbdef, so it defaults to a
      * "miss" cache if the for loop doesn't win
      */
-    vh.ptr = 0;
-
     return vh;
 }
 
@@ -760,9 +789,8 @@ db_set_verb_names(db_verb_handle vh, const char *names)
 {
     handle *h = (handle *) vh.ptr;
 
-    db_priv_affected_callable_verb_lookup();
-
     if (h) {
+	db_priv_affected_callable_verb_lookup(h->definer, VC_VERB_CHANGE);
 	if (h->verbdef->name)
 	    free_str(h->verbdef->name);
 	h->verbdef->name = names;
@@ -810,22 +838,95 @@ db_set_verb_flags(db_verb_handle vh, unsigned flags)
 {
     handle *h = (handle *) vh.ptr;
 
-    db_priv_affected_callable_verb_lookup();
-
     if (h) {
+	db_priv_affected_callable_verb_lookup(h->definer, VC_VERB_CHANGE);
 	h->verbdef->perms &= ~PERMMASK;
 	h->verbdef->perms |= flags;
     } else
 	panic("DB_SET_VERB_FLAGS: Null handle!");
 }
 
+/* Verbs loaded from the database can be left uncompiled until they're
+ * first needed (see LAZY_VERB_COMPILATION in options.h).  A verb whose
+ * source doesn't compile gets the null program but keeps its source,
+ * so that the next dump doesn't lose it.
+ */
+static int verbs_pending = 0;	/* verbs with uncompiled source */
+static int verbs_compiled = 0;	/* pending verbs compiled since load */
+static int verbs_failed = 0;	/* pending verbs that didn't compile */
+
+void
+dbpriv_set_verb_source(db_verb_handle vh, const char *source)
+{
+    handle *h = (handle *) vh.ptr;
+
+    if (h) {
+	dbpriv_free_verb_program(h->verbdef);
+	h->verbdef->source = source;
+	verbs_pending++;
+    } else
+	panic("DBPRIV_SET_VERB_SOURCE: Null handle!");
+}
+
+Program *
+dbpriv_verb_program(Verbdef * v, Objid definer)
+{
+    if (v->source && !v->program) {
+	Stream *s = new_stream(100);
+	Program *p;
+
+	stream_printf(s, "#%" PRIdN ":%s", definer, v->name);
+	p = dbpriv_compile_program(dbio_input_version, v->source,
+				   stream_contents(s));
+	free_stream(s);
+	if (p) {
+	    v->program = p;
+	    free_str(v->source);
+	    v->source = 0;
+	    verbs_pending--;
+	    verbs_compiled++;
+	} else {
+	    v->program = program_ref(null_program());
+	    verbs_failed++;
+	}
+    }
+    return v->program;
+}
+
+void
+dbpriv_free_verb_program(Verbdef * v)
+{
+    if (v->program)
+	free_program(v->program);
+    v->program = 0;
+    if (v->source) {
+	free_str(v->source);
+	v->source = 0;
+	verbs_pending--;
+    }
+}
+
+Var
+db_verb_compilation_stats(void)
+{
+    Var r = new_list(3);
+
+    r.v.list[1].type = TYPE_INT;
+    r.v.list[1].v.num = verbs_compiled;
+    r.v.list[2].type = TYPE_INT;
+    r.v.list[2].v.num = verbs_pending;
+    r.v.list[3].type = TYPE_INT;
+    r.v.list[3].v.num = verbs_failed;
+    return r;
+}
+
 Program *
 db_verb_program(db_verb_handle vh)
 {
     handle *h = (handle *) vh.ptr;
 
     if (h) {
-	Program *p = h->verbdef->program;
+	Program *p = dbpriv_verb_program(h->verbdef, h->definer->id);
 
 	return p ? p : null_program();
     }
@@ -839,8 +940,7 @@ db_set_verb_program(db_verb_handle vh, Program * program)
     handle *h = (handle *) vh.ptr;
 
     if (h) {
-	if (h->verbdef->program)
-	    free_program(h->verbdef->program);
+	dbpriv_free_verb_program(h->verbdef);
 	h->verbdef->program = program;
     } else
 	panic("DB_SET_VERB_PROGRAM: Null handle!");
@@ -866,9 +966,8 @@ db_set_verb_arg_specs(db_verb_handle vh,
 {
     handle *h = (handle *) vh.ptr;
 
-    db_priv_affected_callable_verb_lookup();
-
     if (h) {
+	db_priv_affected_callable_verb_lookup(h->definer, VC_VERB_CHANGE);
 	h->verbdef->perms = ((h->verbdef->perms & PERMMASK)
 			     | (dobj << DOBJSHIFT)
 			     | (iobj << IOBJSHIFT));
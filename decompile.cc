@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include "ast.h"
+#include "code_gen.h"
 #include "decompile.h"
 #include "opcode.h"
 #include "program.h"
@@ -103,6 +104,24 @@ read_jump(unsigned numbytes_label, Byte ** p, int *is_hot)
     return label;
 }
 
+/* Code compiled with CG_OPTIMIZE may end the arms of an IF or TRY-EXCEPT
+ * statement with jumps that skip the jump following the statement and go
+ * straight to where it does.  Given the LABEL of such a jump, whose arm
+ * ends before PTR, returns the end of the statement the arm belongs to,
+ * which is the END of the code being decompiled.  Other labels are
+ * returned unchanged.
+ */
+static unsigned
+unthread_label(Bytecodes bc, Byte * ptr, Byte * end, unsigned label)
+{
+    if (bc.vector + label >= ptr && bc.vector + label <= end)
+	return label;
+    if (end >= bc.vector + bc.size || *end != OP_JUMP)
+	return label;
+    ptr = end + 1;
+    return READ_LABEL() == label ? end - bc.vector : label;
+}
+
 #define HOT(is_hot, n)		(node = n, is_hot ? (hot_node = node) : node)
 #define HOT1(is_hot, kid, n)	HOT(is_hot || hot_node == kid, n)
 #define HOT2(is_hot, kid1, kid2, n) \
@@ -190,6 +209,7 @@ decompile(Bytecodes bc, Byte * start, Byte * end, Stmt ** stmt_sink,
 		arm = s->s.cond.arms = alloc_cond_arm(condition, arm_stmts);
 		HOT_OP1(condition, arm);
 		done = READ_JUMP(jump_hot);
+		done = unthread_label(bc, ptr, end, done);
 		HOT_BOTTOM(jump_hot, arm);
 		DECOMPILE(bc, ptr, bc.vector + done, &(s->s.cond.otherwise),
 			  &(arm->next));
@@ -210,6 +230,7 @@ decompile(Bytecodes bc, Byte * start, Byte * end, Stmt ** stmt_sink,
 		ADD_ARM(arm = alloc_cond_arm(condition, arm_stmts));
 		HOT_OP1(condition, arm);
 		done = READ_JUMP(jump_hot);
+		done = unthread_label(bc, ptr, end, done);
 		HOT_BOTTOM(jump_hot, arm);
 		if (bc.vector + done != end)
 		    panic("ELSEIF jumps to wrong place in DECOMPILE!");
@@ -746,9 +767,13 @@ decompile(Bytecodes bc, Byte * start, Byte * end, Stmt ** stmt_sink,
 			    else
 				stop = bc.vector + done;
 			    DECOMPILE(bc, ptr, stop, &(ex->stmt), 0);
-			    if (ex->next && READ_JUMP(jump_hot) != done)
-				panic("EXCEPT jumps to wrong place in "
-				      "DECOMPILE!");
+			    if (ex->next) {
+				unsigned label = READ_JUMP(jump_hot);
+
+				if (unthread_label(bc, ptr, end, label) != done)
+				    panic("EXCEPT jumps to wrong place in "
+					  "DECOMPILE!");
+			    }
 			    HOT_BOTTOM(jump_hot, ex);
 			}
 			if (ptr - bc.vector != done)
@@ -880,6 +905,39 @@ decompile(Bytecodes bc, Byte * start, Byte * end, Stmt ** stmt_sink,
 		    push_expr((Expr *)HOT_OP1(e->e.expr, e));
 		    break;
 
+		case EOP_BF_LENGTH:
+		case EOP_BF_TYPEOF:
+		case EOP_BF_VALID:
+		case EOP_BF_IS_MEMBER:
+		case EOP_BF_LISTAPPEND:
+		case EOP_BF_TOSTR:
+		case EOP_BI_FUNC_CALL:
+		    {
+			Arg_List *args = 0;
+			int nargs;
+
+			e = alloc_expr(EXPR_CALL);
+			if (eop == EOP_BI_FUNC_CALL) {
+			    e->e.call.func = READ_BYTES(1);
+			    nargs = -1;
+			} else {
+			    e->e.call.func = intrinsic_func(eop);
+			    nargs = intrinsic_nargs(eop);
+			}
+			if (nargs == -1)
+			    nargs = READ_BYTES(1);
+			for (; nargs > 0; nargs--) {
+			    Arg_List *a = alloc_arg_list(ARG_NORMAL,
+							 pop_expr());
+
+			    a->next = args;
+			    args = a;
+			}
+			e->e.call.args = args;
+			push_expr((Expr *)HOT_OP(e));
+		    }
+		    break;
+
 		default:
 		    panic("Unknown extended opcode in DECOMPILE!");
 		}
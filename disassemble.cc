@@ -119,7 +119,14 @@ struct mapping ext_mappings[] =
     {EOP_BITXOR, "BITXOR"},
     {EOP_BITSHL, "BITSHL"},
     {EOP_BITSHR, "BITSHR"},
-    {EOP_COMPLEMENT, "COMPLEMENT"}
+    {EOP_COMPLEMENT, "COMPLEMENT"},
+    {EOP_BI_FUNC_CALL, "CALL_FUNC_STACK"},
+    {EOP_BF_LENGTH, "LENGTH"},
+    {EOP_BF_TYPEOF, "TYPEOF"},
+    {EOP_BF_VALID, "VALID"},
+    {EOP_BF_IS_MEMBER, "IS_MEMBER"},
+    {EOP_BF_LISTAPPEND, "LISTAPPEND"},
+    {EOP_BF_TOSTR, "TOSTR"}
 };
 
 static void
@@ -326,6 +333,14 @@ disassemble(Program * prog, Printer p, void *data)
 		    a3 = ADD_BYTES(bc.numbytes_label);
 		    stream_printf(insn, " %s %s %d", NAMES(a1), NAMES(a2), a3);
 		    break;
+		case EOP_BI_FUNC_CALL:
+		    a1 = ADD_BYTES(1);
+		    a2 = ADD_BYTES(1);
+		    stream_printf(insn, " %s %d", name_func_by_num(a1), a2);
+		    break;
+		case EOP_BF_TOSTR:
+		    stream_printf(insn, " %d", ADD_BYTES(1));
+		    break;
 		default:
 		    break;
 		}
@@ -370,10 +385,10 @@ disassemble(Program * prog, Printer p, void *data)
 			v = literals[ADD_BYTES(bc.numbytes_literal)];
 			switch (v.type) {
 			case TYPE_OBJ:
-			    stream_printf(insn, " #%d", v.v.obj);
+			    stream_printf(insn, " #%" PRIdN, v.v.obj);
 			    break;
 			case TYPE_INT:
-			    stream_printf(insn, " %d", v.v.num);
+			    stream_printf(insn, " %" PRIdN, v.v.num);
 			    break;
 			case TYPE_STR:
 			    stream_add_string(insn, " \"");
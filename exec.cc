@@ -114,10 +114,10 @@ free_task_waiting_on_exec(task_waiting_on_exec * tw)
     }
     if (tw->in)
 	free_str(tw->in);
-    close(tw->fout);
-    close(tw->ferr);
     network_unregister_fd(tw->fout);
     network_unregister_fd(tw->ferr);
+    close(tw->fout);
+    close(tw->ferr);
     if (tw->sout)
 	free_stream(tw->sout);
     if (tw->serr)
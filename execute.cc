@@ -17,6 +17,7 @@
 
 #include "my-string.h"
 
+#include "code_gen.h"
 #include "collection.h"
 #include "config.h"
 #include "db.h"
@@ -57,8 +58,9 @@ static int root_activ_vector;	/* root_activ_vector == MAIN_VECTOR
    after a suspend */
 static int ticks_remaining;
 int task_timed_out;
+static int64_t task_deadline;	/* when the task runs out of seconds, by
+				   monotonic_msecs() */
 static int interpreter_is_running = 0;
-static Timer_ID task_alarm_id;
 
 static const char *handler_verb_name;	/* For in-DB traceback handling */
 static Var handler_verb_args;
@@ -131,7 +133,7 @@ print_error_backtrace(const char *msg, void (*output) (const char *))
 	    stream_printf(str, "... called from ");
 
 	if (TYPE_OBJ == activ_stack[t].vloc.type)
-	    stream_printf(str, "#%d:%s", activ_stack[t].vloc.v.obj,
+	    stream_printf(str, "#%" PRIdN ":%s", activ_stack[t].vloc.v.obj,
 		          activ_stack[t].verbname);
 	else
 	    stream_printf(str, "*anonymous*:%s",
@@ -725,6 +727,42 @@ call_verb2(Objid recv, const char *vname, Var _this, Var args, int do_pass)
 #else
 #define bi_prop_protected(prop, progr) ((!is_wizard(progr)) && server_flag_option_cached(prop))
 #endif				/* IGNORE_PROP_PROTECTED */
+
+/* Returns the inline property cache for the property-referencing
+ * opcode at `site' in `prog', allocating the program's cache table the
+ * first time through.  The table has at least twice as many slots as
+ * the program has such opcodes, so the linear probe always finds
+ * either the site's own slot or an unused one.
+ */
+static db_prop_cache *
+find_prop_cache(Program *prog, const Byte *site)
+{
+    db_prop_cache *cache;
+    unsigned i;
+
+    if (!prog->prop_caches) {
+	unsigned size = 2;
+
+	while (size < 2 * prog->num_prop_sites)
+	    size *= 2;
+	prog->prop_cache_mask = size - 1;
+	prog->prop_caches = (db_prop_cache *)mymalloc(size * sizeof(db_prop_cache),
+						      M_PROP_CACHE);
+	for (i = 0; i < size; i++)
+	    db_init_prop_cache(&prog->prop_caches[i], 0);
+    }
+
+    for (i = (uintptr_t) site & prog->prop_cache_mask;;
+	 i = (i + 1) & prog->prop_cache_mask) {
+	cache = &prog->prop_caches[i];
+	if (cache->site == site)
+	    return cache;
+	if (!cache->site) {
+	    cache->site = site;
+	    return cache;
+	}
+    }
+}
 
 /** 
   the main interpreter -- run()
@@ -744,6 +782,7 @@ run(char raise, enum error resumption_error, Var * result)
     Byte *bv, *error_bv;
     Var *rts;			/* next empty slot */
     enum Opcode op;
+    enum Extended_Opcode eop = EOP_RANGESET;	/* set by OP_EXTENDED */
     Var error_var;
     enum outcome outcome;
 
@@ -822,10 +861,228 @@ do {								\
 	PUSH_ERROR(the_err);					\
 } while (0)
 
+/* Deal with the package returned by built-in function FUNC_ID (either
+ * OP_BI_FUNC_CALL or EOP_BI_FUNC_CALL).
+ */
+#define FINISH_BI_FUNC_CALL(p, func_id)				\
+do {								\
+    switch ((p).kind) {						\
+    case package::BI_RETURN:					\
+	PUSH((p).u.ret);					\
+	break;							\
+    case package::BI_RAISE:					\
+	if (RUN_ACTIV.debug) {					\
+	    if (raise_error(p, 0))				\
+		return OUTCOME_ABORTED;				\
+	    else						\
+		LOAD_STATE_VARIABLES();				\
+	} else {						\
+	    PUSH((p).u.raise.code);				\
+	    free_str((p).u.raise.msg);				\
+	    free_var((p).u.raise.value);			\
+	}							\
+	break;							\
+    case package::BI_CALL:					\
+	/* another activ has been pushed onto activ_stack */	\
+	RUN_ACTIV.bi_func_id = (func_id);			\
+	RUN_ACTIV.bi_func_data = (p).u.call.data;		\
+	RUN_ACTIV.bi_func_pc = (p).u.call.pc;			\
+	break;							\
+    case package::BI_SUSPEND:					\
+	{							\
+	    enum error e = suspend_task(p);			\
+								\
+	    if (e == E_NONE)					\
+		return OUTCOME_BLOCKED;				\
+	    else						\
+		PUSH_ERROR(e);					\
+	}							\
+	break;							\
+    case package::BI_KILL:					\
+	STORE_STATE_VARIABLES();				\
+	abort_task((abort_reason)(p).u.ret.v.num);		\
+	return OUTCOME_ABORTED;					\
+	/* NOTREACHED */					\
+    }								\
+} while (0)
+
+/* Intrinsic opcodes for protected functions make the call the long way
+ * round, so that #0:bf_FUNCNAME() gets a chance at it.
+ */
+#define INTRINSIC_FALLBACK(eop, nargs)					\
+do {									\
+    unsigned func_id = intrinsic_func(eop);				\
+									\
+    if (bi_func_protected(func_id)) {					\
+	package p;							\
+									\
+	rts -= (nargs);							\
+	STORE_STATE_VARIABLES();					\
+	p = call_bi_func_on_stack(func_id, rts, (nargs),		\
+				  RUN_ACTIV.progr);			\
+	LOAD_STATE_VARIABLES();						\
+	FINISH_BI_FUNC_CALL(p, func_id);				\
+	goto next_opcode;						\
+    }									\
+} while (0)
+
+#define TRY_STREAM enable_stream_exceptions()
+#define ENDTRY_STREAM disable_stream_exceptions()
+
 #define JUMP(label)     (bv = bc.vector + label)
 
+/* Reading the clock on every tick would be wasteful, so the seconds
+ * limit is only checked every TIMEOUT_CHECK_TICKS (a power of two)
+ * ticks.
+ */
+#define TIMEOUT_CHECK_TICKS	64
+
+#define FETCH_OPCODE()					\
+do {							\
+    error_bv = bv;					\
+    op = (Opcode)(*bv++);				\
+    if (COUNT_TICK(op)) {				\
+	if (--ticks_remaining <= 0) {			\
+	    STORE_STATE_VARIABLES();			\
+	    abort_task(ABORT_TICKS);			\
+	    return OUTCOME_ABORTED;			\
+	}						\
+	if (task_timed_out				\
+	    || ((ticks_remaining & (TIMEOUT_CHECK_TICKS - 1)) == 0 \
+		&& task_time_is_up())) {		\
+	    STORE_STATE_VARIABLES();			\
+	    abort_task(ABORT_SECONDS);			\
+	    return OUTCOME_ABORTED;			\
+	}						\
+    }							\
+} while (0)
+
+/* With DIRECT_THREADED_DISPATCH every opcode handler ends by fetching
+ * and dispatching the next opcode itself, so that each handler gets
+ * its own indirect jump (and its own slot in the branch predictor).
+ * Otherwise NEXT_OPCODE() is simply a `break' out of the `switch'
+ * (or out of the inner `switch' on the extended opcode, which is
+ * immediately followed by a `break' out of the outer `switch').
+ */
+#ifdef DIRECT_THREADED_DISPATCH
+#define OP_TARGET(name)		op_target_##name:
+#define EOP_TARGET(name)	eop_target_##name:
+#define NEXT_OPCODE()				\
+do {						\
+    FETCH_OPCODE();				\
+    goto *op_targets[op];			\
+} while (0)
+#else
+#define OP_TARGET(name)
+#define EOP_TARGET(name)
+#define NEXT_OPCODE()		break
+#endif				/* DIRECT_THREADED_DISPATCH */
+
 /* end of major run() macros */
 
+#ifdef DIRECT_THREADED_DISPATCH
+    static void *op_targets[256], *eop_targets[256];
+
+    if (!op_targets[0]) {
+	int i;
+
+	for (i = 0; i < 256; i++) {
+	    op_targets[i] = &&op_target_default;
+	    eop_targets[i] = &&eop_target_default;
+	}
+
+	op_targets[OP_IF_QUES] = &&op_target_IF;
+	op_targets[OP_IF] = &&op_target_IF;
+	op_targets[OP_WHILE] = &&op_target_IF;
+	op_targets[OP_EIF] = &&op_target_IF;
+	op_targets[OP_JUMP] = &&op_target_JUMP;
+	op_targets[OP_FOR_RANGE] = &&op_target_FOR_RANGE;
+	op_targets[OP_POP] = &&op_target_POP;
+	op_targets[OP_IMM] = &&op_target_IMM;
+	op_targets[OP_MAP_CREATE] = &&op_target_MAP_CREATE;
+	op_targets[OP_MAP_INSERT] = &&op_target_MAP_INSERT;
+	op_targets[OP_MAKE_EMPTY_LIST] = &&op_target_MAKE_EMPTY_LIST;
+	op_targets[OP_LIST_ADD_TAIL] = &&op_target_LIST_ADD_TAIL;
+	op_targets[OP_LIST_APPEND] = &&op_target_LIST_APPEND;
+	op_targets[OP_INDEXSET] = &&op_target_INDEXSET;
+	op_targets[OP_MAKE_SINGLETON_LIST] = &&op_target_MAKE_SINGLETON_LIST;
+	op_targets[OP_CHECK_LIST_FOR_SPLICE] = &&op_target_CHECK_LIST_FOR_SPLICE;
+	op_targets[OP_PUT_TEMP] = &&op_target_PUT_TEMP;
+	op_targets[OP_PUSH_TEMP] = &&op_target_PUSH_TEMP;
+	op_targets[OP_EQ] = &&op_target_EQ;
+	op_targets[OP_NE] = &&op_target_EQ;
+	op_targets[OP_GT] = &&op_target_GT;
+	op_targets[OP_LT] = &&op_target_GT;
+	op_targets[OP_GE] = &&op_target_GT;
+	op_targets[OP_LE] = &&op_target_GT;
+	op_targets[OP_IN] = &&op_target_IN;
+	op_targets[OP_MULT] = &&op_target_MULT;
+	op_targets[OP_MINUS] = &&op_target_MULT;
+	op_targets[OP_DIV] = &&op_target_MULT;
+	op_targets[OP_MOD] = &&op_target_MULT;
+	op_targets[OP_ADD] = &&op_target_ADD;
+	op_targets[OP_AND] = &&op_target_AND;
+	op_targets[OP_OR] = &&op_target_AND;
+	op_targets[OP_NOT] = &&op_target_NOT;
+	op_targets[OP_UNARY_MINUS] = &&op_target_UNARY_MINUS;
+	op_targets[OP_REF] = &&op_target_REF;
+	op_targets[OP_PUSH_REF] = &&op_target_PUSH_REF;
+	op_targets[OP_RANGE_REF] = &&op_target_RANGE_REF;
+	op_targets[OP_G_PUT] = &&op_target_G_PUT;
+	op_targets[OP_G_PUSH] = &&op_target_G_PUSH;
+	op_targets[OP_GET_PROP] = &&op_target_GET_PROP;
+	op_targets[OP_PUSH_GET_PROP] = &&op_target_PUSH_GET_PROP;
+	op_targets[OP_PUT_PROP] = &&op_target_PUT_PROP;
+	op_targets[OP_FORK] = &&op_target_FORK;
+	op_targets[OP_FORK_WITH_ID] = &&op_target_FORK;
+	op_targets[OP_CALL_VERB] = &&op_target_CALL_VERB;
+	op_targets[OP_RETURN] = &&op_target_RETURN;
+	op_targets[OP_RETURN0] = &&op_target_RETURN;
+	op_targets[OP_DONE] = &&op_target_RETURN;
+	op_targets[OP_BI_FUNC_CALL] = &&op_target_BI_FUNC_CALL;
+	op_targets[OP_EXTENDED] = &&op_target_EXTENDED;
+	for (i = 0; i < NUM_READY_VARS; i++) {
+	    op_targets[OP_PUSH + i] = &&op_target_PUSH;
+#ifdef BYTECODE_REDUCE_REF
+	    op_targets[OP_PUSH_CLEAR + i] = &&op_target_PUSH_CLEAR;
+#endif				/* BYTECODE_REDUCE_REF */
+	    op_targets[OP_PUT + i] = &&op_target_PUT;
+	}
+
+	eop_targets[EOP_RANGESET] = &&eop_target_RANGESET;
+	eop_targets[EOP_FIRST] = &&eop_target_FIRST;
+	eop_targets[EOP_LAST] = &&eop_target_LAST;
+	eop_targets[EOP_EXP] = &&eop_target_EXP;
+	eop_targets[EOP_SCATTER] = &&eop_target_SCATTER;
+	eop_targets[EOP_PUSH_LABEL] = &&eop_target_PUSH_LABEL;
+	eop_targets[EOP_TRY_FINALLY] = &&eop_target_PUSH_LABEL;
+	eop_targets[EOP_CATCH] = &&eop_target_CATCH;
+	eop_targets[EOP_TRY_EXCEPT] = &&eop_target_CATCH;
+	eop_targets[EOP_END_CATCH] = &&eop_target_END_CATCH;
+	eop_targets[EOP_END_EXCEPT] = &&eop_target_END_CATCH;
+	eop_targets[EOP_END_FINALLY] = &&eop_target_END_FINALLY;
+	eop_targets[EOP_CONTINUE] = &&eop_target_CONTINUE;
+	eop_targets[EOP_WHILE_ID] = &&eop_target_WHILE_ID;
+	eop_targets[EOP_EXIT_ID] = &&eop_target_EXIT_ID;
+	eop_targets[EOP_EXIT] = &&eop_target_EXIT;
+	eop_targets[EOP_FOR_LIST_1] = &&eop_target_FOR_LIST_1;
+	eop_targets[EOP_FOR_LIST_2] = &&eop_target_FOR_LIST_2;
+	eop_targets[EOP_BITOR] = &&eop_target_BITOR;
+	eop_targets[EOP_BITAND] = &&eop_target_BITOR;
+	eop_targets[EOP_BITXOR] = &&eop_target_BITOR;
+	eop_targets[EOP_BITSHL] = &&eop_target_BITSHL;
+	eop_targets[EOP_BITSHR] = &&eop_target_BITSHL;
+	eop_targets[EOP_COMPLEMENT] = &&eop_target_COMPLEMENT;
+	eop_targets[EOP_BI_FUNC_CALL] = &&eop_target_BI_FUNC_CALL;
+	eop_targets[EOP_BF_LENGTH] = &&eop_target_BF_LENGTH;
+	eop_targets[EOP_BF_TYPEOF] = &&eop_target_BF_TYPEOF;
+	eop_targets[EOP_BF_VALID] = &&eop_target_BF_VALID;
+	eop_targets[EOP_BF_IS_MEMBER] = &&eop_target_BF_IS_MEMBER;
+	eop_targets[EOP_BF_LISTAPPEND] = &&eop_target_BF_LISTAPPEND;
+	eop_targets[EOP_BF_TOSTR] = &&eop_target_BF_TOSTR;
+    }
+#endif				/* DIRECT_THREADED_DISPATCH */
+
     LOAD_STATE_VARIABLES();
 
     if (raise) {
@@ -834,27 +1091,17 @@ do {								\
     }
     for (;;) {
       next_opcode:
-	error_bv = bv;
-	op = (Opcode)(*bv++);
-
-	if (COUNT_TICK(op)) {
-	    if (--ticks_remaining <= 0) {
-		STORE_STATE_VARIABLES();
-		abort_task(ABORT_TICKS);
-		return OUTCOME_ABORTED;
-	    }
-	    if (task_timed_out) {
-		STORE_STATE_VARIABLES();
-		abort_task(ABORT_SECONDS);
-		return OUTCOME_ABORTED;
-	    }
-	}
+	FETCH_OPCODE();
+#ifdef DIRECT_THREADED_DISPATCH
+	goto *op_targets[op];
+#endif
 	switch (op) {
 
 	case OP_IF_QUES:
 	case OP_IF:
 	case OP_WHILE:
 	case OP_EIF:
+	  OP_TARGET(IF)
 	  do_test:
 	    {
 		Var cond;
@@ -869,16 +1116,18 @@ do {								\
 		}
 		free_var(cond);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_JUMP:
+	  OP_TARGET(JUMP)
 	    {
 		unsigned lab = READ_BYTES(bv, bc.numbytes_label);
 		JUMP(lab);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_FOR_RANGE:
+	  OP_TARGET(FOR_RANGE)
 	    {
 		unsigned id = READ_BYTES(bv, bc.numbytes_var_name);
 		unsigned lab = READ_BYTES(bv, bc.numbytes_label);
@@ -920,13 +1169,15 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_POP:
+	  OP_TARGET(POP)
 	    free_var(POP());
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_IMM:
+	  OP_TARGET(IMM)
 	    {
 		int slot;
 
@@ -936,23 +1187,25 @@ do {								\
 		 */
 		if (bv[bc.numbytes_literal] == OP_POP) {
 		    bv += bc.numbytes_literal + 1;
-		    break;
+		    NEXT_OPCODE();
 		}
 		slot = READ_BYTES(bv, bc.numbytes_literal);
 		PUSH_REF(RUN_ACTIV.prog->literals[slot]);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_MAP_CREATE:
+	  OP_TARGET(MAP_CREATE)
 	    {
 		Var map;
 
 		map = new_map();
 		PUSH(map);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_MAP_INSERT:
+	  OP_TARGET(MAP_INSERT)
 	    {
 		Var r, map, key, value;
 		enum error e = E_NONE;
@@ -974,18 +1227,20 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_MAKE_EMPTY_LIST:
+	  OP_TARGET(MAKE_EMPTY_LIST)
 	    {
 		Var list;
 
 		list = new_list(0);
 		PUSH(list);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_LIST_ADD_TAIL:
+	  OP_TARGET(LIST_ADD_TAIL)
 	    {
 		Var r, tail, list;
 
@@ -1005,9 +1260,10 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_LIST_APPEND:
+	  OP_TARGET(LIST_APPEND)
 	    {
 		Var r, tail, list;
 
@@ -1027,13 +1283,14 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	/* This opcode will not increase the length of a string
 	 * but it may increase the size of a list or map, thus the
 	 * check.
 	 */
 	case OP_INDEXSET:
+	  OP_TARGET(INDEXSET)
 	    {
 		Var value, index, list;
 
@@ -1091,9 +1348,10 @@ do {								\
 		    PUSH(list);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_MAKE_SINGLETON_LIST:
+	  OP_TARGET(MAKE_SINGLETON_LIST)
 	    {
 		Var list;
 
@@ -1101,27 +1359,31 @@ do {								\
 		list.v.list[1] = POP();
 		PUSH(list);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_CHECK_LIST_FOR_SPLICE:
+	  OP_TARGET(CHECK_LIST_FOR_SPLICE)
 	    if (TOP_RT_VALUE.type != TYPE_LIST) {
 		free_var(POP());
 		PUSH_ERROR(E_TYPE);
 	    }
 	    /* no op if top-rt-stack is a list */
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_PUT_TEMP:
+	  OP_TARGET(PUT_TEMP)
 	    RUN_ACTIV.temp = var_ref(TOP_RT_VALUE);
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_PUSH_TEMP:
+	  OP_TARGET(PUSH_TEMP)
 	    PUSH(RUN_ACTIV.temp);
 	    RUN_ACTIV.temp.type = TYPE_NONE;
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_EQ:
 	case OP_NE:
+	  OP_TARGET(EQ)
 	    {
 		Var rhs, lhs, ans;
 
@@ -1135,12 +1397,13 @@ do {								\
 		free_var(rhs);
 		free_var(lhs);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_GT:
 	case OP_LT:
 	case OP_GE:
 	case OP_LE:
+	  OP_TARGET(GT)
 	    {
 		Var rhs, lhs, ans;
 		int comparison;
@@ -1206,9 +1469,10 @@ do {								\
 		    free_var(lhs);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_IN:
+	  OP_TARGET(IN)
 	    {
 		Var lhs, rhs, ans;
 
@@ -1226,12 +1490,13 @@ do {								\
 		    free_var(lhs);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_MULT:
 	case OP_MINUS:
 	case OP_DIV:
 	case OP_MOD:
+	  OP_TARGET(MULT)
 	    {
 		Var lhs, rhs, ans;
 
@@ -1267,9 +1532,10 @@ do {								\
 		else
 		    PUSH(ans);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_ADD:
+	  OP_TARGET(ADD)
 	    {
 		Var rhs, lhs, ans;
 
@@ -1281,12 +1547,19 @@ do {								\
 		else if (lhs.type == TYPE_STR && rhs.type == TYPE_STR) {
 		    char *str;
 		    int llen = memo_strlen(lhs.v.str);
-		    int flen = llen + memo_strlen(rhs.v.str);
+		    int rlen = memo_strlen(rhs.v.str);
+		    int flen = llen + rlen;
 
 		    if (server_int_option_cached(SVO_MAX_STRING_CONCAT)
 			< flen) {
 			ans.type = TYPE_ERR;
 			ans.v.err = E_QUOTA;
+		    } else if (var_refcount(lhs) == 1) {
+			/* `s = s + piece' -- nothing else can see `s' */
+			ans.type = TYPE_STR;
+			ans.v.str = str_append((char *)lhs.v.str, llen,
+					       rhs.v.str, rlen);
+			lhs.type = TYPE_NONE;
 		    } else {
 			str = (char *)mymalloc(flen + 1, M_STRING);
 			strcpy(str, lhs.v.str);
@@ -1306,10 +1579,11 @@ do {								\
 		else
 		    PUSH(ans);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_AND:
 	case OP_OR:
+	  OP_TARGET(AND)
 	    {
 		Var lhs;
 		unsigned lab = READ_BYTES(bv, bc.numbytes_label);
@@ -1322,9 +1596,10 @@ do {								\
 		    free_var(POP());
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_NOT:
+	  OP_TARGET(NOT)
 	    {
 		Var arg, ans;
 
@@ -1334,9 +1609,10 @@ do {								\
 		PUSH(ans);
 		free_var(arg);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_UNARY_MINUS:
+	  OP_TARGET(UNARY_MINUS)
 	    {
 		Var arg, ans;
 
@@ -1345,19 +1621,20 @@ do {								\
 		    ans.type = TYPE_INT;
 		    ans.v.num = -arg.v.num;
 		} else if (arg.type == TYPE_FLOAT)
-		    ans = new_float(-*arg.v.fnum);
+		    ans = new_float(-arg.v.fnum);
 		else {
 		    free_var(arg);
 		    PUSH_ERROR(E_TYPE);
-		    break;
+		    NEXT_OPCODE();
 		}
 
 		PUSH(ans);
 		free_var(arg);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_REF:
+	  OP_TARGET(REF)
 	    {
 		Var index, list;
 
@@ -1406,9 +1683,10 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_PUSH_REF:
+	  OP_TARGET(PUSH_REF)
 	    {
 		/* This is about the sketchiest manoeuvre I can
 		 * imagine.  The goal is to mutate a nested list/map
@@ -1460,9 +1738,10 @@ do {								\
 		    PUSH_ERROR(E_TYPE);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_RANGE_REF:
+	  OP_TARGET(RANGE_REF)
 	    {
 		Var base, from, to;
 
@@ -1534,17 +1813,19 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_G_PUT:
+	  OP_TARGET(G_PUT)
 	    {
 		unsigned id = READ_BYTES(bv, bc.numbytes_var_name);
 		free_var(RUN_ACTIV.rt_env[id]);
 		RUN_ACTIV.rt_env[id] = var_ref(TOP_RT_VALUE);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_G_PUSH:
+	  OP_TARGET(G_PUSH)
 	    {
 		Var value;
 
@@ -1554,9 +1835,10 @@ do {								\
 		else
 		    PUSH_REF(value);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_GET_PROP:
+	  OP_TARGET(GET_PROP)
 	    {
 		Var propname, obj, prop;
 
@@ -1574,7 +1856,8 @@ do {								\
 		    db_prop_handle h;
 		    int built_in;
 
-		    h = db_find_property(obj, propname.v.str, &prop);
+		    h = db_find_property_cached(obj, propname.v.str, &prop,
+						find_prop_cache(RUN_ACTIV.prog, error_bv));
 		    built_in = db_is_property_built_in(h);
 
 		    free_var(propname);
@@ -1592,9 +1875,10 @@ do {								\
 			PUSH_REF(prop);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_PUSH_GET_PROP:
+	  OP_TARGET(PUSH_GET_PROP)
 	    {
 		Var propname, obj, prop;
 
@@ -1608,7 +1892,8 @@ do {								\
 		    db_prop_handle h;
 		    int built_in;
 
-		    h = db_find_property(obj, propname.v.str, &prop);
+		    h = db_find_property_cached(obj, propname.v.str, &prop,
+						find_prop_cache(RUN_ACTIV.prog, error_bv));
 		    built_in = db_is_property_built_in(h);
 		    if (!h.ptr)
 			PUSH_ERROR(E_PROPNF);
@@ -1622,9 +1907,10 @@ do {								\
 			PUSH_REF(prop);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_PUT_PROP:
+	  OP_TARGET(PUT_PROP)
 	    {
 		Var obj, propname, rhs;
 
@@ -1647,7 +1933,8 @@ do {								\
 		    enum error err = E_NONE;
 		    Objid progr = RUN_ACTIV.progr;
 
-		    h = db_find_property(obj, propname.v.str, 0);
+		    h = db_find_property_cached(obj, propname.v.str, 0,
+						find_prop_cache(RUN_ACTIV.prog, error_bv));
 		    built_in = db_is_property_built_in(h);
 		    if (!h.ptr)
 			err = E_PROPNF;
@@ -1685,7 +1972,7 @@ do {								\
 				 */
 				/* First make sure traceback will be accurate. */
 				STORE_STATE_VARIABLES();
-				applog(LOG_WARNING, "%sWIZARDED: #%d by programmer #%d\n",
+				applog(LOG_WARNING, "%sWIZARDED: #%" PRIdN " by programmer #%" PRIdN "\n",
 				      is_wizard(obj.v.obj) ? "DE" : "",
 				      obj.v.obj, progr);
 				print_error_backtrace(is_wizard(obj.v.obj)
@@ -1724,10 +2011,11 @@ do {								\
 		    }
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_FORK:
 	case OP_FORK_WITH_ID:
+	  OP_TARGET(FORK)
 	    {
 		Var time;
 		unsigned id = 0, f_index;
@@ -1736,24 +2024,29 @@ do {								\
 		f_index = READ_BYTES(bv, bc.numbytes_fork);
 		if (op == OP_FORK_WITH_ID)
 		    id = READ_BYTES(bv, bc.numbytes_var_name);
-		if (time.type != TYPE_INT) {
+		if (time.type != TYPE_INT && time.type != TYPE_FLOAT) {
 		    free_var(time);
 		    RAISE_ERROR(E_TYPE);
-		} else if (time.v.num < 0) {
+		} else if (time.type == TYPE_INT ? time.v.num < 0
+			   : !(time.v.fnum >= 0)) {
 		    free_var(time);
 		    RAISE_ERROR(E_INVARG);
 		} else {
 		    enum error e;
+		    double seconds = (time.type == TYPE_INT ? time.v.num
+				      : time.v.fnum);
 
-		    e = enqueue_forked_task2(RUN_ACTIV, f_index, time.v.num,
+		    free_var(time);
+		    e = enqueue_forked_task2(RUN_ACTIV, f_index, seconds,
 					op == OP_FORK_WITH_ID ? id : -1);
 		    if (e != E_NONE)
 			RAISE_ERROR(e);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_CALL_VERB:
+	  OP_TARGET(CALL_VERB)
 	    {
 		enum error err;
 		Var args, verb, obj;
@@ -1819,11 +2112,12 @@ do {								\
 		    PUSH_ERROR(err);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_RETURN:
 	case OP_RETURN0:
 	case OP_DONE:
+	  OP_TARGET(RETURN)
 	    {
 		Var ret_val;
 
@@ -1842,9 +2136,10 @@ do {								\
 		}
 		LOAD_STATE_VARIABLES();
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_BI_FUNC_CALL:
+	  OP_TARGET(BI_FUNC_CALL)
 	    {
 		unsigned func_id;
 		Var args;
@@ -1861,56 +2156,24 @@ do {								\
 		    p = call_bi_func(func_id, args, 1, RUN_ACTIV.progr, 0);
 		    LOAD_STATE_VARIABLES();
 
-		    switch (p.kind) {
-		    case package::BI_RETURN:
-			PUSH(p.u.ret);
-			break;
-		    case package::BI_RAISE:
-			if (RUN_ACTIV.debug) {
-			    if (raise_error(p, 0))
-				return OUTCOME_ABORTED;
-			    else
-				LOAD_STATE_VARIABLES();
-			} else {
-			    PUSH(p.u.raise.code);
-			    free_str(p.u.raise.msg);
-			    free_var(p.u.raise.value);
-			}
-			break;
-		    case package::BI_CALL:
-			/* another activ has been pushed onto activ_stack */
-			RUN_ACTIV.bi_func_id = func_id;
-			RUN_ACTIV.bi_func_data = p.u.call.data;
-			RUN_ACTIV.bi_func_pc = p.u.call.pc;
-			break;
-		    case package::BI_SUSPEND:
-			{
-			    enum error e = suspend_task(p);
-
-			    if (e == E_NONE)
-				return OUTCOME_BLOCKED;
-			    else
-				PUSH_ERROR(e);
-			}
-			break;
-		    case package::BI_KILL:
-			STORE_STATE_VARIABLES();
-			abort_task((abort_reason)p.u.ret.v.num);
-			return OUTCOME_ABORTED;
-			/* NOTREACHED */
-		    }
+		    FINISH_BI_FUNC_CALL(p, func_id);
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	case OP_EXTENDED:
+	  OP_TARGET(EXTENDED)
 	    {
-		register enum Extended_Opcode eop = (Extended_Opcode)(*bv);
+		eop = (Extended_Opcode)(*bv);
 		bv++;
 		if (COUNT_EOP_TICK(eop))
 		    ticks_remaining--;
+#ifdef DIRECT_THREADED_DISPATCH
+		goto *eop_targets[eop];
+#endif
 		switch (eop) {
 		case EOP_RANGESET:
+		  EOP_TARGET(RANGESET)
 		    {
 			Var base, from, to, value;
 			enum error e;
@@ -2004,9 +2267,10 @@ do {								\
 			    }
 			}
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_FIRST:
+		  EOP_TARGET(FIRST)
 		    {
 			unsigned i = READ_BYTES(bv, bc.numbytes_stack);
 			Var item, v;
@@ -2029,9 +2293,10 @@ do {								\
 			} else
 			    PUSH_ERROR(E_TYPE);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_LAST:
+		  EOP_TARGET(LAST)
 		    {
 			unsigned i = READ_BYTES(bv, bc.numbytes_stack);
 			Var item, v;
@@ -2054,9 +2319,10 @@ do {								\
 			} else
 			    PUSH_ERROR(E_TYPE);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_EXP:
+		  EOP_TARGET(EXP)
 		    {
 			Var lhs, rhs, ans;
 
@@ -2070,9 +2336,10 @@ do {								\
 			else
 			    PUSH(ans);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_SCATTER:
+		  EOP_TARGET(SCATTER)
 		    {
 			int nargs = READ_BYTES(bv, 1);
 			int nreq = READ_BYTES(bv, 1);
@@ -2136,10 +2403,11 @@ do {								\
 			else
 			    JUMP(where);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_PUSH_LABEL:
 		case EOP_TRY_FINALLY:
+		  EOP_TARGET(PUSH_LABEL)
 		    {
 			Var v;
 
@@ -2147,10 +2415,11 @@ do {								\
 			v.v.num = READ_BYTES(bv, bc.numbytes_label);
 			PUSH(v);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_CATCH:
 		case EOP_TRY_EXCEPT:
+		  EOP_TARGET(CATCH)
 		    {
 			Var v;
 
@@ -2158,10 +2427,11 @@ do {								\
 			v.v.num = (eop == EOP_CATCH ? 1 : READ_BYTES(bv, 1));
 			PUSH(v);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_END_CATCH:
 		case EOP_END_EXCEPT:
+		  EOP_TARGET(END_CATCH)
 		    {
 			Var v, marker;
 			int i;
@@ -2184,9 +2454,10 @@ do {								\
 			lab = READ_BYTES(bv, bc.numbytes_label);
 			JUMP(lab);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_END_FINALLY:
+		  EOP_TARGET(END_FINALLY)
 		    {
 			Var v, why;
 
@@ -2198,9 +2469,10 @@ do {								\
 			PUSH(why);
 			PUSH(zero);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_CONTINUE:
+		  EOP_TARGET(CONTINUE)
 		    {
 			Var v, why;
 
@@ -2223,9 +2495,10 @@ do {								\
 			    panic("Unknown FINALLY reason!");
 			}
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_WHILE_ID:
+		  EOP_TARGET(WHILE_ID)
 		    {
 			unsigned id = READ_BYTES(bv, bc.numbytes_var_name);
 			free_var(RUN_ACTIV.rt_env[id]);
@@ -2234,9 +2507,11 @@ do {								\
 		    goto do_test;
 
 		case EOP_EXIT_ID:
+		  EOP_TARGET(EXIT_ID)
 		    SKIP_BYTES(bv, bc.numbytes_var_name);	/* ignore id */
 		    /* fall thru */
 		case EOP_EXIT:
+		  EOP_TARGET(EXIT)
 		    {
 			Var v;
 
@@ -2249,9 +2524,10 @@ do {								\
 			(void) unwind_stack(FIN_EXIT, v, 0);
 			LOAD_STATE_VARIABLES();
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_FOR_LIST_1:
+		  EOP_TARGET(FOR_LIST_1)
 		    {
 #			define ITER TOP_RT_VALUE
 #			define BASE NEXT_TOP_RT_VALUE
@@ -2310,9 +2586,10 @@ do {								\
 #			undef ITER
 #			undef BASE
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_FOR_LIST_2:
+		  EOP_TARGET(FOR_LIST_2)
 		    {
 #			define ITER TOP_RT_VALUE
 #			define BASE NEXT_TOP_RT_VALUE
@@ -2374,11 +2651,12 @@ do {								\
 #			undef ITER
 #			undef BASE
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_BITOR:
 		case EOP_BITAND:
 		case EOP_BITXOR:
+		  EOP_TARGET(BITOR)
 		    {
 			Var rhs, lhs, ans;
 
@@ -2406,10 +2684,11 @@ do {								\
 			else
 			    PUSH(ans);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_BITSHL:
 		case EOP_BITSHR:
+		  EOP_TARGET(BITSHL)
 		    {
 			Var rhs, lhs, ans;
 
@@ -2418,10 +2697,10 @@ do {								\
 			if (lhs.type != TYPE_INT || rhs.type != TYPE_INT) {
 			    ans.type = TYPE_ERR;
 			    ans.v.err = E_TYPE;
-			} else if (rhs.v.num > sizeof(Num) * CHAR_BIT || rhs.v.num < 0) {
+			} else if (rhs.v.num > (Num) (sizeof(Num) * CHAR_BIT) || rhs.v.num < 0) {
 			    ans.type = TYPE_ERR;
 			    ans.v.err = E_INVARG;
-			} else if (rhs.v.num == sizeof(Num) * CHAR_BIT) {
+			} else if (rhs.v.num == (Num) (sizeof(Num) * CHAR_BIT)) {
 			    ans.type = TYPE_INT;
 			    ans.v.num = 0;
 			} else if (rhs.v.num == 0) {
@@ -2448,9 +2727,10 @@ do {								\
 			else
 			    PUSH(ans);
 		    }
-		    break;
+		    NEXT_OPCODE();
 
 		case EOP_COMPLEMENT:
+		  EOP_TARGET(COMPLEMENT)
 		    {
 			Var arg, ans;
 
@@ -2469,13 +2749,182 @@ do {								\
 			else
 			    PUSH(ans);
 		    }
-		    break;
+		    NEXT_OPCODE();
+
+		case EOP_BI_FUNC_CALL:
+		  EOP_TARGET(BI_FUNC_CALL)
+		    {
+			unsigned func_id, nargs;
+			package p;
+
+			func_id = READ_BYTES(bv, 1);
+			nargs = READ_BYTES(bv, 1);
+			/* Building the argument list used to cost a tick
+			 * of its own; keep charging for it.
+			 */
+			if (nargs > 0)
+			    ticks_remaining--;
+			rts -= nargs;
+
+			STORE_STATE_VARIABLES();
+			p = call_bi_func_on_stack(func_id, rts, nargs,
+						  RUN_ACTIV.progr);
+			LOAD_STATE_VARIABLES();
+
+			FINISH_BI_FUNC_CALL(p, func_id);
+		    }
+		    NEXT_OPCODE();
+
+		/* The intrinsics cost the same two ticks as the calls they
+		 * replace.
+		 */
+		case EOP_BF_LENGTH:
+		  EOP_TARGET(BF_LENGTH)
+		    {
+			Var arg, ans;
+
+			ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_LENGTH, 1);
+			arg = POP();
+			ans.type = TYPE_INT;
+			if (arg.type == TYPE_LIST)
+			    ans.v.num = arg.v.list[0].v.num;
+			else if (arg.type == TYPE_MAP)
+			    ans.v.num = maplength(arg);
+			else if (arg.type == TYPE_STR)
+			    ans.v.num = memo_strlen(arg.v.str);
+			else
+			    ans.type = TYPE_ERR;
+			free_var(arg);
+			if (ans.type == TYPE_ERR)
+			    PUSH_ERROR(E_TYPE);
+			else
+			    PUSH(ans);
+		    }
+		    NEXT_OPCODE();
+
+		case EOP_BF_TYPEOF:
+		  EOP_TARGET(BF_TYPEOF)
+		    {
+			Var arg, ans;
+
+			ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_TYPEOF, 1);
+			arg = POP();
+			ans.type = TYPE_INT;
+			ans.v.num = (int) arg.type & TYPE_DB_MASK;
+			free_var(arg);
+			PUSH(ans);
+		    }
+		    NEXT_OPCODE();
+
+		case EOP_BF_VALID:
+		  EOP_TARGET(BF_VALID)
+		    {
+			Var arg, ans;
+
+			ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_VALID, 1);
+			arg = POP();
+			if (arg.is_object()) {
+			    ans.type = TYPE_INT;
+			    ans.v.num = is_valid(arg);
+			    free_var(arg);
+			    PUSH(ans);
+			} else {
+			    free_var(arg);
+			    PUSH_ERROR(E_TYPE);
+			}
+		    }
+		    NEXT_OPCODE();
+
+		case EOP_BF_IS_MEMBER:
+		  EOP_TARGET(BF_IS_MEMBER)
+		    {
+			Var lhs, rhs, ans;
+
+			ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_IS_MEMBER, 2);
+			rhs = POP();
+			lhs = POP();
+			if (rhs.type == TYPE_LIST || rhs.type == TYPE_MAP) {
+			    ans.type = TYPE_INT;
+			    ans.v.num = ismember(lhs, rhs, 1);
+			    free_var(lhs);
+			    free_var(rhs);
+			    PUSH(ans);
+			} else {
+			    free_var(lhs);
+			    free_var(rhs);
+			    PUSH_ERROR(E_INVARG);
+			}
+		    }
+		    NEXT_OPCODE();
+
+		case EOP_BF_LISTAPPEND:
+		  EOP_TARGET(BF_LISTAPPEND)
+		    {
+			Var r, value, list;
+
+			ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_LISTAPPEND, 2);
+			value = POP();
+			list = POP();
+			if (list.type != TYPE_LIST) {
+			    free_var(list);
+			    free_var(value);
+			    PUSH_ERROR(E_TYPE);
+			} else {
+			    r = listappend(list, value);
+			    if (value_bytes(r) <= server_int_option_cached(SVO_MAX_LIST_VALUE_BYTES))
+				PUSH(r);
+			    else {
+				free_var(r);
+				PUSH_ERROR_UNLESS_QUOTA(E_QUOTA);
+			    }
+			}
+		    }
+		    NEXT_OPCODE();
+
+		case EOP_BF_TOSTR:
+		  EOP_TARGET(BF_TOSTR)
+		    {
+			unsigned i, nargs = READ_BYTES(bv, 1);
+			Stream *s;
+			Var r;
+
+			if (nargs > 0)
+			    ticks_remaining--;
+			INTRINSIC_FALLBACK(EOP_BF_TOSTR, nargs);
+			rts -= nargs;
+			s = new_stream(100);
+			TRY_STREAM;
+			try {
+			    for (i = 0; i < nargs; i++)
+				stream_add_tostr(s, rts[i]);
+			    r.type = TYPE_STR;
+			    r.v.str = str_dup(stream_contents(s));
+			}
+			catch (stream_too_big& exception) {
+			    r.type = TYPE_ERR;
+			}
+			ENDTRY_STREAM;
+			free_stream(s);
+			for (i = 0; i < nargs; i++)
+			    free_var(rts[i]);
+			if (r.type == TYPE_ERR)
+			    PUSH_ERROR_UNLESS_QUOTA(E_QUOTA);
+			else
+			    PUSH(r);
+		    }
+		    NEXT_OPCODE();
 
 		default:
+		  EOP_TARGET(default)
 		    panic("Unknown extended opcode!");
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	    /* These opcodes account for about 20% of all opcodes executed, so
 	       let's split out the case stmt so the compiler can help us out.
@@ -2518,6 +2967,7 @@ do {								\
 	case OP_PUSH + 29:
 	case OP_PUSH + 30:
 	case OP_PUSH + 31:
+	  OP_TARGET(PUSH)
 	    {
 		Var value;
 		value = RUN_ACTIV.rt_env[PUSH_n_INDEX(op)];
@@ -2527,7 +2977,7 @@ do {								\
 		} else
 		    PUSH_REF(value);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 #ifdef BYTECODE_REDUCE_REF
 	case OP_PUSH_CLEAR:
@@ -2562,6 +3012,7 @@ do {								\
 	case OP_PUSH_CLEAR + 29:
 	case OP_PUSH_CLEAR + 30:
 	case OP_PUSH_CLEAR + 31:
+	  OP_TARGET(PUSH_CLEAR)
 	    {
 		Var *vp;
 		vp = &RUN_ACTIV.rt_env[PUSH_CLEAR_n_INDEX(op)];
@@ -2572,7 +3023,7 @@ do {								\
 		    vp->type = TYPE_NONE;
 		}
 	    }
-	    break;
+	    NEXT_OPCODE();
 #endif				/* BYTECODE_REDUCE_REF */
 
 	case OP_PUT:
@@ -2607,6 +3058,7 @@ do {								\
 	case OP_PUT + 29:
 	case OP_PUT + 30:
 	case OP_PUT + 31:
+	  OP_TARGET(PUT)
 	    {
 		Var *varp = &RUN_ACTIV.rt_env[PUT_n_INDEX(op)];
 		free_var(*varp);
@@ -2616,9 +3068,10 @@ do {								\
 		} else
 		    *varp = var_ref(TOP_RT_VALUE);
 	    }
-	    break;
+	    NEXT_OPCODE();
 
 	default:
+	  OP_TARGET(default)
 	    if (IS_OPTIM_NUM_OPCODE(op)) {
 		Var value;
 		value.type = TYPE_INT;
@@ -2626,7 +3079,7 @@ do {								\
 		PUSH(value);
 	    } else
 		panic("Unknown opcode!");
-	    break;
+	    NEXT_OPCODE();
 	}
     }
 }
@@ -2637,20 +3090,22 @@ do {								\
 static int timeouts_enabled = 1;	/* set to 0 in debugger to disable
 					   timeouts */
 
-static void
-task_timeout(Timer_ID id, Timer_Data data)
+int
+task_time_is_up(void)
 {
-    task_timed_out = timeouts_enabled;
+    if (!task_timed_out && timeouts_enabled
+	&& monotonic_msecs() >= task_deadline)
+	task_timed_out = 1;
+    return task_timed_out;
 }
 
-static Timer_ID
+static void
 setup_task_execution_limits(int seconds, int ticks)
 {
-    task_alarm_id = set_virtual_timer(seconds < 1 ? 1 : seconds,
-				      task_timeout, 0);
+    task_deadline = monotonic_msecs()
+		    + (int64_t) (seconds < 1 ? 1 : seconds) * 1000;
     task_timed_out = 0;
     ticks_remaining = (ticks < 100 ? 100 : ticks);
-    return task_alarm_id;
 }
 
 enum outcome
@@ -2683,7 +3138,6 @@ run_interpreter(char raise, enum error e,
     interpreter_is_running = 0;
     args = handler_verb_args;
 
-    cancel_timer(task_alarm_id);
     task_timed_out = 0;
 
     if (ret == OUTCOME_ABORTED && handler_verb_name) {
@@ -3029,16 +3483,17 @@ bf_raise(Var arglist, Byte next, void *vdata, Objid progr)
 static package
 bf_suspend(Var arglist, Byte next, void *vdata, Objid progr)
 {
-    static int seconds;
+    static double seconds;
     int nargs = arglist.v.list[0].v.num;
 
     if (nargs >= 1)
-	seconds = arglist.v.list[1].v.num;
+	seconds = (arglist.v.list[1].type == TYPE_INT
+		   ? arglist.v.list[1].v.num : arglist.v.list[1].v.fnum);
     else
 	seconds = -1;
     free_var(arglist);
 
-    if (nargs >= 1 && seconds < 0)
+    if (nargs >= 1 && !(seconds >= 0))
 	return make_error_pack(E_INVARG);
     else
 	return make_suspend_pack(enqueue_suspended_task, &seconds);
@@ -3126,8 +3581,10 @@ static package
 bf_seconds_left(Var arglist, Byte next, void *vdata, Objid progr)
 {
     Var r;
+    int64_t left = task_deadline - monotonic_msecs();
+
     r.type = TYPE_INT;
-    r.v.num = timer_wakeup_interval(task_alarm_id);
+    r.v.num = left > 0 ? left / 1000 : 0;
     free_var(arglist);
     return make_var_pack(r);
 }
@@ -3210,7 +3667,7 @@ static package
 bf_task_stack(Var arglist, Byte next, void *vdata, Objid progr)
 {
     int nargs = arglist.v.list[0].v.num;
-    int id = arglist.v.list[1].v.num;
+    Num id = arglist.v.list[1].v.num;
     int line_numbers_too = (nargs >= 2 && is_true(arglist.v.list[2]));
     vm the_vm = find_suspended_task(id);
     Objid owner = (the_vm ? progr_of_cur_verb(the_vm) : NOTHING);
@@ -3236,7 +3693,7 @@ register_execute(void)
 				      bf_call_function_write,
 				      TYPE_STR);
     register_function("raise", 1, 3, bf_raise, TYPE_ANY, TYPE_STR, TYPE_ANY);
-    register_function("suspend", 0, 1, bf_suspend, TYPE_INT);
+    register_function("suspend", 0, 1, bf_suspend, TYPE_NUMERIC);
     register_function("read", 0, 2, bf_read, TYPE_OBJ, TYPE_ANY);
     register_function("read_http", 1, 2, bf_read_http, TYPE_STR, TYPE_OBJ);
 
@@ -3264,7 +3721,7 @@ write_activ_as_pi(activation a)
 
     dbio_write_var(a._this);
     dbio_write_var(a.vloc);
-    dbio_printf("%d %d %d %d %d %d %d %d %d\n",
+    dbio_printf("%" PRIdN " %d %d %" PRIdN " %d %" PRIdN " %d %d %d\n",
 	    a.recv, -7, -8, a.player, -9, a.progr, -10, -11, a.debug);
     dbio_write_string("No");
     dbio_write_string("More");
@@ -3294,7 +3751,7 @@ read_activ_as_pi(activation * a)
      * suppressed assignments are not counted in determining the returned value
      * of `scanf'...
      */
-    if (dbio_scanf("%d %d %d %d %d %d %d %d %d%c",
+    if (dbio_scanf("%" SCNdN " %d %d %" SCNdN " %d %" SCNdN " %d %d %d%c",
 		 &a->recv, &dummy, &dummy, &a->player, &dummy, &a->progr,
 		   &vloc_oid, &dummy, &a->debug, &c) != 10
 	|| c != '\n') {
@@ -3411,7 +3868,8 @@ write_activ(activation a)
 {
     register Var *v;
 
-    dbio_printf("language version %u\n", a.prog->version);
+    dbio_printf("language version %u %u\n", a.prog->version,
+		a.prog->cg_features);
     dbio_write_program(a.prog);
     write_rt_env(a.prog->var_names, a.rt_env, a.prog->num_var_names);
 
@@ -3439,11 +3897,19 @@ check_pc_validity(Program * prog, int which_vector, unsigned pc)
 		     : &prog->fork_vectors[which_vector]);
 
     /* Current insn must be call to verb or built-in function like eval(),
-     * move(), pass(), or suspend().
+     * move(), pass(), or suspend(), or an intrinsic whose function was
+     * protected and handed off to #0:bf_FUNCNAME().
      */
     return (pc < bc->size
 	    && (bc->vector[pc - 1] == OP_CALL_VERB
-		|| bc->vector[pc - 2] == OP_BI_FUNC_CALL));
+		|| bc->vector[pc - 2] == OP_BI_FUNC_CALL
+		|| (pc >= 4 && bc->vector[pc - 4] == OP_EXTENDED
+		    && bc->vector[pc - 3] == EOP_BI_FUNC_CALL)
+		|| (pc >= 2 && bc->vector[pc - 2] == OP_EXTENDED
+		    && intrinsic_nargs((Extended_Opcode)
+				       bc->vector[pc - 1]) > 0)
+		|| (pc >= 3 && bc->vector[pc - 3] == OP_EXTENDED
+		    && bc->vector[pc - 2] == EOP_BF_TOSTR)));
 }
 
 int
@@ -3456,23 +3922,39 @@ read_activ(activation * a, int which_vector)
     unsigned i;
     const char *func_name;
     int max_stack;
+    unsigned features = 0, old_features;
     char c;
 
+    /* The program is recompiled from source, and the saved pc only makes
+     * sense if it's compiled the same way it was when the task was
+     * suspended.  Tasks saved before code generation features were
+     * recorded used none of them.
+     */
     if (dbio_input_version < DBV_Float)
 	version = dbio_input_version;
-    else if (dbio_scanf("language version %u\n", &version) != 1) {
+    else if (dbio_scanf("language version %u%c", &version, &c) != 2) {
 	errlog("READ_ACTIV: Malformed language version\n");
 	return 0;
     } else if (!check_db_version(version)) {
 	errlog("READ_ACTIV: Unrecognized language version: %d\n",
 	       version);
 	return 0;
+    } else if (c != '\n' && dbio_scanf("%u\n", &features) != 1) {
+	errlog("READ_ACTIV: Malformed code generation features\n");
+	return 0;
+    } else if (features & ~CG_ALL_FEATURES) {
+	errlog("READ_ACTIV: Unrecognized code generation features: %u\n",
+	       features);
+	return 0;
     }
-    if (!(a->prog = dbio_read_program(version,
-				      0, (void *) "suspended task"))) {
+    old_features = set_code_gen_features(features);
+    a->prog = dbio_read_program(version, 0, (void *) "suspended task");
+    set_code_gen_features(old_features);
+    if (!a->prog) {
 	errlog("READ_ACTIV: Malformed program\n");
 	return 0;
     }
+    a->prog->cg_features = features;
     if (!read_rt_env(&old_names, &old_rt_env, &old_size)) {
 	errlog("READ_ACTIV: Malformed runtime environment\n");
 	return 0;
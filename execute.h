@@ -116,6 +116,13 @@ extern enum outcome do_server_program_task(Var _this, const char *verb,
 extern enum outcome resume_from_previous_vm(vm the_vm, Var value);
 
 extern int task_timed_out;
+extern "C" int task_time_is_up(void);
+				/* Checks the clock and returns true iff the
+				 * running task has used up its seconds, in
+				 * which case `task_timed_out' is set, too.
+				 * Code that can run for a long time should
+				 * call this now and then.
+				 */
 extern void abort_running_task(void);
 extern void print_error_backtrace(const char *, void (*)(const char *));
 extern Var caller();
@@ -166,11 +166,38 @@ bf_log_cache_stats(Var arglist, Byte next, void *vdata, Objid progr)
 	return make_error_pack(E_PERM);
     }
     db_log_cache_stats();
+    db_log_prop_cache_stats();
 
     return no_var_pack();
 }
+
+static package
+bf_property_cache_stats(Var arglist, Byte next, void *vdata, Objid progr)
+{
+    Var r;
+
+    free_var(arglist);
+
+    if (!is_wizard(progr)) {
+	return make_error_pack(E_PERM);
+    }
+    r = db_prop_cache_stats();
+
+    return make_var_pack(r);
+}
 #endif
 
+static package
+bf_verb_compilation_stats(Var arglist, Byte next, void *vdata, Objid progr)
+{
+    free_var(arglist);
+
+    if (!is_wizard(progr)) {
+	return make_error_pack(E_PERM);
+    }
+    return make_var_pack(db_verb_compilation_stats());
+}
+
 
 void
 register_extensions()
@@ -182,5 +209,8 @@ register_extensions()
 #ifdef STUPID_VERB_CACHE
     register_function("log_cache_stats", 0, 0, bf_log_cache_stats);
     register_function("verb_cache_stats", 0, 0, bf_verb_cache_stats);
+    register_function("property_cache_stats", 0, 0, bf_property_cache_stats);
 #endif
+    register_function("verb_compilation_stats", 0, 0,
+		      bf_verb_compilation_stats);
 }
@@ -89,6 +89,7 @@ struct bft_entry {
     int maxargs;
     var_type *prototype;
     bf_type func;
+    bf_stack_type stack_func;
     bf_read_type read;
     bf_write_type write;
     int _protected;
@@ -99,7 +100,8 @@ static unsigned top_bf_table = 0;
 
 static unsigned
 register_common(const char *name, int minargs, int maxargs, bf_type func,
-		bf_read_type read, bf_write_type write, va_list args)
+		bf_stack_type stack_func, bf_read_type read,
+		bf_write_type write, va_list args)
 {
     int va_index;
     int num_arg_types = maxargs == -1 ? minargs : maxargs;
@@ -120,6 +122,7 @@ register_common(const char *name, int minargs, int maxargs, bf_type func,
     bf_table[top_bf_table].minargs = minargs;
     bf_table[top_bf_table].maxargs = maxargs;
     bf_table[top_bf_table].func = func;
+    bf_table[top_bf_table].stack_func = stack_func;
     bf_table[top_bf_table].read = read;
     bf_table[top_bf_table].write = write;
     bf_table[top_bf_table]._protected = 0;
@@ -143,7 +146,7 @@ register_function(const char *name, int minargs, int maxargs,
     unsigned ans;
 
     va_start(args, func);
-    ans = register_common(name, minargs, maxargs, func, 0, 0, args);
+    ans = register_common(name, minargs, maxargs, func, 0, 0, 0, args);
     va_end(args);
     return ans;
 }
@@ -157,7 +160,21 @@ register_function_with_read_write(const char *name, int minargs, int maxargs,
     unsigned ans;
 
     va_start(args, write);
-    ans = register_common(name, minargs, maxargs, func, read, write, args);
+    ans = register_common(name, minargs, maxargs, func, 0, read, write,
+			  args);
+    va_end(args);
+    return ans;
+}
+
+unsigned
+register_stack_function(const char *name, int minargs, int maxargs,
+			bf_stack_type func,...)
+{
+    va_list args;
+    unsigned ans;
+
+    va_start(args, func);
+    ans = register_common(name, minargs, maxargs, 0, func, 0, 0, args);
     va_end(args);
     return ans;
 }
@@ -189,6 +206,36 @@ number_func_by_name(const char *name)
 
 /*** calling built-in functions ***/
 
+static enum error
+check_arguments(struct bft_entry *f, Var * args, int nargs)
+{
+    int k, max;
+
+    /*
+     * Check argument count
+     * (Can't always check in the compiler, because of @)
+     */
+    if (nargs < f->minargs || (f->maxargs != -1 && nargs > f->maxargs))
+	return E_ARGS;
+    /*
+     * Check argument types
+     */
+    max = (f->maxargs == -1) ? f->minargs : nargs;
+
+    for (k = 0; k < max; k++) {
+	var_type proto = f->prototype[k];
+	var_type arg = args[k].type;
+
+	if (!(proto == TYPE_ANY
+	      || (proto == TYPE_NUMERIC && (arg == TYPE_INT
+					    || arg == TYPE_FLOAT))
+	      || proto == arg))
+	    return E_TYPE;
+    }
+
+    return E_NONE;
+}
+
 package
 call_bi_func(unsigned n, Var arglist, Byte func_pc,
 	     Objid progr, void *vdata)
@@ -205,9 +252,6 @@ call_bi_func(unsigned n, Var arglist, Byte func_pc,
     f = bf_table + n;
 
     if (func_pc == 1) {		/* check arg types and count *ONLY* for first entry */
-	int k, max;
-	Var *args = arglist.v.list;
-
 	/*
 	 * Check permissions, if protected
 	 */
@@ -223,31 +267,12 @@ call_bi_func(unsigned n, Var arglist, Byte func_pc,
 		return make_error_pack(e == E_MAXREC ? e : E_PERM);
 	    }
 	}
-	/*
-	 * Check argument count
-	 * (Can't always check in the compiler, because of @)
-	 */
-	if (args[0].v.num < f->minargs
-	    || (f->maxargs != -1 && args[0].v.num > f->maxargs)) {
-	    free_var(arglist);
-	    return make_error_pack(E_ARGS);
-	}
-	/*
-	 * Check argument types
-	 */
-	max = (f->maxargs == -1) ? f->minargs : args[0].v.num;
+	enum error e = check_arguments(f, arglist.v.list + 1,
+				       arglist.v.list[0].v.num);
 
-	for (k = 0; k < max; k++) {
-	    var_type proto = f->prototype[k];
-	    var_type arg = args[k + 1].type;
-
-	    if (!(proto == TYPE_ANY
-		  || (proto == TYPE_NUMERIC && (arg == TYPE_INT
-						|| arg == TYPE_FLOAT))
-		  || proto == arg)) {
-		free_var(arglist);
-		return make_error_pack(E_TYPE);
-	    }
+	if (e != E_NONE) {
+	    free_var(arglist);
+	    return make_error_pack(e);
 	}
     } else if (func_pc == 2 && vdata == &call_bi_func) {
 	/* This is a return from calling #0:bf_FUNCNAME(@ARGS); return what
@@ -258,8 +283,52 @@ call_bi_func(unsigned n, Var arglist, Byte func_pc,
     /*
      * do the function
      */
-    return (*(f->func)) (arglist, func_pc, vdata, progr);
+    if (f->func)
+	return (*(f->func)) (arglist, func_pc, vdata, progr);
     /* f->func is responsible for freeing/using up arglist. */
+
+    package p = (*(f->stack_func)) (arglist.v.list + 1,
+				    arglist.v.list[0].v.num, progr);
+    free_var(arglist);
+    return p;
+}
+
+int
+bi_func_protected(unsigned n)
+{
+    return (n < top_bf_table && bf_table[n]._protected
+	    && (!caller().is_obj() || caller().v.obj != SYSTEM_OBJECT));
+}
+
+package
+call_bi_func_on_stack(unsigned n, Var * args, int nargs, Objid progr)
+     /* ARGS are the NARGS arguments, still in place on the stack */
+{
+    struct bft_entry *f = bf_table + n;
+    package p;
+    enum error e;
+    int i;
+
+    /* Functions without a stack entry point, and protected ones (which
+     * might have to be passed on to #0:bf_FUNCNAME(@ARGS)), take the
+     * long way round.
+     */
+    if (n >= top_bf_table || !f->stack_func || bi_func_protected(n)) {
+	Var arglist = new_list(nargs);
+
+	for (i = 0; i < nargs; i++)
+	    arglist.v.list[i + 1] = args[i];
+	return call_bi_func(n, arglist, 1, progr, 0);
+    }
+
+    if ((e = check_arguments(f, args, nargs)) != E_NONE)
+	p = make_error_pack(e);
+    else
+	p = (*(f->stack_func)) (args, nargs, progr);
+
+    for (i = 0; i < nargs; i++)
+	free_var(args[i]);
+    return p;
 }
 
 void
@@ -72,6 +72,14 @@ typedef package(*bf_type) (Var, Byte, void *, Objid);
 typedef void (*bf_write_type) (void *vdata);
 typedef void *(*bf_read_type) (void);
 
+/* A cheaper calling convention for small functions that always return
+ * (or raise) right away: the function is handed the arguments where they
+ * sit on the interpreter's stack, and must not free them or hold on to
+ * them without taking a reference.  It may only return a BI_RETURN or
+ * BI_RAISE package.
+ */
+typedef package(*bf_stack_type) (Var *args, int nargs, Objid progr);
+
 #define MAX_FUNC         256
 #define FUNC_NOT_FOUND   MAX_FUNC
 /* valid function numbers are 0 - 255, or a total of 256 of them.
@@ -86,10 +94,18 @@ extern unsigned register_function(const char *, int, int, bf_type,...);
 extern unsigned register_function_with_read_write(const char *, int, int,
 						  bf_type, bf_read_type,
 						  bf_write_type,...);
+extern unsigned register_stack_function(const char *, int, int,
+					bf_stack_type,...);
 
 extern package call_bi_func(unsigned, Var, Byte, Objid, void *);
 /* will free or use Var arglist */
 
+extern package call_bi_func_on_stack(unsigned, Var *, int, Objid);
+/* will free or use the arguments */
+
+extern int bi_func_protected(unsigned);
+/* true if a call from the running verb has to pass the protection check */
+
 extern void write_bi_func_data(void *vdata, Byte f_id);
 extern int read_bi_func_data(Byte f_id, void **bi_func_state,
 			     Byte * bi_func_pc);
@@ -217,10 +217,10 @@ handle_number(void *ctx, const char *numberVal, unsigned int numberLen, yajl_tok
 
     if (yajl_tok_integer == tok) {
 
-	long int i = 0;
+	intmax_t i = 0;
 
 	errno = 0;
-	i = strtol(numberVal, NULL, 10);
+	i = strtoimax(numberVal, NULL, 10);
 
 	if (0 == errno && (i >= MININT && i <= MAXINT)) {
 	    v = Var::new_int(i);
@@ -262,13 +262,13 @@ handle_string(void *ctx, const unsigned char *stringVal, unsigned int stringLen)
 		if (*val == '#')
 		    val++;
 		v.type = TYPE_OBJ;
-		v.v.num = strtol(val, &p, 10);
+		v.v.num = strtoimax(val, &p, 10);
 		break;
 	    }
 	case TYPE_INT:
 	    {
 		char *p;
-		v = Var::new_int(strtol(val, &p, 10));
+		v = Var::new_int(strtoimax(val, &p, 10));
 		break;
 	    }
 	case TYPE_FLOAT:
@@ -439,7 +439,7 @@ generate(yajl_gen g, Var v, void *ctx)
     case TYPE_INT:
 	return yajl_gen_integer(g, v.v.num);
     case TYPE_FLOAT:
-	return yajl_gen_double(g, *v.v.fnum);
+	return yajl_gen_double(g, v.v.fnum);
     case TYPE_OBJ:
     case TYPE_ERR:
 	{
@@ -37,6 +37,51 @@
 #include "utils.h"
 #include "server.h"
 
+/* Lists are allocated with room to grow.  The number of elements the
+ * allocation has room for (not counting the length in element 0) is
+ * kept in the storage header, below the memoized size.  A list that
+ * only this reference can see may be appended to in place, and its
+ * allocation grows geometrically, so building a list an element at a
+ * time (`result = {@result, x}') costs amortized constant time per
+ * element.
+ */
+#define list_capacity(l)	(((int *)(l))[-3])
+
+static inline bool
+list_is_mutable(Var list)
+{
+#ifdef ENABLE_GC
+    /* a buffered list may be a candidate root, which must not move */
+    if (gc_is_buffered(list.v.list))
+	return false;
+#endif
+    return var_refcount(list) == 1;
+}
+
+/* Makes room for `size' elements in `list', which must be mutable.
+ * The caller is responsible for the memoized size.
+ */
+static Var
+list_reserve(Var list, int size)
+{
+    int capacity = list_capacity(list.v.list);
+
+    if (size > capacity) {
+	capacity = MAX(capacity * 2, 4);
+	if (capacity < size)
+	    capacity = size;
+	list.v.list = (Var *)myrealloc(list.v.list,
+				       (capacity + 1) * sizeof(Var), M_LIST);
+	list_capacity(list.v.list) = capacity;
+    }
+
+#ifdef ENABLE_GC
+    gc_set_color(list.v.list, GC_YELLOW);
+#endif
+
+    return list;
+}
+
 Var
 new_list(int size)
 {
@@ -54,6 +99,7 @@ new_list(int size)
 	    emptylist.v.list = ptr;
 	    emptylist.v.list[0].type = TYPE_INT;
 	    emptylist.v.list[0].v.num = 0;
+	    list_capacity(emptylist.v.list) = 0;
 	}
 
 #ifdef ENABLE_GC
@@ -72,6 +118,7 @@ new_list(int size)
     list.v.list = ptr;
     list.v.list[0].type = TYPE_INT;
     list.v.list[0].v.num = size;
+    list_capacity(list.v.list) = size;
 
 #ifdef ENABLE_GC
     gc_set_color(list.v.list, GC_YELLOW);
@@ -184,19 +231,18 @@ doinsert(Var list, Var value, int pos)
     int i;
     int size = list.v.list[0].v.num + 1;
 
-    if (var_refcount(list) == 1 && pos == size) {
-	list.v.list = (Var *) myrealloc(list.v.list, (size + 1) * sizeof(Var), M_LIST);
+    if (list_is_mutable(list)) {
+	list = list_reserve(list, size);
 #ifdef MEMO_VALUE_BYTES
-	/* reset the memoized size */
-	((int *)(list.v.list))[-2] = 0;
+	/* keep the memoized size, if there is one, up to date */
+	if (((int *)(list.v.list))[-2])
+	    ((int *)(list.v.list))[-2] += value_bytes(value);
 #endif
+	memmove(list.v.list + pos + 1, list.v.list + pos,
+		(size - pos) * sizeof(Var));
 	list.v.list[0].v.num = size;
 	list.v.list[pos] = value;
 
-#ifdef ENABLE_GC
-	gc_set_color(list.v.list, GC_YELLOW);
-#endif
-
 	return list;
     }
     _new = new_list(size);
@@ -263,6 +309,22 @@ listconcat(Var first, Var second)
     Var _new;
     int i;
 
+    if (lsecond > 0 && list_is_mutable(first)) {
+	first = list_reserve(first, lfirst + lsecond);
+#ifdef MEMO_VALUE_BYTES
+	if (((int *)(first.v.list))[-2])
+	    ((int *)(first.v.list))[-2] += list_sizeof(second.v.list)
+					   - sizeof(Var);
+#endif
+	for (i = 1; i <= lsecond; i++)
+	    first.v.list[i + lfirst] = var_ref(second.v.list[i]);
+	first.v.list[0].v.num = lfirst + lsecond;
+
+	free_var(second);
+
+	return first;
+    }
+
     _new = new_list(lsecond + lfirst);
     for (i = 1; i <= lfirst; i++)
 	_new.v.list[i] = var_ref(first.v.list[i]);
@@ -354,15 +416,15 @@ listequal(Var lhs, Var rhs, int case_matters)
     return 1;
 }
 
-static void
+void
 stream_add_tostr(Stream * s, Var v)
 {
     switch (v.type) {
     case TYPE_INT:
-	stream_printf(s, "%d", v.v.num);
+	stream_printf(s, "%" PRIdN, v.v.num);
 	break;
     case TYPE_OBJ:
-	stream_printf(s, "#%d", v.v.obj);
+	stream_printf(s, "#%" PRIdN, v.v.obj);
 	break;
     case TYPE_STR:
 	stream_add_string(s, v.v.str);
@@ -371,7 +433,7 @@ stream_add_tostr(Stream * s, Var v)
 	stream_add_string(s, unparse_error(v.v.err));
 	break;
     case TYPE_FLOAT:
-	stream_printf(s, "%g", *v.v.fnum);
+	stream_printf(s, "%g", v.v.fnum);
 	break;
     case TYPE_MAP:
 	stream_add_string(s, "[map]");
@@ -425,16 +487,16 @@ unparse_value(Stream * s, Var v)
 {
     switch (v.type) {
     case TYPE_INT:
-	stream_printf(s, "%d", v.v.num);
+	stream_printf(s, "%" PRIdN, v.v.num);
 	break;
     case TYPE_OBJ:
-	stream_printf(s, "#%d", v.v.obj);
+	stream_printf(s, "#%" PRIdN, v.v.obj);
 	break;
     case TYPE_ERR:
 	stream_add_string(s, error_name(v.v.err));
 	break;
     case TYPE_FLOAT:
-	stream_printf(s, "%g", *v.v.fnum);
+	stream_printf(s, "%g", v.v.fnum);
 	break;
     case TYPE_STR:
 	{
@@ -591,29 +653,27 @@ make_space_pack()
 /**** built in functions ****/
 
 static package
-bf_length(Var arglist, Byte next, void *vdata, Objid progr)
+bf_length(Var *args, int nargs, Objid progr)
 {
     Var r;
-    switch (arglist.v.list[1].type) {
+    switch (args[0].type) {
     case TYPE_LIST:
 	r.type = TYPE_INT;
-	r.v.num = arglist.v.list[1].v.list[0].v.num;
+	r.v.num = args[0].v.list[0].v.num;
 	break;
     case TYPE_MAP:
 	r.type = TYPE_INT;
-	r.v.num = maplength(arglist.v.list[1]);
+	r.v.num = maplength(args[0]);
 	break;
     case TYPE_STR:
 	r.type = TYPE_INT;
-	r.v.num = memo_strlen(arglist.v.list[1].v.str);
+	r.v.num = memo_strlen(args[0].v.str);
 	break;
     default:
-	free_var(arglist);
 	return make_error_pack(E_TYPE);
 	break;
     }
 
-    free_var(arglist);
     return make_var_pack(r);
 }
 
@@ -661,15 +721,20 @@ insert_or_append(Var arglist, int append1)
     Var r;
     Var lst = var_ref(arglist.v.list[1]);
     Var elt = var_ref(arglist.v.list[2]);
+    int len = lst.v.list[0].v.num;
 
     if (arglist.v.list[0].v.num == 2)
-	pos = append1 ? lst.v.list[0].v.num + 1 : 1;
+	pos = append1 ? len + 1 : 1;
     else {
-	pos = arglist.v.list[3].v.num + append1;
-	if (pos <= 0)
+	/* clamp before adding, so a huge position can't wrap */
+	Num n = arglist.v.list[3].v.num;
+
+	if (n < 1 - append1)
 	    pos = 1;
-	else if (pos > lst.v.list[0].v.num + 1)
-	    pos = lst.v.list[0].v.num + 1;
+	else if (n > len - append1)
+	    pos = len + 1;
+	else
+	    pos = n + append1;
     }
     free_var(arglist);
 
@@ -728,7 +793,7 @@ bf_listset(Var arglist, Byte next, void *vdata, Objid progr)
 
     Var lst = var_ref(arglist.v.list[1]);
     Var elt = var_ref(arglist.v.list[2]);
-    int pos = arglist.v.list[3].v.num;
+    Num pos = arglist.v.list[3].v.num;
 
     free_var(arglist);
 
@@ -1318,7 +1383,7 @@ register_list(void)
 		      TYPE_STR, TYPE_ANY);
     register_function("encode_binary", 0, -1, bf_encode_binary);
     /* list */
-    register_function("length", 1, 1, bf_length, TYPE_ANY);
+    register_stack_function("length", 1, 1, bf_length, TYPE_ANY);
     register_function("setadd", 2, 2, bf_setadd, TYPE_LIST, TYPE_ANY);
     register_function("setremove", 2, 2, bf_setremove, TYPE_LIST, TYPE_ANY);
     register_function("listappend", 2, 3, bf_listappend,
@@ -43,6 +43,7 @@ extern Var substr(Var str, int lower, int upper);
 extern Var strget(Var str, int i);
 
 extern const char *value2str(Var);
+extern void stream_add_tostr(Stream *, Var);
 extern void unparse_value(Stream *, Var);
 
 /*
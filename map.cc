@@ -63,6 +63,9 @@
 struct rbtree {
     rbnode *root;		/* Top of the tree */
     size_t size;		/* Number of items */
+    rbnode **index;		/* Hash index of the nodes, or NULL */
+    unsigned index_mask;	/* Number of index slots, minus one */
+    unsigned index_fill;	/* Number of used or deleted slots */
 };
 
 struct rbnode {
@@ -85,6 +88,173 @@ node_compare(const rbnode *node1, const rbnode *node2, int case_matters)
     return compare(node1->key, node2->key, case_matters);
 }
 
+/*
+  Hash index
+
+  Once a map grows to MAP_INDEX_MIN entries, its tree gets an open
+  addressed (linear probing) table of pointers to its nodes, which
+  lookups use instead of walking down the tree.  The tree remains
+  the primary representation -- it provides the ordering for
+  iteration, ranges and seeks -- so the index only needs to be kept
+  in step with node creation and deletion.
+
+  Keys are hashed consistently with `compare()' ignoring case.  Float
+  keys aren't indexed, because `compare()' truncates the difference of
+  two floats to an integer; lookups with float keys use the tree.
+ */
+
+#define MAP_INDEX_MIN 64
+
+static rbnode index_tombstone;
+
+static int
+indexable(Var key)
+{
+    return key.type == TYPE_INT || key.type == TYPE_OBJ
+	|| key.type == TYPE_ERR || key.type == TYPE_STR;
+}
+
+static unsigned
+key_hash(Var key)
+{
+    unsigned h = 2166136261u;	/* FNV-1a */
+    const unsigned char *s;
+    unsigned c;
+
+    if (key.type == TYPE_STR)
+	for (s = (const unsigned char *) key.v.str; (c = *s); s++) {
+	    if (c >= 'A' && c <= 'Z')	/* fold case (ASCII only), */
+		c += 'a' - 'A';		/* like `mystrcasecmp()' */
+	    h = (h ^ c) * 16777619u;
+	}
+    else {
+	/* Errors only set `v.err'; numbers and objects use all of `v.num'. */
+	UNum n = (key.type == TYPE_ERR ? (UNum) key.v.err : (UNum) key.v.num);
+
+	n ^= n >> (sizeof(UNum) * 4);
+	h = ((unsigned) n ^ (unsigned) key.type) * 2654435761u;
+    }
+
+    return h ^ (h >> 15);
+}
+
+static rbnode **
+index_slot(const rbtree *tree, Var key, int case_matters)
+{
+    unsigned i = key_hash(key) & tree->index_mask;
+    rbnode **slot;
+
+    while (*(slot = &tree->index[i]) != NULL) {
+	if (*slot != &index_tombstone
+	    && compare((*slot)->key, key, case_matters) == 0)
+	    return slot;
+	i = (i + 1) & tree->index_mask;
+    }
+
+    return slot;
+}
+
+/*
+ * Returns the index slot holding `node', which must be in the index.
+ */
+static rbnode **
+index_node_slot(const rbtree *tree, const rbnode *node)
+{
+    unsigned i = key_hash(node->key) & tree->index_mask;
+
+    while (tree->index[i] != node)
+	i = (i + 1) & tree->index_mask;
+
+    return &tree->index[i];
+}
+
+static void
+index_put(rbtree *tree, rbnode *node)
+{
+    rbnode **slot = index_slot(tree, node->key, 0);
+
+    if (*slot == NULL)
+	tree->index_fill++;
+    *slot = node;
+}
+
+static void
+index_put_all(rbtree *tree, rbnode *node)
+{
+    for (; node != NULL; node = node->link[1]) {
+	if (indexable(node->key))
+	    index_put(tree, node);
+	index_put_all(tree, node->link[0]);
+    }
+}
+
+/*
+ * (Re)builds the index with room for at least twice as many entries
+ * as there are in the tree.
+ */
+static void
+index_build(rbtree *tree)
+{
+    unsigned size = 2 * MAP_INDEX_MIN;
+
+    while (size < 4 * tree->size)
+	size *= 2;
+
+    if (tree->index)
+	myfree(tree->index, M_MAP_INDEX);
+    tree->index = (rbnode **)mymalloc(size * sizeof(rbnode *), M_MAP_INDEX);
+    memset(tree->index, 0, size * sizeof(rbnode *));
+    tree->index_mask = size - 1;
+    tree->index_fill = 0;
+
+    index_put_all(tree, tree->root);
+}
+
+static void
+index_free(rbtree *tree)
+{
+    if (tree->index)
+	myfree(tree->index, M_MAP_INDEX);
+    tree->index = NULL;
+}
+
+/*
+ * Called once `node' has been linked into the tree.  Builds the index
+ * when the tree gets big enough to need it, and rebuilds it when it
+ * fills up (with entries or with the tombstones of deleted ones).
+ */
+static void
+index_add(rbtree *tree, rbnode *node)
+{
+    if (tree->index == NULL) {
+	if (tree->size >= MAP_INDEX_MIN)
+	    index_build(tree);
+    } else if (indexable(node->key)) {
+	if (2 * (tree->index_fill + 1) > tree->index_mask + 1)
+	    index_build(tree);
+	else
+	    index_put(tree, node);
+    }
+}
+
+static void
+index_remove(rbtree *tree, rbnode *node)
+{
+    if (tree->index != NULL && indexable(node->key))
+	*index_node_slot(tree, node) = &index_tombstone;
+}
+
+/*
+ * The node `from' is about to be freed after its contents have been
+ * moved to `to'.
+ */
+static void
+index_move(rbtree *tree, rbnode *from, rbnode *to)
+{
+    if (tree->index != NULL && indexable(from->key))
+	*index_node_slot(tree, from) = to;
+}
+
 static void
 node_free_data(const rbnode *node)
 {
@@ -169,6 +339,9 @@ rbnew(void)
 
     rt->root = NULL;
     rt->size = 0;
+    rt->index = NULL;
+    rt->index_mask = 0;
+    rt->index_fill = 0;
 
     return rt;
 }
@@ -203,6 +376,8 @@ rbdelete(rbtree *tree)
 	it = save;
     }
 
+    index_free(tree);
+
     /* Since this map could possibly be the root of a cycle, final
      * destruction is handled in the garbage collector if garbage
      * collection is enabled.
@@ -222,6 +397,9 @@ rbfind(rbtree *tree, rbnode *node, int case_matters)
 {
     rbnode *it = tree->root;
 
+    if (tree->index != NULL && indexable(node->key))
+	return *index_slot(tree, node->key, case_matters);
+
     while (it != NULL) {
 	int cmp = node_compare(it, node, case_matters);
 
@@ -283,12 +461,14 @@ rbseek(rbtree *tree, rbnode *node, int case_matters)
 static int
 rbinsert(rbtree *tree, rbnode *node)
 {
+    rbnode *added = NULL;	/* The new node */
+
     if (tree->root == NULL) {
 	/*
 	   We have an empty tree; attach the
 	   new node directly to the root
 	 */
-	tree->root = new_node(tree, node->key, node->value);
+	tree->root = added = new_node(tree, node->key, node->value);
 
 	if (tree->root == NULL)
 	    return 0;
@@ -307,7 +487,8 @@ rbinsert(rbtree *tree, rbnode *node)
 	for (;;) {
 	    if (q == NULL) {
 		/* Insert a new node at the first null link */
-		p->link[dir] = q = new_node(tree, node->key, node->value);
+		p->link[dir] = q = added =
+		    new_node(tree, node->key, node->value);
 
 		if (q == NULL)
 		    return 0;
@@ -354,6 +535,9 @@ rbinsert(rbtree *tree, rbnode *node)
     tree->root->red = 0;
     ++tree->size;
 
+    if (added != NULL)
+	index_add(tree, added);
+
     return 1;
 }
 
@@ -433,13 +617,17 @@ rberase(rbtree *tree, rbnode *node)
 
 	/* Replace and remove the saved node */
 	if (f != NULL) {
+	    index_remove(tree, f);
+	    if (q != f)
+		index_move(tree, q, f);
 	    node_free_data(f);
 	    f->key = q->key;
 	    f->value = q->value;
 	    p->link[p->link[1] == q] = q->link[q->link[0] == NULL];
 	    myfree(q, M_NODE);
 
-	    --tree->size;
+	    if (--tree->size < MAP_INDEX_MIN / 2)
+		index_free(tree);
 	} else
 	    ret = 0;
 
@@ -683,13 +871,18 @@ mapinsert(Var map, Var key, Var value)
     ((int *)(_new.v.tree))[-2] = 0;
 #endif
 
-    rbnode node;
+    rbnode node, *pnode;
     node.key = key;
     node.value = value;
 
-    rberase(_new.v.tree, &node);
-
-    if (!rbinsert(_new.v.tree, &node))
+    /* Replace the key and value of an existing entry in place, rather
+     * than erasing and reinserting it.
+     */
+    if ((pnode = rbfind(_new.v.tree, &node, 0)) != NULL) {
+	node_free_data(pnode);
+	pnode->key = key;
+	pnode->value = value;
+    } else if (!rbinsert(_new.v.tree, &node))
 	panic("MAPINSERT: rbinsert failed");
 
 #ifdef ENABLE_GC
@@ -17,16 +17,25 @@
 
 /* This module provides IP host name lookup with timeouts.  Because
  * longjmps out of name lookups corrupt some UNIX name lookup modules, this
- * module uses a subprocess to do the name lookup.  On any failure, the
+ * module uses subprocesses to do the name lookups.  On any failure, the
  * subprocess is restarted.
+ *
+ * The server talks to an intermediary process, which hands requests out to
+ * a small pool of lookup processes so that one slow lookup doesn't hold up
+ * the others.  Every request carries an id, which comes back with its
+ * reply; replies can therefore arrive in any order, and the server reads
+ * the replies to requests it isn't waiting for as they come in.  Answers
+ * to address-to-name lookups are cached in the server process.
  */
 
 #include "options.h"
 
 #if NETWORK_PROTOCOL == NP_TCP	/* Skip almost entire file otherwise... */
 
+#include "my-poll.h"
 #include "my-signal.h"
 #include "my-stdlib.h"
+#include "my-time.h"
 #include "my-unistd.h"
 #include "my-inet.h"		/* inet_addr() */
 #include "my-in.h"		/* struct sockaddr_in, INADDR_ANY, htons(),
@@ -39,6 +48,8 @@
 
 #include "config.h"
 #include "log.h"
+#include "name_lookup.h"
+#include "net_multi.h"
 #include "server.h"
 #include "storage.h"
 #include "timers.h"
@@ -74,7 +85,7 @@ spawn_pipe(void (*child_proc) (int to_parent, int from_parent),
 	*to_child = pipe_to_child[1];
 	*from_child = pipe_from_child[0];
 
-	wait(&status);	/* wait for middleman to die */
+	waitpid(pid, &status, 0);	/* wait for middleman to die */
 	if (status != 0) {
 	    errlog("SPAWNING: Middleman died with status %d!\n", status);
 	    close(pipe_to_child[1]);
@@ -135,6 +146,7 @@ struct request {
     enum {
 	REQ_NAME_FROM_ADDR, REQ_ADDR_FROM_NAME
     } kind;
+    unsigned id;
     unsigned timeout;
     union {
 	unsigned length;
@@ -142,8 +154,46 @@ struct request {
     } u;
 };
 
+/* A reply is a header followed by LENGTH bytes: the host name, or the
+ * address in network byte order.  A LENGTH of zero means the lookup
+ * failed.  Replies are written with a single write() so that they can't
+ * be split up; names are truncated to keep them under PIPE_BUF.
+ */
+struct reply {
+    unsigned id;
+    int length;
+};
+
+#define MAX_REPLY_DATA	1024
+
+static int
+write_reply(int fd, unsigned id, const void *data, int length)
+{
+    char buffer[sizeof(struct reply) + MAX_REPLY_DATA];
+    struct reply *r = (struct reply *) buffer;
+
+    if (length > MAX_REPLY_DATA)
+	length = MAX_REPLY_DATA;
+    r->id = id;
+    r->length = length;
+    memcpy(buffer + sizeof(struct reply), data, length);
+    length += sizeof(struct reply);
+
+    return write(fd, buffer, length) == length;
+}
+
+/* Reads a reply into BUFFER, which must hold MAX_REPLY_DATA bytes. */
+static int
+read_reply(int fd, struct reply *r, char *buffer)
+{
+    return (robust_read(fd, r, sizeof(*r)) == sizeof(*r)
+	    && r->length >= 0 && r->length <= MAX_REPLY_DATA
+	    && (r->length == 0
+		|| robust_read(fd, buffer, r->length) == r->length));
+}
+
 /******************************************************************************
- * Code that runs in the lookup process.
+ * Code that runs in the lookup processes.
  *****************************************************************************/
 
 static void
@@ -169,6 +219,8 @@ lookup(int to_intermediary, int from_intermediary)
 	if (robust_read(from_intermediary, &req, sizeof(req)) != sizeof(req))
 	    _exit(1);
 	if (req.kind == request::REQ_ADDR_FROM_NAME) {
+	    unsigned32 addr;
+
 	    ensure_buffer(&buffer, &buflen, req.u.length + 1);
 	    if (robust_read(from_intermediary, buffer, req.u.length)
 		!= req.u.length)
@@ -178,25 +230,21 @@ lookup(int to_intermediary, int from_intermediary)
 	    e = gethostbyname(buffer);
 	    cancel_timer(id);
 	    if (e && e->h_length == sizeof(unsigned32))
-		write(to_intermediary, e->h_addr_list[0], e->h_length);
-	    else {
-		unsigned32 addr;
-
+		memcpy(&addr, e->h_addr_list[0], sizeof(addr));
+	    else
 		addr = inet_addr(buffer);
-		write(to_intermediary, &addr, sizeof(addr));
-	    }
+	    write_reply(to_intermediary, req.id, &addr, sizeof(addr));
 	} else {
 	    const char *host_name;
-	    int length;
+
 	    id = set_timer(req.timeout, timeout_proc, 0);
 	    e = gethostbyaddr(&req.u.address.sin_addr,
 			      sizeof(req.u.address.sin_addr),
 			      AF_INET);
 	    cancel_timer(id);
 	    host_name = e ? e->h_name : "";
-	    length = strlen(host_name);
-	    write(to_intermediary, &length, sizeof(length));
-	    write(to_intermediary, host_name, length);
+	    write_reply(to_intermediary, req.id, host_name,
+			strlen(host_name));
 	}
     }
 }
@@ -205,80 +253,160 @@ lookup(int to_intermediary, int from_intermediary)
  * Code that runs in the intermediary process.
  *****************************************************************************/
 
-static int to_lookup, from_lookup;
-static pid_t lookup_pid;
+#define NUM_LOOKUP_SLAVES	4
+
+static struct slave {
+    pid_t pid;
+    int to, from;
+    unsigned id;		/* of the request it's working on */
+    int busy;
+} slaves[NUM_LOOKUP_SLAVES];
+
+typedef struct queued_request {
+    struct queued_request *next;
+    struct request req;
+    char *name;			/* for REQ_ADDR_FROM_NAME */
+} queued_request;
+
+static queued_request *queue_head = 0, **queue_tail = &queue_head;
 
 static void
-restart_lookup(void)
+restart_lookup(struct slave *s)
 {
-    if (lookup_pid) {
-	kill(lookup_pid, SIGKILL);
-	close(to_lookup);
-	close(from_lookup);
+    if (s->pid) {
+	kill(s->pid, SIGKILL);
+	close(s->to);
+	close(s->from);
 	oklog("NAME_LOOKUP: Killing old lookup process ...\n");
     }
-    lookup_pid = spawn_pipe(lookup, &to_lookup, &from_lookup);
-    if (lookup_pid)
+    s->busy = 0;
+    s->pid = spawn_pipe(lookup, &s->to, &s->from);
+    if (s->pid)
 	oklog("NAME_LOOKUP: Started new lookup process\n");
     else
 	errlog("NAME_LOOKUP: Can't spawn lookup process; "
 	       "will try again later...\n");
 }
 
+/* Returns an idle lookup process, starting one if need be, or null if
+ * they're all busy (or none can be started).
+ */
+static struct slave *
+idle_slave(void)
+{
+    struct slave *s, *unused = 0;
+
+    for (s = slaves; s < slaves + NUM_LOOKUP_SLAVES; s++)
+	if (s->pid && !s->busy)
+	    return s;
+	else if (!s->pid && !unused)
+	    unused = s;
+
+    if (unused) {
+	restart_lookup(unused);
+	if (unused->pid)
+	    return unused;
+    }
+    return 0;
+}
+
+static void
+dispatch_requests(int to_server)
+{
+    queued_request *q;
+    struct slave *s;
+    int busy = 0;
+
+    for (s = slaves; s < slaves + NUM_LOOKUP_SLAVES; s++)
+	busy += s->busy;
+
+    while ((q = queue_head)) {
+	if (!(s = idle_slave())) {
+	    if (busy)		/* wait for one to finish */
+		return;
+	    /* Lookup dead and wouldn't restart ... */
+	    write_reply(to_server, q->req.id, 0, 0);
+	} else if (write(s->to, &q->req, sizeof(q->req)) != sizeof(q->req)
+		   || (q->name && write(s->to, q->name, q->req.u.length)
+		       != (int) q->req.u.length)) {
+	    restart_lookup(s);
+	    continue;		/* try again with another */
+	} else {
+	    s->busy = 1;
+	    s->id = q->req.id;
+	    busy++;
+	}
+
+	if (!(queue_head = q->next))
+	    queue_tail = &queue_head;
+	if (q->name)
+	    myfree(q->name, M_STRING);
+	myfree(q, M_STRUCT);
+    }
+}
+
 static void
 intermediary(int to_server, int from_server)
 {
-    struct request req;
-    static char *buffer = 0;
-    static int buflen = 0;
-    int len;
-    unsigned32 addr;
+    struct pollfd fds[NUM_LOOKUP_SLAVES + 1];
+    struct slave *s;
+    struct reply r;
+    char buffer[MAX_REPLY_DATA];
+    int i, n;
 
     set_server_cmdline("(MOO name-lookup master)");
     signal(SIGPIPE, SIG_IGN);
-    restart_lookup();
+    restart_lookup(&slaves[0]);
     for (;;) {
-	if (robust_read(from_server, &req, sizeof(req)) != sizeof(req))
-	    _exit(1);
-	if (req.kind == request::REQ_ADDR_FROM_NAME) {
-	    ensure_buffer(&buffer, &buflen, req.u.length);
-	    if (robust_read(from_server, buffer, req.u.length) != req.u.length)
+	fds[0].fd = from_server;
+	fds[0].events = POLLIN;
+	for (i = 0, n = 1; i < NUM_LOOKUP_SLAVES; i++)
+	    if (slaves[i].busy) {
+		fds[n].fd = slaves[i].from;
+		fds[n].events = POLLIN;
+		n++;
+	    }
+	if (poll(fds, n, -1) < 0) {
+	    if (errno != EINTR)
 		_exit(1);
+	    continue;
 	}
-	if (!lookup_pid)	/* Restart lookup if it's died */
-	    restart_lookup();
-	if (lookup_pid) {	/* Only try to deal with lookup if alive */
-	    write(to_lookup, &req, sizeof(req));
-	    if (req.kind == request::REQ_ADDR_FROM_NAME) {
-		write(to_lookup, buffer, req.u.length);
-		if (robust_read(from_lookup, &addr, sizeof(addr))
-		    != sizeof(addr)) {
-		    restart_lookup();
-		    addr = 0;
-		}
-		write(to_server, &addr, sizeof(addr));
-	    } else {
-		if (robust_read(from_lookup, &len, sizeof(len))
-		    != sizeof(len)) {
-		    restart_lookup();
-		    len = 0;
-		} else {
-		    ensure_buffer(&buffer, &buflen, len);
-		    if (len > 0
-			&& robust_read(from_lookup, buffer, len) != len) {
-			restart_lookup();
-			len = 0;
-		    }
-		}
-		write(to_server, &len, sizeof(len));
-		if (len > 0)
-		    write(to_server, buffer, len);
+
+	if (fds[0].revents) {
+	    queued_request *q = (queued_request *)
+		mymalloc(sizeof(queued_request), M_STRUCT);
+
+	    if (robust_read(from_server, &q->req, sizeof(q->req))
+		!= sizeof(q->req))
+		_exit(1);
+	    q->name = 0;
+	    if (q->req.kind == request::REQ_ADDR_FROM_NAME) {
+		q->name = (char *) mymalloc(q->req.u.length + 1, M_STRING);
+		if (robust_read(from_server, q->name, q->req.u.length)
+		    != (int) q->req.u.length)
+		    _exit(1);
 	    }
-	} else {		/* Lookup dead and wouldn't restart ... */
-	    int failure = 0;
+	    q->next = 0;
+	    *queue_tail = q;
+	    queue_tail = &q->next;
+	}
 
-	    write(to_server, &failure, sizeof(failure));
+	for (i = 1; i < n; i++) {
+	    if (!fds[i].revents)
+		continue;
+	    for (s = slaves; s->from != fds[i].fd || !s->busy; s++)
+		;
+	    if (read_reply(s->from, &r, buffer) && r.id == s->id) {
+		s->busy = 0;
+		write_reply(to_server, r.id, buffer, r.length);
+	    } else {
+		/* timed out or otherwise died */
+		write_reply(to_server, s->id, 0, 0);
+		restart_lookup(s);
+	    }
 	}
+
+	dispatch_requests(to_server);
     }
 }
 
@@ -290,70 +418,247 @@ intermediary(int to_server, int from_server)
 static int to_intermediary, from_intermediary;
 static int dead_intermediary = 0;
 
+static unsigned next_request_id = 1;
 
-int
-initialize_name_lookup(void)
+/* Background address-to-name lookups that haven't been answered yet.  A
+ * cancelled one stays on the list, with no callback, so that its answer
+ * can still be cached.
+ */
+typedef struct pending_lookup {
+    struct pending_lookup *next;
+    unsigned id;
+    unsigned32 addr;
+    name_lookup_callback callback;
+    void *data;
+} pending_lookup;
+
+static pending_lookup *pending_lookups = 0;
+
+/* A direct-mapped cache of address-to-name answers, positive and negative
+ * (a null NAME), keyed on the address in network byte order.
+ */
+#define NAME_CACHE_SIZE	256
+
+static struct name_cache_entry {
+    unsigned32 addr;
+    time_t expires;
+    char *name;
+} name_cache[NAME_CACHE_SIZE];
+
+static struct name_cache_entry *
+name_cache_entry(unsigned32 addr)
 {
-    return spawn_pipe(intermediary, &to_intermediary, &from_intermediary);
+    unsigned32 a = ntohl(addr);
+
+    return &name_cache[(a ^ (a >> 8) ^ (a >> 16)) % NAME_CACHE_SIZE];
+}
+
+static void
+cache_name(unsigned32 addr, const char *name)
+{
+    struct name_cache_entry *e = name_cache_entry(addr);
+    int ttl = (*name ? server_int_option("name_lookup_cache_ttl", 3600)
+	       : server_int_option("name_lookup_negative_cache_ttl", 300));
+
+    if (e->name)
+	free_str(e->name);
+    e->addr = addr;
+    e->expires = ttl > 0 ? time(0) + ttl : 0;
+    e->name = *name ? str_dup(name) : 0;
+}
+
+static const char *
+dotted_decimal(struct sockaddr_in *addr)
+{
+    static char decimal[20];
+    unsigned32 a = ntohl(addr->sin_addr.s_addr);
+
+    sprintf(decimal, "%u.%u.%u.%u",
+	    (unsigned) (a >> 24) & 0xff, (unsigned) (a >> 16) & 0xff,
+	    (unsigned) (a >> 8) & 0xff, (unsigned) a & 0xff);
+    return decimal;
+}
+
+const char *
+lookup_cached_name_from_addr(struct sockaddr_in *addr)
+{
+    struct name_cache_entry *e = name_cache_entry(addr->sin_addr.s_addr);
+
+    if (e->expires && e->addr == addr->sin_addr.s_addr
+	&& e->expires > time(0))
+	return e->name ? e->name : dotted_decimal(addr);
+    return 0;
 }
 
 static void
 abandon_intermediary(const char *prefix)
 {
+    pending_lookup *p;
+
     errlog("LOOKUP_NAME: %s; presumed dead...\n", prefix);
     dead_intermediary = 1;
+    network_unregister_fd(from_intermediary);
     close(to_intermediary);
     close(from_intermediary);
+
+    /* The connections waiting on these keep the names they have. */
+    while ((p = pending_lookups)) {
+	pending_lookups = p->next;
+	myfree(p, M_STRUCT);
+    }
+}
+
+/* Handles a reply to a background lookup.  Returns false if it isn't
+ * one.
+ */
+static int
+finish_pending_lookup(struct reply *r, char *buffer)
+{
+    pending_lookup *p, **pp;
+
+    for (pp = &pending_lookups; (p = *pp); pp = &p->next)
+	if (p->id == r->id) {
+	    struct sockaddr_in addr;
+
+	    *pp = p->next;
+	    buffer[r->length] = '\0';
+	    cache_name(p->addr, buffer);
+	    if (p->callback) {
+		addr.sin_addr.s_addr = p->addr;
+		(*p->callback) (p->data,
+				r->length ? buffer : dotted_decimal(&addr));
+	    }
+	    myfree(p, M_STRUCT);
+	    return 1;
+	}
+
+    return 0;
+}
+
+static int
+send_request(struct request *req, const char *name)
+{
+    req->id = next_request_id++;
+    if (write(to_intermediary, req, sizeof(*req)) != sizeof(*req)
+	|| (name && write(to_intermediary, name, req->u.length)
+	    != (int) req->u.length)) {
+	abandon_intermediary("Write to intermediary failed");
+	return 0;
+    }
+    return 1;
+}
+
+/* Waits for the reply to REQ, handling any others that come in first.
+ * BUFFER must hold MAX_REPLY_DATA + 1 bytes.
+ */
+static int
+await_reply(struct request *req, struct reply *r, char *buffer)
+{
+    for (;;) {
+	if (!read_reply(from_intermediary, r, buffer)) {
+	    abandon_intermediary("Read from intermediary failed");
+	    return 0;
+	}
+	if (r->id == req->id)
+	    return 1;
+	if (!finish_pending_lookup(r, buffer))
+	    errlog("LOOKUP_NAME: Unexpected reply from intermediary\n");
+    }
+}
+
+static void
+intermediary_readable(int fd, void *data)
+{
+    struct reply r;
+    char buffer[MAX_REPLY_DATA + 1];
+
+    if (!read_reply(from_intermediary, &r, buffer))
+	abandon_intermediary("Read from intermediary failed");
+    else if (!finish_pending_lookup(&r, buffer))
+	errlog("LOOKUP_NAME: Unexpected reply from intermediary\n");
+}
+
+int
+initialize_name_lookup(void)
+{
+    if (!spawn_pipe(intermediary, &to_intermediary, &from_intermediary))
+	return 0;
+    network_register_fd(from_intermediary, intermediary_readable, 0, 0);
+    return 1;
 }
 
 const char *
 lookup_name_from_addr(struct sockaddr_in *addr, unsigned timeout)
 {
     struct request req;
-    static char *buffer = 0;
-    static int buflen = 0;
-    int len;
+    struct reply r;
+    static char buffer[MAX_REPLY_DATA + 1];
+    const char *name;
+
+    if ((name = lookup_cached_name_from_addr(addr)))
+	return name;
 
     if (!dead_intermediary) {
 	req.kind = request::REQ_NAME_FROM_ADDR;
 	req.timeout = timeout;
 	req.u.address = *addr;
-	if (write(to_intermediary, &req, sizeof(req)) != sizeof(req))
-	    abandon_intermediary("LOOKUP_NAME: Write to intermediary failed");
-	else if (robust_read(from_intermediary, &len, sizeof(len))
-		 != sizeof(len))
-	    abandon_intermediary("LOOKUP_NAME: Read from intermediary failed");
-	else if (len != 0) {
-	    ensure_buffer(&buffer, &buflen, len + 1);
-	    if (robust_read(from_intermediary, buffer, len) != len)
-		abandon_intermediary("LOOKUP_NAME: "
-				   "Data-read from intermediary failed");
-	    else {
-		buffer[len] = '\0';
+	if (send_request(&req, 0) && await_reply(&req, &r, buffer)) {
+	    buffer[r.length] = '\0';
+	    cache_name(addr->sin_addr.s_addr, buffer);
+	    if (r.length != 0)
 		return buffer;
-	    }
 	}
     }
     /* Either the intermediary is presumed dead, or else it failed to produce
      * a name; in either case, we must fall back on a the default, dotted-
      * decimal notation.
      */
+    return dotted_decimal(addr);
+}
 
-    {
-	static char decimal[20];
-	unsigned32 a = ntohl(addr->sin_addr.s_addr);
+unsigned
+lookup_name_from_addr_async(struct sockaddr_in *addr, unsigned timeout,
+			    name_lookup_callback callback, void *data)
+{
+    struct request req;
+    pending_lookup *p;
+
+    if (dead_intermediary)
+	return 0;
+
+    req.kind = request::REQ_NAME_FROM_ADDR;
+    req.timeout = timeout;
+    req.u.address = *addr;
+    if (!send_request(&req, 0))
+	return 0;
+
+    p = (pending_lookup *) mymalloc(sizeof(pending_lookup), M_STRUCT);
+    p->id = req.id;
+    p->addr = addr->sin_addr.s_addr;
+    p->callback = callback;
+    p->data = data;
+    p->next = pending_lookups;
+    pending_lookups = p;
+
+    return req.id;
+}
 
-	sprintf(decimal, "%u.%u.%u.%u",
-		(unsigned) (a >> 24) & 0xff, (unsigned) (a >> 16) & 0xff,
-		(unsigned) (a >> 8) & 0xff, (unsigned) a & 0xff);
-	return decimal;
-    }
+void
+cancel_name_lookup(unsigned id)
+{
+    pending_lookup *p;
+
+    for (p = pending_lookups; p; p = p->next)
+	if (p->id == id)
+	    p->callback = 0;
 }
 
 unsigned32
 lookup_addr_from_name(const char *name, unsigned timeout)
 {
     struct request req;
+    struct reply r;
+    char buffer[MAX_REPLY_DATA + 1];
     unsigned32 addr = 0;
 
     if (dead_intermediary) {
@@ -363,12 +668,9 @@ lookup_addr_from_name(const char *name, unsigned timeout)
 	req.kind = request::REQ_ADDR_FROM_NAME;
 	req.timeout = timeout;
 	req.u.length = strlen(name);
-	if (write(to_intermediary, &req, sizeof(req)) != sizeof(req)
-	    || write(to_intermediary, name, req.u.length) != req.u.length)
-	    abandon_intermediary("LOOKUP_ADDR: Write to intermediary failed");
-	else if (robust_read(from_intermediary, &addr, sizeof(addr))
-		 != sizeof(addr))
-	    abandon_intermediary("LOOKUP_ADDR: Read from intermediary failed");
+	if (send_request(&req, name) && await_reply(&req, &r, buffer)
+	    && r.length == sizeof(addr))
+	    memcpy(&addr, buffer, sizeof(addr));
     }
 
     return addr == 0xffffffff ? 0 : addr;
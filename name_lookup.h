@@ -48,4 +48,31 @@ extern const char *lookup_name_from_addr(struct sockaddr_in *addr,
 				 * form.
 				 */
 
+extern const char *lookup_cached_name_from_addr(struct sockaddr_in *addr);
+				/* Like lookup_name_from_addr(), but only
+				 * consults the cache of recent answers;
+				 * returns null if the address isn't in it.
+				 */
+
+typedef void (*name_lookup_callback) (void *data, const char *name);
+
+extern unsigned lookup_name_from_addr_async(struct sockaddr_in *addr,
+					    unsigned timeout,
+					    name_lookup_callback callback,
+					    void *data);
+				/* Start translating an internet address to a
+				 * host name in the background and return an
+				 * id for the request, or 0 if lookups can't
+				 * be done.  When the answer arrives (during
+				 * network I/O processing), CALLBACK is called
+				 * with DATA and the name, or the address in
+				 * dotted decimal form if the translation
+				 * failed.
+				 */
+
+extern void cancel_name_lookup(unsigned id);
+				/* Don't call the callback for the given
+				 * background lookup after all.
+				 */
+
 #endif				/* Name_Lookup_H */
@@ -15,19 +15,17 @@
     Pavel@Xerox.Com
  *****************************************************************************/
 
-#include <stdexcept>
-
 /* Multi-user networking protocol implementation for TCP/IP on BSD UNIX */
 
-#include "my-inet.h"		/* inet_addr() */
+#include "my-inet.h"		/* inet_addr(), inet_ntoa() */
 #include <errno.h>		/* EMFILE, EADDRNOTAVAIL, ECONNREFUSED,
-				   * ENETUNREACH, ETIMEOUT */
+				   * ENETUNREACH, ETIMEOUT, EINPROGRESS */
 #include "my-in.h"		/* struct sockaddr_in, INADDR_ANY, htons(),
 				   * htonl(), ntohl(), struct in_addr */
 #include "my-socket.h"		/* socket(), AF_INET, SOCK_STREAM,
 				   * setsockopt(), SOL_SOCKET, SO_REUSEADDR,
 				   * bind(), struct sockaddr, accept(),
-				   * connect() */
+				   * connect(), getsockopt(), SO_ERROR */
 #include "my-stdlib.h"		/* strtoul() */
 #include "my-string.h"		/* memcpy() */
 #include "my-unistd.h"		/* close() */
@@ -36,11 +34,11 @@
 #include "list.h"
 #include "log.h"
 #include "name_lookup.h"
+#include "net_multi.h"
 #include "net_proto.h"
 #include "options.h"
 #include "server.h"
 #include "streams.h"
-#include "timers.h"
 #include "utils.h"
 
 #include "net_tcp.cc"
@@ -120,7 +118,7 @@ proto_make_listener(Var desc, int *fd, Var * canon, const char **name)
     } else
 	*canon = var_ref(desc);
 
-    stream_printf(st, "port %d", canon->v.num);
+    stream_printf(st, "port %" PRIdN, canon->v.num);
     *name = reset_stream(st);
 
     *fd = s;
@@ -134,6 +132,41 @@ proto_listen(int fd)
     return 1;
 }
 
+/* Incoming connections whose names are still being looked up. */
+typedef struct pending_name {
+    struct pending_name *next;
+    int fd;
+    int port;
+    unsigned id;
+} pending_name;
+
+static pending_name *pending_names = 0;
+
+static void
+forget_pending_name(pending_name *p)
+{
+    pending_name **pp;
+
+    for (pp = &pending_names; *pp != p; pp = &(*pp)->next)
+	;
+    *pp = p->next;
+    myfree(p, M_NETWORK);
+}
+
+static void
+name_found(void *data, const char *host_name)
+{
+    pending_name *p = (pending_name *) data;
+    static Stream *s = 0;
+
+    if (!s)
+	s = new_stream(100);
+
+    stream_printf(s, "%s, port %d", host_name, p->port);
+    network_set_connection_remote_name(p->fd, reset_stream(s));
+    forget_pending_name(p);
+}
+
 enum proto_accept_error
 proto_accept_connection(int listener_fd, int *read_fd, int *write_fd,
 			const char **name)
@@ -142,6 +175,7 @@ proto_accept_connection(int listener_fd, int *read_fd, int *write_fd,
     int fd;
     struct sockaddr_in address;
     socklen_t addr_length = sizeof(address);
+    const char *host_name;
     static Stream *s = 0;
 
     if (!s)
@@ -157,9 +191,25 @@ proto_accept_connection(int listener_fd, int *read_fd, int *write_fd,
 	}
     }
     *read_fd = *write_fd = fd;
-    stream_printf(s, "%s, port %d",
-		  lookup_name_from_addr(&address, timeout),
-		  (int) ntohs(address.sin_port));
+
+    /* Unless the name is already known, accept the connection under its
+     * numeric address and rename it when the lookup finishes.
+     */
+    if (!(host_name = lookup_cached_name_from_addr(&address))) {
+	pending_name *p = (pending_name *) mymalloc(sizeof(pending_name),
+						    M_NETWORK);
+
+	p->fd = fd;
+	p->port = (int) ntohs(address.sin_port);
+	p->id = lookup_name_from_addr_async(&address, timeout, name_found, p);
+	if (p->id) {
+	    p->next = pending_names;
+	    pending_names = p;
+	} else
+	    myfree(p, M_NETWORK);
+	host_name = inet_ntoa(address.sin_addr);
+    }
+    stream_printf(s, "%s, port %d", host_name, (int) ntohs(address.sin_port));
     *name = reset_stream(s);
     return PA_OKAY;
 }
@@ -167,6 +217,15 @@ proto_accept_connection(int listener_fd, int *read_fd, int *write_fd,
 void
 proto_close_connection(int read_fd, int write_fd)
 {
+    pending_name *p;
+
+    for (p = pending_names; p; p = p->next)
+	if (p->fd == read_fd) {
+	    cancel_name_lookup(p->id);
+	    forget_pending_name(p);
+	    break;
+	}
+
     /* read_fd and write_fd are the same, so we only need to deal with one. */
     close(read_fd);
 }
@@ -181,48 +240,38 @@ proto_close_listener(int fd)
 
 #include "structures.h"
 
-class timeout_exception: public std::exception
-{
-public:
-    timeout_exception() throw() {}
-
-    virtual ~timeout_exception() throw() {}
-
-    virtual const char* what() const throw() {
-	return "timeout";
-    }
-};
-
-static void
-timeout_proc(Timer_ID id, Timer_Data data)
+static enum error
+connect_failed(int s, const char *msg)
 {
-    throw timeout_exception();
+    int err = errno;
+
+    close(s);
+    errno = err;
+    if (errno == EADDRNOTAVAIL ||
+	errno == ECONNREFUSED ||
+	errno == ENETUNREACH ||
+	errno == ETIMEDOUT)
+	return E_INVARG;
+    log_perror(msg);
+    return E_QUOTA;
 }
 
 enum error
 proto_open_connection(Var arglist, int *read_fd, int *write_fd,
 		      const char **local_name, const char **remote_name)
 {
-    /* These are `static' rather than `volatile' because I can't cope with
-     * getting all those nasty little parameter-passing rules right.  This
-     * function isn't recursive anyway, so it doesn't matter.
-     */
-    static const char *host_name;
-    static int port;
-    static Timer_ID id;
-    socklen_t length;
-    int s, result;
+    const char *host_name;
+    int port;
+    int s;
     int timeout = server_int_option("name_lookup_timeout", 5);
-    static struct sockaddr_in addr;
-    static Stream *st1 = 0, *st2 = 0;
+    struct sockaddr_in addr;
+    static Stream *st = 0;
 
     if (!outbound_network_enabled)
 	return E_PERM;
 
-    if (!st1) {
-	st1 = new_stream(20);
-	st2 = new_stream(50);
-    }
+    if (!st)
+	st = new_stream(50);
     if (arglist.v.list[0].v.num != 2)
 	return E_ARGS;
     else if (arglist.v.list[1].type != TYPE_STR ||
@@ -263,41 +312,57 @@ proto_open_connection(Var arglist, int *read_fd, int *write_fd,
 	    return e;
 	}
     }	 
-    try {
-	id = set_timer(server_int_option("outbound_connect_timeout", 5),
-		       timeout_proc, 0);
-	result = connect(s, (struct sockaddr *) &addr, sizeof(addr));
-	cancel_timer(id);
-    }
-    catch (timeout_exception& exception) {
-	result = -1;
-	errno = ETIMEDOUT;
-	reenable_timers();
-    }
 
-    if (result < 0) {
+    /* The connect() is only started here; the socket becomes writable
+     * once it has either succeeded or failed, and the multiplexer
+     * calls proto_finish_connection() to find out which.
+     */
+    if (!network_set_nonblocking(s)) {
+	log_perror("Setting socket non-blocking in proto_open_connection");
 	close(s);
-	if (errno == EADDRNOTAVAIL ||
-	    errno == ECONNREFUSED ||
-	    errno == ENETUNREACH ||
-	    errno == ETIMEDOUT)
-	    return E_INVARG;
-	log_perror("Connecting in proto_open_connection");
 	return E_QUOTA;
     }
+    if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	&& errno != EINPROGRESS)
+	return connect_failed(s, "Connecting in proto_open_connection");
+
+    *read_fd = *write_fd = s;
+
+    *local_name = 0;
+
+    stream_printf(st, "%s, port %d", host_name, port);
+    *remote_name = reset_stream(st);
+
+    return E_NONE;
+}
+
+enum error
+proto_finish_connection(int read_fd, int write_fd, const char **local_name)
+{
+    struct sockaddr_in addr;
+    socklen_t length;
+    int error;
+    static Stream *st = 0;
+
+    if (!st)
+	st = new_stream(20);
+
+    length = sizeof(error);
+    if (getsockopt(write_fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+	error = errno;
+    if (error) {
+	errno = error;
+	return connect_failed(write_fd, "Connecting in proto_finish_connection");
+    }
     length = sizeof(addr);
-    if (getsockname(s, (struct sockaddr *) &addr, &length) < 0) {
-	close(s);
-	log_perror("Getting local name in proto_open_connection");
+    if (getsockname(write_fd, (struct sockaddr *) &addr, &length) < 0) {
+	close(write_fd);
+	log_perror("Getting local name in proto_finish_connection");
 	return E_QUOTA;
     }
-    *read_fd = *write_fd = s;
-
-    stream_printf(st1, "port %d", (int) ntohs(addr.sin_port));
-    *local_name = reset_stream(st1);
 
-    stream_printf(st2, "%s, port %d", host_name, port);
-    *remote_name = reset_stream(st2);
+    stream_printf(st, "port %d", (int) ntohs(addr.sin_port));
+    *local_name = reset_stream(st);
 
     return E_NONE;
 }
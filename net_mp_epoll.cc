@@ -0,0 +1,305 @@
+/******************************************************************************
+  Copyright 2010 Todd Sundsted. All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice,
+       this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in the
+       documentation and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY TODD SUNDSTED ``AS IS'' AND ANY EXPRESS OR
+  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+  EVENT SHALL TODD SUNDSTED OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+  OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+  The views and conclusions contained in the software and documentation are
+  those of the authors and should not be interpreted as representing official
+  policies, either expressed or implied, of Todd Sundsted.
+ *****************************************************************************/
+
+/* Multiplexing wait implementation using the Linux epoll facility.
+ *
+ * Descriptors stay registered with the kernel from one wait to the next.
+ * A descriptor only goes on the list of changes to pass on to the kernel
+ * when the wait set built up between mplex_clear() and mplex_wait() asks
+ * for more than is registered (a new connection, input being resumed,
+ * output being queued, ...).  Registrations that ask for more than is
+ * wanted are narrowed lazily, when the kernel reports an event nobody is
+ * waiting for.  So a wait only looks at the descriptors on the change
+ * list and at the events the kernel returns, never at every descriptor.
+ * Registrations are level-triggered, since the network code doesn't
+ * necessarily drain a descriptor each time it becomes ready.
+ *
+ * A descriptor closed without mplex_forget() silently drops out of the
+ * kernel's set, and if its number is reused for another descriptor in
+ * the same wait set, the two can't be told apart here.  To recover from
+ * that, a wait that times out checks every registration with the kernel,
+ * at most once every REVALIDATE_MSECS.
+ */
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include "my-string.h"
+#include "my-unistd.h"
+
+#include "log.h"
+#include "net_mplex.h"
+#include "storage.h"
+#include "timers.h"
+
+#define MP_READ		1
+#define MP_WRITE	2
+
+#define REVALIDATE_MSECS	5000
+
+static int epfd = -1;
+
+static unsigned char *wanted = 0;	/* the current wait set */
+static unsigned *wanted_in = 0;		/* ... valid if equal to `cycle' */
+static unsigned char *registered = 0;	/* as the kernel knows it */
+static unsigned char *ready = 0;	/* result of the last wait */
+static int num_fds = 0;			/* size of the four arrays */
+static int max_fd = -1;			/* highest fd ever added */
+static int num_registered = 0;
+
+static unsigned cycle = 1;		/* bumped by mplex_clear() */
+
+static int *changes = 0;		/* fds wanting more than registered */
+static int num_changes = 0, max_changes = 0;
+
+static struct epoll_event *events = 0;
+static int num_events = 0;		/* returned by the last wait */
+static int max_events = 0;
+
+static int64_t last_revalidated = 0;
+
+static void
+grow(int fd)
+{
+    int new_num = (fd + 64) / 64 * 64;
+
+    if (!num_fds) {
+	wanted = (unsigned char *)mymalloc(new_num, M_NETWORK);
+	wanted_in = (unsigned *)mymalloc(new_num * sizeof(unsigned),
+					 M_NETWORK);
+	registered = (unsigned char *)mymalloc(new_num, M_NETWORK);
+	ready = (unsigned char *)mymalloc(new_num, M_NETWORK);
+    } else {
+	wanted = (unsigned char *)myrealloc(wanted, new_num, M_NETWORK);
+	wanted_in = (unsigned *)myrealloc(wanted_in,
+					  new_num * sizeof(unsigned),
+					  M_NETWORK);
+	registered = (unsigned char *)myrealloc(registered, new_num,
+						M_NETWORK);
+	ready = (unsigned char *)myrealloc(ready, new_num, M_NETWORK);
+    }
+    memset(wanted + num_fds, 0, new_num - num_fds);
+    memset(wanted_in + num_fds, 0, (new_num - num_fds) * sizeof(unsigned));
+    memset(registered + num_fds, 0, new_num - num_fds);
+    memset(ready + num_fds, 0, new_num - num_fds);
+    num_fds = new_num;
+}
+
+static unsigned
+wanted_now(int fd)
+{
+    return wanted_in[fd] == cycle ? wanted[fd] : 0;
+}
+
+void
+mplex_clear(void)
+{
+    if (++cycle == 0) {
+	if (num_fds)
+	    memset(wanted_in, 0, num_fds * sizeof(unsigned));
+	cycle = 1;
+    }
+}
+
+static void
+add_common(int fd, unsigned dir)
+{
+    unsigned w;
+
+    if (fd >= num_fds)
+	grow(fd);
+    if (fd > max_fd)
+	max_fd = fd;
+
+    w = wanted_now(fd);
+    if ((dir & ~registered[fd]) && !(w & ~registered[fd])) {
+	if (num_changes == max_changes) {
+	    max_changes = max_changes ? max_changes * 2 : 64;
+	    changes = changes
+		? (int *)myrealloc(changes, max_changes * sizeof(int),
+				   M_NETWORK)
+		: (int *)mymalloc(max_changes * sizeof(int), M_NETWORK);
+	}
+	changes[num_changes++] = fd;
+    }
+    wanted[fd] = w | dir;
+    wanted_in[fd] = cycle;
+}
+
+void
+mplex_add_reader(int fd)
+{
+    add_common(fd, MP_READ);
+}
+
+void
+mplex_add_writer(int fd)
+{
+    add_common(fd, MP_WRITE);
+}
+
+void
+mplex_forget(int fd)
+{
+    if (fd < num_fds && registered[fd]) {
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, 0);
+	num_registered--;
+    }
+    if (fd < num_fds) {
+	wanted[fd] = registered[fd] = ready[fd] = 0;
+	wanted_in[fd] = 0;
+    }
+}
+
+/* Tells the kernel to watch FD for WANT, which may be nothing. */
+static void
+set_registration(int fd, unsigned want)
+{
+    struct epoll_event ev;
+    int op;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = fd;
+    if (want & MP_READ)
+	ev.events |= EPOLLIN;
+    if (want & MP_WRITE)
+	ev.events |= EPOLLOUT;
+
+    if (!want)
+	op = EPOLL_CTL_DEL;
+    else if (!registered[fd])
+	op = EPOLL_CTL_ADD;
+    else
+	op = EPOLL_CTL_MOD;
+
+    if (epoll_ctl(epfd, op, fd, &ev) < 0 && op != EPOLL_CTL_DEL) {
+	/* The descriptor may have been closed and reopened behind our
+	 * back, which silently removes it from the epoll set.
+	 */
+	if (errno == ENOENT || errno == EEXIST) {
+	    op = (op == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+	    if (epoll_ctl(epfd, op, fd, &ev) < 0)
+		log_perror("Registering for network I/O");
+	} else if (errno == EBADF)	/* ... or closed for good */
+	    want = 0;
+	else
+	    log_perror("Registering for network I/O");
+    }
+
+    if (want && !registered[fd])
+	num_registered++;
+    else if (!want && registered[fd])
+	num_registered--;
+    registered[fd] = want;
+}
+
+static void
+revalidate_registrations(void)
+{
+    int fd;
+
+    for (fd = 0; fd <= max_fd; fd++)
+	if (registered[fd])
+	    set_registration(fd, registered[fd]);
+}
+
+int
+mplex_wait(unsigned timeout)
+{
+    int fd, i, n, any = 0;
+
+    if (epfd < 0 && (epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+	log_perror("Creating epoll descriptor");
+	return 1;
+    }
+
+    for (i = 0; i < num_events; i++)
+	ready[events[i].data.fd] = 0;
+    num_events = 0;
+
+    for (i = 0; i < num_changes; i++) {
+	fd = changes[i];
+	if (wanted_now(fd) & ~registered[fd])
+	    set_registration(fd, wanted_now(fd));
+    }
+    num_changes = 0;
+
+    if (!events || num_registered > max_events) {
+	max_events = num_registered + 64;
+	if (events)
+	    myfree(events, M_NETWORK);
+	events = (struct epoll_event *)
+	    mymalloc(max_events * sizeof(struct epoll_event), M_NETWORK);
+    }
+
+    n = epoll_wait(epfd, events, max_events, timeout);
+
+    if (n < 0) {
+	if (errno != EINTR)
+	    log_perror("Waiting for network I/O");
+	return 1;
+    }
+    num_events = n;
+    for (i = 0; i < n; i++) {
+	unsigned e = events[i].events, got = 0, want;
+
+	fd = events[i].data.fd;
+	want = wanted_now(fd);
+	if (e & (EPOLLIN | EPOLLHUP | EPOLLERR))
+	    got |= MP_READ;
+	if (e & (EPOLLOUT | EPOLLERR))
+	    got |= MP_WRITE;
+	if ((got & ~want) && registered[fd] != want)
+	    set_registration(fd, want);
+	if ((ready[fd] = got & want) != 0)
+	    any = 1;
+    }
+
+    if (n == 0) {
+	int64_t now = monotonic_msecs();
+
+	if (now - last_revalidated >= REVALIDATE_MSECS) {
+	    revalidate_registrations();
+	    last_revalidated = now;
+	}
+    }
+
+    return !any;
+}
+
+int
+mplex_is_readable(int fd)
+{
+    return fd < num_fds && (ready[fd] & MP_READ) != 0;
+}
+
+int
+mplex_is_writable(int fd)
+{
+    return fd < num_fds && (ready[fd] & MP_WRITE) != 0;
+}
@@ -19,7 +19,7 @@
 
 #include "my-types.h"
 #include "my-stat.h"
-#include "my-unistd.h"		/* sleep() */
+#include "my-unistd.h"		/* usleep() */
 
 #include "net_mplex.h"
 #include "options.h"
@@ -139,8 +139,13 @@ mplex_wait(unsigned timeout)
 
 	if (got_one)
 	    break;
-	else if (timeout-- > 0)
-	    sleep(1);
+	else if (timeout > 0) {
+	    unsigned nap = timeout < 1000 ? timeout : 1000;
+
+	    usleep(nap * 1000);
+	    timeout -= nap;
+	} else
+	    break;
     }
 
     return !got_one;
@@ -157,3 +162,8 @@ mplex_is_writable(int fd)
 {
     return (fd < rw_size) ? writable[fd] : 0;
 }
+
+void
+mplex_forget(int fd)
+{
+}
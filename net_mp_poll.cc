@@ -80,7 +80,7 @@ mplex_add_writer(int fd)
 int
 mplex_wait(unsigned timeout)
 {
-    int result = poll(ports, max_fd + 1, timeout * 1000);
+    int result = poll(ports, max_fd + 1, timeout);
 
     if (result < 0) {
 	if (errno != EINTR)
@@ -101,3 +101,8 @@ mplex_is_writable(int fd)
 {
     return fd <= max_fd && (ports[fd].revents & POLLOUT) != 0;
 }
+
+void
+mplex_forget(int fd)
+{
+}
@@ -28,3 +28,7 @@
 #  if MPLEX_STYLE == MP_FAKE
 #    include "net_mp_fake.cc"
 #  endif
+
+#  if MPLEX_STYLE == MP_EPOLL
+#    include "net_mp_epoll.cc"
+#  endif
@@ -51,8 +51,8 @@ extern void mplex_add_writer(int fd);
 extern int mplex_wait(unsigned timeout);
 				/* Wait until it is possible either to do the
 				 * appropriate kind of I/O on some descriptor
-				 * in the wait set or until `timeout' seconds
-				 * have elapsed.  Return true iff the timeout
+				 * in the wait set or until `timeout'
+				 * milliseconds have elapsed.  Return true iff the timeout
 				 * expired without any I/O becoming possible.
 				 */
 
@@ -68,4 +68,11 @@ extern int mplex_is_writable(int fd);
 				 * had become possible on the given descriptor.
 				 */
 
+extern void mplex_forget(int fd);
+				/* Must be called before closing a descriptor
+				 * that may have been in a wait set, for the
+				 * benefit of implementations that keep track
+				 * of descriptors from one wait to the next.
+				 */
+
 #endif				/* !Net_MPlex_H */
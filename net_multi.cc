@@ -23,7 +23,10 @@
 #include "my-stdio.h"
 #include "my-stdlib.h"
 #include "my-string.h"
+#include "my-time.h"
 #include "my-unistd.h"
+#include <stdint.h>
+#include <sys/uio.h>
 
 #include "config.h"
 #include "list.h"
@@ -58,18 +61,33 @@ static int ewouldblock = -1;
 static int *pocket_descriptors = 0;	/* fds we keep around in case we need
 					 * one and no others are left... */
 
+/* A block of pending output is either a private copy of the bytes,
+ * allocated along with the block, or a reference to a (shared, immutable)
+ * MOO string followed by an end-of-line, so that a line sent to many
+ * connections isn't copied for each of them.
+ */
 typedef struct text_block {
     struct text_block *next;
-    int length;
-    char *buffer;
-    char *start;
+    int length;			/* bytes left to write, including EOL */
+    const char *str;		/* referenced MOO string, or null */
+    const char *start;		/* next byte of text to write */
+    int text_left;		/* ... and how many there are */
+    int eol_left;		/* bytes of EOL left after the text */
 } text_block;
 
+/* The most pieces of output handed to a single writev() */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#  define MAX_IOVECS	IOV_MAX
+#else
+#  define MAX_IOVECS	64
+#endif
+
 typedef struct nhandle {
     struct nhandle *next, **prev;
     server_handle shandle;
     int rfd, wfd;
     char *name;
+    char *local_name;
     Stream *input;
     int last_input_was_CR;
     int input_suspended;
@@ -77,6 +95,8 @@ typedef struct nhandle {
     text_block **output_tail;
     int output_length;
     int output_lines_flushed;
+    unsigned output_writes;	/* number of write()/writev() calls */
+    unsigned output_bytes;	/* ... and bytes they wrote */
     int outbound, binary;
 #if NETWORK_PROTOCOL == NP_TCP
     int client_echo;
@@ -94,6 +114,28 @@ typedef struct nlistener {
 
 static nlistener *all_nlisteners = 0;
 
+#ifdef OUTBOUND_NETWORK
+
+/* An outbound connection that's still being made.  LOCAL_NAME is zero
+ * until the protocol has reported the connection complete.
+ */
+typedef struct npending {
+    struct npending *next, **prev;
+    server_listener slistener;
+    int rfd, wfd;
+    const char *local_name;
+    const char *remote_name;
+    int64_t deadline;		/* in monotonic_msecs() */
+    network_open_callback callback;
+    void *data;
+} npending;
+
+static npending *all_npendings = 0;
+
+static void check_pending_connections(int ready);
+
+#endif
+
 
 typedef struct {
     int fd;
@@ -150,6 +192,7 @@ network_unregister_fd(int fd)
     for (i = 0; i < max_reg_fds; i++)
 	if (reg_fds[i].fd == fd)
 	    reg_fds[i].fd = -1;
+    mplex_forget(fd);
 }
 
 static void
@@ -184,7 +227,8 @@ check_registered_fds(void)
 static void
 free_text_block(text_block * b)
 {
-    myfree(b->buffer, M_NETWORK);
+    if (b->str)
+	free_str(b->str);
     myfree(b, M_NETWORK);
 }
 
@@ -231,22 +275,59 @@ push_output(nhandle * h)
 		proto.eol_out_string);
 	length = strlen(buf);
 	count = write(h->wfd, buf, length);
+	h->output_writes++;
+	if (count > 0)
+	    h->output_bytes += count;
 	if (count == length)
 	    h->output_lines_flushed = 0;
 	else
 	    return count >= 0 || errno == eagain || errno == ewouldblock;
     }
-    while ((b = h->output_head) != 0) {
-	count = write(h->wfd, b->start, b->length);
+    while (h->output_head != 0) {
+	struct iovec iov[MAX_IOVECS];
+	int n = 0, wanted = 0, blocks = 0;
+
+	/* Gather as much of the queue as we can into one writev() */
+	for (b = h->output_head; b && n < MAX_IOVECS - 1; b = b->next) {
+	    if (b->text_left > 0) {
+		iov[n].iov_base = (void *) b->start;
+		iov[n++].iov_len = b->text_left;
+	    }
+	    if (b->eol_left > 0) {
+		iov[n].iov_base = (void *) (proto.eol_out_string
+					    + eol_length - b->eol_left);
+		iov[n++].iov_len = b->eol_left;
+	    }
+	    wanted += b->length;
+	    blocks++;
+	}
+	count = writev(h->wfd, iov, n);
+	h->output_writes++;
 	if (count < 0)
 	    return (errno == eagain || errno == ewouldblock);
+	h->output_bytes += count;
 	h->output_length -= count;
-	if (count == b->length) {
+
+	if (count < wanted) {	/* the socket is full */
+	    while ((b = h->output_head) && count >= b->length) {
+		count -= b->length;
+		h->output_head = b->next;
+		free_text_block(b);
+	    }
+	    if (count > 0) {
+		int text = count < b->text_left ? count : b->text_left;
+
+		b->start += text;
+		b->text_left -= text;
+		b->eol_left -= count - text;
+		b->length -= count;
+	    }
+	    break;
+	}
+	while (blocks-- > 0) {
+	    b = h->output_head;
 	    h->output_head = b->next;
 	    free_text_block(b);
-	} else {
-	    b->start += count;
-	    b->length -= count;
 	}
     }
     if (h->output_head == 0)
@@ -254,13 +335,68 @@ push_output(nhandle * h)
     return 1;
 }
 
+/* What non-binary input does with each byte: printable characters are
+ * kept, line terminators end a line, backspaces delete, and anything
+ * else is dropped.
+ */
+enum input_class {
+    IC_TEXT, IC_CR, IC_LF, IC_DELETE, IC_IGNORE
+};
+
+static unsigned char input_class[256];
+
+static void
+init_input_class(void)
+{
+    int c;
+
+    for (c = 0; c < 256; c++)
+	if (isgraph(c) || c == ' ' || c == '\t')
+	    input_class[c] = IC_TEXT;
+#ifdef INPUT_APPLY_BACKSPACE
+	else if (c == 0x08 || c == 0x7F)
+	    input_class[c] = IC_DELETE;
+#endif
+	else if (c == '\r')
+	    input_class[c] = IC_CR;
+	else if (c == '\n')
+	    input_class[c] = IC_LF;
+	else
+	    input_class[c] = IC_IGNORE;
+}
+
+/* Returns the first byte in [PTR, END) that's outside of printable
+ * ASCII (' ' through '~'), looking at eight bytes at a time.
+ */
+static inline const char *
+skip_printable_ascii(const char *ptr, const char *end)
+{
+    const uint64_t ones = 0x0101010101010101ULL, highs = ones * 0x80;
+
+    while (end - ptr >= 8) {
+	uint64_t w;
+
+	memcpy(&w, ptr, 8);
+	/* Sets the high bit of a byte that's < 0x20, >= 0x80 or == 0x7F
+	 * (and, harmlessly, of some bytes after one of those).
+	 */
+	if (((w - ones * 0x20) | w | ((w ^ ones * 0x7F) - ones)) & highs)
+	    break;
+	ptr += 8;
+    }
+    while (ptr < end && (unsigned char) *ptr >= ' '
+	   && (unsigned char) *ptr < 0x7F)
+	ptr++;
+    return ptr;
+}
+
 static int
 pull_input(nhandle * h)
 {
     Stream *s = h->input;
     int count;
-    char buffer[1024];
-    char *ptr, *end;
+    char buffer[16384];
+    const char *ptr, *run, *end;
 
     if ((count = read(h->rfd, buffer, sizeof(buffer))) > 0) {
 	if (h->binary) {
@@ -268,18 +404,39 @@ pull_input(nhandle * h)
 	    server_receive_line(h->shandle, reset_stream(s));
 	    h->last_input_was_CR = 0;
 	} else {
-	    for (ptr = buffer, end = buffer + count; ptr < end; ptr++) {
-		unsigned char c = *ptr;
-
-		if (isgraph(c) || c == ' ' || c == '\t')
-		    stream_add_char(s, c);
-#ifdef INPUT_APPLY_BACKSPACE
-		else if (c == 0x08 || c == 0x7F)
+	    for (ptr = buffer, end = buffer + count; ptr < end;) {
+		unsigned char c;
+
+		/* Copy whole runs of printable characters at once */
+		run = ptr;
+		for (;;) {
+		    ptr = skip_printable_ascii(ptr, end);
+		    if (ptr < end
+			&& input_class[(unsigned char) *ptr] == IC_TEXT)
+			ptr++;
+		    else
+			break;
+		}
+		if (ptr > run) {
+		    stream_add_bytes(s, run, ptr - run);
+		    h->last_input_was_CR = 0;
+		}
+		if (ptr == end)
+		    break;
+
+		c = *ptr++;
+		switch (input_class[c]) {
+		case IC_DELETE:
 		    stream_delete_char(s);
-#endif
-		else if (c == '\r' || (c == '\n' && !h->last_input_was_CR))
+		    break;
+		case IC_LF:
+		    if (h->last_input_was_CR)
+			break;
+		    /* fall through */
+		case IC_CR:
 		    server_receive_line(h->shandle, reset_stream(s));
-
+		    break;
+		}
 		h->last_input_was_CR = (c == '\r');
 	    }
 	}
@@ -320,6 +477,8 @@ new_nhandle(int rfd, int wfd, const char *local_name, const char *remote_name,
     h->output_tail = &(h->output_head);
     h->output_length = 0;
     h->output_lines_flushed = 0;
+    h->output_writes = 0;
+    h->output_bytes = 0;
     h->outbound = outbound;
     h->binary = 0;
 #if NETWORK_PROTOCOL == NP_TCP
@@ -329,6 +488,7 @@ new_nhandle(int rfd, int wfd, const char *local_name, const char *remote_name,
     stream_printf(s, "%s %s %s",
 		  local_name, outbound ? "to" : "from", remote_name);
     h->name = str_dup(reset_stream(s));
+    h->local_name = str_dup(local_name);
 
     return h;
 }
@@ -349,8 +509,12 @@ close_nhandle(nhandle * h)
 	b = bb;
     }
     free_stream(h->input);
+    mplex_forget(h->rfd);
+    if (h->wfd != h->rfd)
+	mplex_forget(h->wfd);
     proto_close_connection(h->rfd, h->wfd);
     free_str(h->name);
+    free_str(h->local_name);
     myfree(h, M_NETWORK);
 }
 
@@ -360,6 +524,7 @@ close_nlistener(nlistener * l)
     *(l->prev) = l->next;
     if (l->next)
 	l->next->prev = l->prev;
+    mplex_forget(l->fd);
     proto_close_listener(l->fd);
     free_str(l->name);
     myfree(l, M_NETWORK);
@@ -429,8 +594,8 @@ accept_new_connection(nlistener * l)
 
 static int
 enqueue_output(network_handle nh, const char *line, int line_length,
-	       int add_eol, int flush_ok)
-{
+	       int add_eol, int shared, int flush_ok)
+{				/* if SHARED, LINE is a MOO string to refer to */
     nhandle *h = (nhandle *)nh.ptr;
     int length = line_length + (add_eol ? eol_length : 0);
     char *buffer;
@@ -455,12 +620,23 @@ enqueue_output(network_handle nh, const char *line, int line_length,
 	if (h->output_head == 0)
 	    h->output_tail = &(h->output_head);
     }
-    buffer = (char *) mymalloc(length * sizeof(char), M_NETWORK);
-    block = (text_block *) mymalloc(sizeof(text_block), M_NETWORK);
-    memcpy(buffer, line, line_length);
-    if (add_eol)
-	memcpy(buffer + line_length, proto.eol_out_string, eol_length);
-    block->buffer = block->start = buffer;
+    if (shared) {
+	block = (text_block *) mymalloc(sizeof(text_block), M_NETWORK);
+	block->str = block->start = str_ref(line);
+	block->text_left = line_length;
+	block->eol_left = length - line_length;
+    } else {
+	block = (text_block *) mymalloc(sizeof(text_block) + length,
+					M_NETWORK);
+	buffer = (char *) (block + 1);
+	memcpy(buffer, line, line_length);
+	if (add_eol)
+	    memcpy(buffer + line_length, proto.eol_out_string, eol_length);
+	block->str = 0;
+	block->start = buffer;
+	block->text_left = length;
+	block->eol_left = 0;
+    }
     block->length = length;
     block->next = 0;
     *(h->output_tail) = block;
@@ -495,6 +671,7 @@ network_initialize(int argc, char **argv, Var * desc)
 
     eol_length = strlen(proto.eol_out_string);
     get_pocket_descriptors();
+    init_input_class();
 
     /* we don't care about SIGPIPE, we notice it in mplex_wait() and write() */
     signal(SIGPIPE, SIG_IGN);
@@ -535,14 +712,24 @@ network_listen(network_listener nl)
 int
 network_send_line(network_handle nh, const char *line, int flush_ok)
 {
-    return enqueue_output(nh, line, strlen(line), 1, flush_ok);
+    return enqueue_output(nh, line, strlen(line), 1, 0, flush_ok);
+}
+
+int
+network_send_string(network_handle nh, const char *str, int flush_ok)
+{
+    int length = memo_strlen(str);
+
+    if (length == 0)
+	return enqueue_output(nh, str, 0, 1, 0, flush_ok);
+    return enqueue_output(nh, str, length, 1, 1, flush_ok);
 }
 
 int
 network_send_bytes(network_handle nh, const char *buffer, int buflen,
 		   int flush_ok)
 {
-    return enqueue_output(nh, buffer, buflen, 0, flush_ok);
+    return enqueue_output(nh, buffer, buflen, 0, 0, flush_ok);
 }
 
 int
@@ -553,6 +740,15 @@ network_buffered_output_length(network_handle nh)
     return h->output_length;
 }
 
+void
+network_output_stats(network_handle nh, unsigned *writes, unsigned *bytes)
+{
+    nhandle *h = (nhandle *)nh.ptr;
+
+    *writes = h->output_writes;
+    *bytes = h->output_bytes;
+}
+
 void
 network_suspend_input(network_handle nh)
 {
@@ -584,11 +780,23 @@ network_process_io(int timeout)
 	if (h->output_head)
 	    mplex_add_writer(h->wfd);
     }
+#ifdef OUTBOUND_NETWORK
+    {
+	npending *p;
+
+	for (p = all_npendings; p; p = p->next)
+	    if (!p->local_name)
+		mplex_add_writer(p->wfd);
+    }
+#endif
     add_registered_fds();
 
-    if (mplex_wait(timeout))
+    if (mplex_wait(timeout)) {
+#ifdef OUTBOUND_NETWORK
+	check_pending_connections(0);
+#endif
 	return 0;
-    else {
+    } else {
 	for (l = all_nlisteners; l; l = l->next)
 	    if (mplex_is_readable(l->fd))
 		accept_new_connection(l);
@@ -601,10 +809,36 @@ network_process_io(int timeout)
 	    }
 	}
 	check_registered_fds();
+#ifdef OUTBOUND_NETWORK
+	check_pending_connections(1);
+#endif
 	return 1;
     }
 }
 
+void
+network_set_connection_remote_name(int fd, const char *remote_name)
+{
+    nhandle *h;
+    static Stream *s = 0;
+
+    if (s == 0)
+	s = new_stream(100);
+
+    for (h = all_nhandles; h; h = h->next)
+	if (h->rfd == fd) {
+	    stream_printf(s, "%s %s %s", h->local_name,
+			  h->outbound ? "to" : "from", remote_name);
+	    if (strcmp(h->name, stream_contents(s)) != 0) {
+		oklog("NAME_LOOKUP: %s is %s\n", h->name, remote_name);
+		free_str(h->name);
+		h->name = str_dup(stream_contents(s));
+	    }
+	    reset_stream(s);
+	    break;
+	}
+}
+
 const char *
 network_connection_name(network_handle nh)
 {
@@ -650,7 +884,7 @@ network_set_client_echo(network_handle nh, int is_on)
 	telnet_cmd[1] = TN_WONT;
     else
 	telnet_cmd[1] = TN_WILL;
-    enqueue_output(nh, telnet_cmd, 3, 0, 1);
+    enqueue_output(nh, telnet_cmd, 3, 0, 0, 1);
 }
 
 #else /* NETWORK_PROTOCOL == NP_SINGLE */
@@ -663,18 +897,116 @@ network_set_client_echo(network_handle nh, int is_on)
 #ifdef OUTBOUND_NETWORK
 
 enum error
-network_open_connection(Var arglist, server_listener sl)
+network_open_connection(Var arglist, server_listener sl,
+			network_open_callback callback, void *data)
 {
     int rfd, wfd;
     const char *local_name, *remote_name;
     enum error e;
+    npending *p;
 
     e = proto_open_connection(arglist, &rfd, &wfd, &local_name, &remote_name);
+    if (e != E_NONE)
+	return e;
+
+    p = (npending *)mymalloc(sizeof(npending), M_NETWORK);
+
+    if (all_npendings)
+	all_npendings->prev = &(p->next);
+    p->next = all_npendings;
+    p->prev = &all_npendings;
+    all_npendings = p;
+
+    p->slistener = sl;
+    p->rfd = rfd;
+    p->wfd = wfd;
+    p->local_name = local_name ? str_dup(local_name) : 0;
+    p->remote_name = str_dup(remote_name);
+    p->deadline = monotonic_msecs()
+	+ (int64_t) server_int_option("outbound_connect_timeout", 5) * 1000;
+    p->callback = callback;
+    p->data = data;
+
+    return E_NONE;
+}
+
+/* The descriptors of a pending connection are in the wait set, so they
+ * have to be forgotten before the protocol closes them (or may close
+ * them, as proto_finish_connection() does if the connect failed).
+ */
+static void
+forget_npending(npending *p)
+{
+    mplex_forget(p->rfd);
+    if (p->wfd != p->rfd)
+	mplex_forget(p->wfd);
+}
+
+static void
+free_npending(npending *p)
+{
+    *(p->prev) = p->next;
+    if (p->next)
+	p->next->prev = p->prev;
+    if (p->local_name)
+	free_str(p->local_name);
+    free_str(p->remote_name);
+    myfree(p, M_NETWORK);
+}
+
+void
+network_cancel_open_connection(void *data)
+{
+    npending *p;
+
+    for (p = all_npendings; p; p = p->next)
+	if (p->data == data) {
+	    forget_npending(p);
+	    proto_close_connection(p->rfd, p->wfd);
+	    free_npending(p);
+	    break;
+	}
+}
+
+static void
+finish_npending(npending *p, enum error e)
+{
+    network_open_callback callback = p->callback;
+    void *data = p->data;
+
     if (e == E_NONE)
-	make_new_connection(sl, rfd, wfd,
-			    local_name, remote_name, 1);
+	make_new_connection(p->slistener, p->rfd, p->wfd,
+			    p->local_name, p->remote_name, 1);
+    free_npending(p);
+    (*callback) (data, e);
+}
 
-    return e;
+static void
+check_pending_connections(int ready)
+{
+    npending *p, *pnext;
+    int64_t now = monotonic_msecs();
+
+    for (p = all_npendings; p; p = pnext) {
+	pnext = p->next;
+	if (p->local_name)
+	    finish_npending(p, E_NONE);
+	else if (ready && mplex_is_writable(p->wfd)) {
+	    const char *local_name;
+	    enum error e;
+
+	    forget_npending(p);
+	    e = proto_finish_connection(p->rfd, p->wfd, &local_name);
+
+	    if (e == E_NONE)
+		p->local_name = str_dup(local_name);
+	    finish_npending(p, e);
+	} else if (now >= p->deadline) {
+	    forget_npending(p);
+	    proto_close_connection(p->rfd, p->wfd);
+	    finish_npending(p, E_INVARG);
+	}
+    }
 }
 #endif
 
@@ -693,6 +1025,13 @@ network_close_listener(network_listener nl)
 void
 network_shutdown(void)
 {
+#ifdef OUTBOUND_NETWORK
+    while (all_npendings) {
+	forget_npending(all_npendings);
+	proto_close_connection(all_npendings->rfd, all_npendings->wfd);
+	free_npending(all_npendings);
+    }
+#endif
     while (all_nhandles)
 	close_nhandle(all_nhandles);
     while (all_nlisteners)
@@ -40,6 +40,16 @@ extern void network_unregister_fd(int fd);
 				 * forgotten.
 				 */
 
+extern void network_set_connection_remote_name(int fd,
+					      const char *remote_name);
+				/* The connection whose input comes from FD is
+				 * now known to be from REMOTE_NAME, as it
+				 * would have been passed back by
+				 * proto_accept_connection().  Used when the
+				 * name is looked up after the connection has
+				 * been accepted.
+				 */
+
 extern int network_set_nonblocking(int fd);
 				/* Enable nonblocking I/O on the file
 				 * descriptor FD.  Return true iff successful.
@@ -138,6 +138,27 @@ extern enum error proto_open_connection(Var arglist,
 				 * *REMOTE_NAME a string naming the remote
 				 * endpoint, and E_NONE returned.  Otherwise,
 				 * an appropriate error should be returned.
+				 *
+				 * The connection need not be complete on
+				 * return: a protocol that can connect without
+				 * blocking may instead set *LOCAL_NAME to
+				 * zero, in which case *WRITE_FD becomes
+				 * writable once the attempt has either
+				 * succeeded or failed, and the caller then
+				 * calls proto_finish_connection() to learn
+				 * which.
+				 */
+
+extern enum error proto_finish_connection(int read_fd, int write_fd,
+					  const char **local_name);
+				/* Complete a connection attempt started by
+				 * proto_open_connection() for which no local
+				 * name was returned, after WRITE_FD has
+				 * become writable.  If the connection was
+				 * made, *LOCAL_NAME should be set as above
+				 * and E_NONE returned.  Otherwise the file
+				 * descriptors should be closed and an error
+				 * returned as for proto_open_connection().
 				 */
 
 #endif				/* OUTBOUND_NETWORK */
@@ -87,6 +87,12 @@ network_send_line(network_handle nh, const char *line, int flush_ok)
     return 1;
 }
 
+int
+network_send_string(network_handle nh, const char *str, int flush_ok)
+{
+    return network_send_line(nh, str, flush_ok);
+}
+
 int
 network_send_bytes(network_handle nh, const char *buffer, int buflen,
 		   int flush_ok)
@@ -104,6 +110,12 @@ network_buffered_output_length(network_handle nh)
     return 0;
 }
 
+void
+network_output_stats(network_handle nh, unsigned *writes, unsigned *bytes)
+{
+    *writes = *bytes = 0;	/* stdio does the buffering here */
+}
+
 const char *
 network_connection_name(network_handle nh)
 {
@@ -185,7 +197,7 @@ network_process_io(int timeout)
 	    state = STATE_OPEN;
 	    got_some = 1;
 	} else if (timeout != 0)
-	    sleep(timeout);
+	    usleep(timeout * 1000);
 	break;
 
     case STATE_OPEN:
@@ -213,11 +225,11 @@ network_process_io(int timeout)
 		    }
 	    }
 
-	    if (got_some || timeout == 0)
+	    if (got_some || timeout <= 0)
 		goto done;
 
-	    sleep(1);
-	    timeout--;
+	    usleep((timeout < 1000 ? timeout : 1000) * 1000);
+	    timeout -= 1000;
 	}
     }
 
@@ -370,4 +370,14 @@ proto_open_connection(Var arglist, int *read_fd, int *write_fd,
 
     return E_NONE;
 }
+
+enum error
+proto_finish_connection(int read_fd, int write_fd, const char **local_name)
+{
+    /* t_connect() above is synchronous, so there's never a connection
+     * in progress to finish.
+     */
+    panic("proto_finish_connection() called on a TLI connection");
+    return E_QUOTA;
+}
 #endif				/* OUTBOUND_NETWORK */
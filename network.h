@@ -109,6 +109,14 @@ extern int network_send_line(network_handle nh, const char *line,
 				 * fail if FLUSH_OK is false.
 				 */
 
+extern int network_send_string(network_handle nh, const char *str,
+			       int flush_ok);
+				/* Like network_send_line(), except that STR
+				 * must be a MOO string (see str_dup()).  The
+				 * network module may keep a reference to it
+				 * instead of copying it.
+				 */
+
 extern int network_send_bytes(network_handle nh,
 			      const char *buffer, int buflen,
 			      int flush_ok);
@@ -129,6 +137,14 @@ extern int network_buffered_output_length(network_handle nh);
 				 * currently queued up on the given connection.
 				 */
 
+extern void network_output_stats(network_handle nh, unsigned *writes,
+				 unsigned *bytes);
+				/* Sets WRITES and BYTES to the number of
+				 * system calls made to write output to the
+				 * given connection and the number of bytes
+				 * they wrote.
+				 */
+
 extern void network_suspend_input(network_handle nh);
 				/* The network module is strongly encouraged,
 				 * though not strictly required, to temporarily
@@ -153,7 +169,7 @@ extern int network_process_io(int timeout);
 				 * pending input, and handle requests for new
 				 * connections.  It is acceptable for the
 				 * network to block for up to 'timeout'
-				 * seconds.  Returns true iff it found some I/O
+				 * milliseconds.  Returns true iff it found some I/O
 				 * to do (i.e., it didn't use up all of the
 				 * timeout).
 				 */
@@ -191,22 +207,39 @@ extern int network_set_connection_option(network_handle nh,
 #ifdef OUTBOUND_NETWORK
 #include "structures.h"
 
-extern enum error network_open_connection(Var arglist, server_listener sl);
+typedef void (*network_open_callback) (void *data, enum error e);
+
+extern enum error network_open_connection(Var arglist, server_listener sl,
+					  network_open_callback callback,
+					  void *data);
 				/* The given MOO arguments should be used as a
 				 * specification of a remote network connection
-				 * to be made.  If the arguments are OK and the
-				 * connection is successfully made, it should
-				 * be treated as if it were a normal connection
-				 * accepted by the server (e.g., a network
-				 * handle should be created for it, the
-				 * function server_new_connection should be
-				 * called, etc.) and E_NONE should be returned.
-				 * Otherwise, some other appropriate error
-				 * value should be returned.  The caller of
-				 * this function is responsible for freeing the
-				 * MOO value in `arglist'.  This function need
-				 * not be supplied if OUTBOUND_NETWORK is not
-				 * defined.
+				 * to be made.  If the arguments are bad or the
+				 * attempt can't even be started, an
+				 * appropriate error value should be returned
+				 * and CALLBACK never called.  Otherwise E_NONE
+				 * should be returned right away and the
+				 * attempt left to complete in the course of
+				 * later calls to network_process_io(), which
+				 * calls CALLBACK exactly once with DATA and
+				 * the outcome.  If the connection is made, it
+				 * should be treated as if it were a normal
+				 * connection accepted by the server (e.g., a
+				 * network handle should be created for it,
+				 * the function server_new_connection should
+				 * be called, etc.) just before CALLBACK is
+				 * called with E_NONE.  SL must remain valid
+				 * until then.  The caller of this function is
+				 * responsible for freeing the MOO value in
+				 * `arglist'.  This function need not be
+				 * supplied if OUTBOUND_NETWORK is not defined.
+				 */
+
+extern void network_cancel_open_connection(void *data);
+				/* Abandon the connection attempt started by
+				 * network_open_connection() with the given
+				 * DATA, if it hasn't completed yet; its
+				 * callback will not be called.
 				 */
 
 #endif
@@ -26,6 +26,7 @@
 #include "config.h"
 #include "functions.h"
 #include "log.h"
+#include "numbers.h"
 #include "random.h"
 #include "server.h"
 #include "sosemanuk.h"
@@ -38,14 +39,14 @@ sosemanuk_key_context key_context;
 sosemanuk_run_context run_context;
 
 static int
-parse_number(const char *str, int *result, int try_floating_point)
+parse_number(const char *str, Num *result, int try_floating_point)
 {
     char *p;
 
-    *result = strtol(str, &p, 10);
+    *result = strtoimax(str, &p, 10);
     if (try_floating_point &&
 	(p == str || *p == '.' || *p == 'e' || *p == 'E'))
-	*result = (int) strtod(str, &p);
+	*result = (Num) strtod(str, &p);
     if (p == str)
 	return 0;
     while (*p) {
@@ -59,7 +60,7 @@ parse_number(const char *str, int *result, int try_floating_point)
 static int
 parse_object(const char *str, Objid * result)
 {
-    int number;
+    Num number;
 
     while (*str && *str == ' ')
 	str++;
@@ -98,7 +99,7 @@ parse_float(const char *str, double *result)
 }
 
 enum error
-become_integer(Var in, int *ret, int called_from_tonum)
+become_integer(Var in, Num *ret, int called_from_tonum)
 {
     switch (in.type) {
     case TYPE_INT:
@@ -117,9 +118,9 @@ become_integer(Var in, int *ret, int called_from_tonum)
 	*ret = in.v.err;
 	break;
     case TYPE_FLOAT:
-	if (*in.v.fnum < (double) INT_MIN || *in.v.fnum > (double) INT_MAX)
+	if (!(in.v.fnum >= (double) MININT && in.v.fnum < -(double) MININT))
 	    return E_FLOAT;
-	*ret = (int) *in.v.fnum;
+	*ret = (Num) in.v.fnum;
 	break;
     case TYPE_MAP:
     case TYPE_LIST:
@@ -149,7 +150,7 @@ become_float(Var in, double *ret)
 	*ret = (double) in.v.err;
 	break;
     case TYPE_FLOAT:
-	*ret = *in.v.fnum;
+	*ret = in.v.fnum;
 	break;
     case TYPE_MAP:
     case TYPE_LIST:
@@ -161,18 +162,6 @@ become_float(Var in, double *ret)
     return E_NONE;
 }
 
-Var
-new_float(double d)
-{
-    Var v;
-
-    v.type = TYPE_FLOAT;
-    v.v.fnum = (double *)mymalloc(sizeof(double), M_FLOAT);
-    *v.v.fnum = d;
-
-    return v;
-}
-
 #if COERCION_IS_EVER_IMPLEMENTED_AND_DESIRED
 static int
 to_float(Var v, double *dp)
@@ -182,7 +171,7 @@ to_float(Var v, double *dp)
 	*dp = (double) v.v.num;
 	break;
     case TYPE_FLOAT:
-	*dp = *v.v.fnum;
+	*dp = v.v.fnum;
 	break;
     default:
 	return 0;
@@ -245,11 +234,11 @@ do_equals(Var lhs, Var rhs)
     if (lhs.type != rhs.type)
 	return 0;
     else
-	return *lhs.v.fnum == *rhs.v.fnum;
+	return lhs.v.fnum == rhs.v.fnum;
 }
 
 int
-compare_integers(int a, int b)
+compare_integers(Num a, Num b)
 {
     if (a < b)
 	return -1;
@@ -271,7 +260,7 @@ compare_numbers(Var a, Var b)
 	ans.type = TYPE_INT;
 	ans.v.num = compare_integers(a.v.num, b.v.num);
     } else {
-	double aa = *a.v.fnum, bb = *b.v.fnum;
+	double aa = a.v.fnum, bb = b.v.fnum;
 
 	ans.type = TYPE_INT;
 	if (aa < bb)
@@ -298,7 +287,7 @@ compare_numbers(Var a, Var b)
 			ans.type = TYPE_INT;			\
 			ans.v.num = a.v.num op b.v.num;		\
 		    } else {					\
-			double d = *a.v.fnum op *b.v.fnum;	\
+			double d = a.v.fnum op b.v.fnum;	\
 								\
 			if (!IS_REAL(d)) {			\
 			    ans.type = TYPE_ERR;		\
@@ -323,7 +312,7 @@ do_modulus(Var a, Var b)
 	ans.type = TYPE_ERR;
 	ans.v.err = E_TYPE;
     } else if ((a.type == TYPE_INT && b.v.num == 0) ||
-               (a.type == TYPE_FLOAT && *b.v.fnum == 0.0)) {
+               (a.type == TYPE_FLOAT && b.v.fnum == 0.0)) {
 	ans.type = TYPE_ERR;
 	ans.v.err = E_DIV;
     } else if (a.type == TYPE_INT) {
@@ -333,7 +322,7 @@ do_modulus(Var a, Var b)
 	else
 	    ans.v.num = a.v.num % b.v.num;
     } else { // must be float
-	double d = fmod(*a.v.fnum, *b.v.fnum);
+	double d = fmod(a.v.fnum, b.v.fnum);
 	if (!IS_REAL(d)) {
 	    ans.type = TYPE_ERR;
 	    ans.v.err = E_FLOAT;
@@ -353,7 +342,7 @@ do_divide(Var a, Var b)
 	ans.type = TYPE_ERR;
 	ans.v.err = E_TYPE;
     } else if ((a.type == TYPE_INT && b.v.num == 0) ||
-               (a.type == TYPE_FLOAT && *b.v.fnum == 0.0)) {
+               (a.type == TYPE_FLOAT && b.v.fnum == 0.0)) {
 	ans.type = TYPE_ERR;
 	ans.v.err = E_DIV;
     } else if (a.type == TYPE_INT) {
@@ -363,7 +352,7 @@ do_divide(Var a, Var b)
 	else
 	    ans.v.num = a.v.num / b.v.num;
     } else { // must be float
-	double d = *a.v.fnum / *b.v.fnum;
+	double d = a.v.fnum / b.v.fnum;
 	if (!IS_REAL(d)) {
 	    ans.type = TYPE_ERR;
 	    ans.v.err = E_FLOAT;
@@ -380,7 +369,7 @@ do_power(Var lhs, Var rhs)
     Var ans;
 
     if (lhs.type == TYPE_INT) {	/* integer exponentiation */
-	int a = lhs.v.num, b, r;
+	Num a = lhs.v.num, b, r;
 
 	if (rhs.type != TYPE_INT)
 	    goto type_error;
@@ -419,13 +408,13 @@ do_power(Var lhs, Var rhs)
 	    d = (double) rhs.v.num;
 	    break;
 	case TYPE_FLOAT:
-	    d = *rhs.v.fnum;
+	    d = rhs.v.fnum;
 	    break;
 	default:
 	    goto type_error;
 	}
 	errno = 0;
-	d = pow(*lhs.v.fnum, d);
+	d = pow(lhs.v.fnum, d);
 	if (errno != 0 || !IS_REAL(d)) {
 	    ans.type = TYPE_ERR;
 	    ans.v.err = E_FLOAT;
@@ -467,7 +456,7 @@ bf_tofloat(Var arglist, Byte next, void *vdata, Objid progr)
     enum error e;
 
     r = new_float(0.0);
-    e = become_float(arglist.v.list[1], r.v.fnum);
+    e = become_float(arglist.v.list[1], &r.v.fnum);
 
     free_var(arglist);
     if (e == E_NONE)
@@ -495,7 +484,7 @@ bf_min(Var arglist, Byte next, void *vdata, Objid progr)
 	for (i = 2; i <= nargs; i++)
 	    if (arglist.v.list[i].type != TYPE_FLOAT)
 		bad_types = 1;
-	    else if (*arglist.v.list[i].v.fnum < *r.v.fnum)
+	    else if (arglist.v.list[i].v.fnum < r.v.fnum)
 		r = arglist.v.list[i];
     }
 
@@ -525,7 +514,7 @@ bf_max(Var arglist, Byte next, void *vdata, Objid progr)
 	for (i = 2; i <= nargs; i++)
 	    if (arglist.v.list[i].type != TYPE_FLOAT)
 		bad_types = 1;
-	    else if (*arglist.v.list[i].v.fnum > *r.v.fnum)
+	    else if (arglist.v.list[i].v.fnum > r.v.fnum)
 		r = arglist.v.list[i];
     }
 
@@ -547,7 +536,7 @@ bf_abs(Var arglist, Byte next, void *vdata, Objid progr)
 	if (r.v.num < 0)
 	    r.v.num = -r.v.num;
     } else
-	*r.v.fnum = fabs(*r.v.fnum);
+	r.v.fnum = fabs(r.v.fnum);
 
     free_var(arglist);
     return make_var_pack(r);
@@ -559,7 +548,7 @@ bf_abs(Var arglist, Byte next, void *vdata, Objid progr)
 		{							      \
 		    double	d;					      \
 									      \
-		    d = *arglist.v.list[1].v.fnum;			      \
+		    d = arglist.v.list[1].v.fnum;			      \
 		    errno = 0;						      \
 		    d = name(d);					      \
 		    free_var(arglist);					      \
@@ -590,7 +579,7 @@ MATH_FUNC(floor)
 {
     double d;
 
-    d = *arglist.v.list[1].v.fnum;
+    d = arglist.v.list[1].v.fnum;
     errno = 0;
     if (d < 0.0)
 	d = ceil(d);
@@ -610,10 +599,10 @@ bf_atan(Var arglist, Byte next, void *vdata, Objid progr)
 {
     double d, dd;
 
-    d = *arglist.v.list[1].v.fnum;
+    d = arglist.v.list[1].v.fnum;
     errno = 0;
     if (arglist.v.list[0].v.num >= 2) {
-	dd = *arglist.v.list[2].v.fnum;
+	dd = arglist.v.list[2].v.fnum;
 	d = atan2(d, dd);
     } else
 	d = atan(d);
@@ -678,8 +667,9 @@ bf_ctime(Var arglist, Byte next, void *vdata, Objid progr)
     return make_var_pack(r);
 }
 
-/* For now:  Uncoment on unicode64 branch */
-/* #define INTNUM_AND_OBJID_ARE_64_BITS */
+#ifdef INT64_NUM
+#define INTNUM_AND_OBJID_ARE_64_BITS
+#endif
 
 /*****FIX***:
  * (1) INTNUM_AND_OBJID_ARE_64_BITS should be an options.h setting
@@ -712,8 +702,8 @@ bf_ctime(Var arglist, Byte next, void *vdata, Objid progr)
 
 
 #ifdef INTNUM_AND_OBJID_ARE_64_BITS
-typedef int64 Intnum;
-typedef unsigned64 Unsignednum;
+typedef Num Intnum;
+typedef UNum Unsignednum;
 #define INTNUM_MAX INT64_MAX
 
 /* Assume lack of 128-bit integer type */
@@ -723,8 +713,8 @@ typedef unsigned64 Unsignednum;
 #  endif
 
 #else
-typedef int32 Intnum;
-typedef unsigned32 Unsignednum;
+typedef Num Intnum;
+typedef UNum Unsignednum;
 #define INTNUM_MAX INT32_MAX
 
 /* Assume support for u_int64_t otherwise uncomment */
@@ -766,7 +756,7 @@ rlg2 (Unsignednum v)
     v |= v >> 16;
 #  ifdef INTNUM_AND_OBJID_ARE_64_BITS
     v |= v >> 32;
-    return evil[(unsigned64)(v * 0x03F566ED27179461ULL) >> 58];
+    return evil[(uint64_t)(v * 0x03F566ED27179461ULL) >> 58];
 #  else
     return evil[(unsigned32)(v * 0x07C4ACDDU) >> 27];
 #  endif
@@ -822,17 +812,17 @@ static package
 bf_random(Var arglist, Byte next, void *vdata, Objid progr)
 {
     int nargs = arglist.v.list[0].v.num;
-    int num = (nargs >= 1 ? arglist.v.list[1].v.num : INTNUM_MAX);
+    Intnum num = (nargs >= 1 ? arglist.v.list[1].v.num : INTNUM_MAX);
     Var r;
-    int e;
-    int rnd;
+    Intnum e;
+    Intnum rnd;
 
     free_var(arglist);
 
     if (num <= 0)
 	return make_error_pack(E_INVARG);
 
-    const int range_l =
+    const Intnum range_l =
 	((INTNUM_MAX > RAND_MAX ? RAND_MAX : (RAND_MAX - num)) + 1) % num;
 
     r.type = TYPE_INT;
@@ -844,7 +834,7 @@ bf_random(Var arglist, Byte next, void *vdata, Objid progr)
 #if (INTNUM_MAX > RAND_MAX)
     /* num >= RAND_MAX possible; launch general algorithm */
 
-#   define RANGE       (RAND_MAX+1)
+#   define RANGE       ((Intnum) RAND_MAX + 1)
 #   define OR_ZERO(n)  (n)
 
     rnd = 0;
@@ -865,7 +855,7 @@ bf_random(Var arglist, Byte next, void *vdata, Objid progr)
 
     for (;;) {
 	/* INVARIANT: rnd uniform over [0..e-1] */
-	int rnd_next = RANDOM();
+	Intnum rnd_next = RANDOM();
 
 #if RAND_MAX < INTNUM_MAX
 	/* compiler should turn [/%*]RANGE into bitwise ops */
@@ -917,7 +907,7 @@ bf_random_bytes(Var arglist, Byte next, void *vdata, Objid progr)
     Var r;
     package p;
 
-    int len = arglist.v.list[1].v.num;
+    Num len = arglist.v.list[1].v.num;
 
     if (len < 0 || len > 10000) {
 	p = make_raise_pack(E_INVARG, "Invalid count", var_ref(arglist.v.list[1]));
@@ -956,8 +946,8 @@ bf_random_bytes(Var arglist, Byte next, void *vdata, Objid progr)
 static package
 bf_floatstr(Var arglist, Byte next, void *vdata, Objid progr)
 {				/* (float, precision [, sci-notation]) */
-    double d = *arglist.v.list[1].v.fnum;
-    int prec = arglist.v.list[2].v.num;
+    double d = arglist.v.list[1].v.fnum;
+    Num prec = arglist.v.list[2].v.num;
     int use_sci = (arglist.v.list[0].v.num >= 3
 		   && is_true(arglist.v.list[3]));
     char fmt[10], output[500];	/* enough for IEEE double */
@@ -968,7 +958,7 @@ bf_floatstr(Var arglist, Byte next, void *vdata, Objid progr)
 	prec = DBL_DIG + 4;
     else if (prec < 0)
 	return make_error_pack(E_INVARG);
-    sprintf(fmt, "%%.%d%c", prec, use_sci ? 'e' : 'f');
+    sprintf(fmt, "%%.%d%c", (int) prec, use_sci ? 'e' : 'f');
     sprintf(output, fmt, d);
 
     r.type = TYPE_STR;
@@ -224,7 +224,7 @@ bf_move_write(void *vdata)
 {
     struct bf_move_data *data = (bf_move_data *)vdata;
 
-    dbio_printf("bf_move data: what = %d, where = %d\n",
+    dbio_printf("bf_move data: what = %" PRIdN ", where = %" PRIdN "\n",
 		data->what, data->where);
 }
 
@@ -233,7 +233,7 @@ bf_move_read()
 {
     struct bf_move_data *data = (bf_move_data *)alloc_data(sizeof(*data));
 
-    if (dbio_scanf("bf_move data: what = %d, where = %d\n",
+    if (dbio_scanf("bf_move data: what = %" SCNdN ", where = %" SCNdN "\n",
 		   &data->what, &data->where) == 2)
 	return data;
     else
@@ -244,7 +244,7 @@ static package
 bf_toobj(Var arglist, Byte next, void *vdata, Objid progr)
 {
     Var r;
-    int i;
+    Num i;
     enum error e;
 
     r.type = TYPE_OBJ;
@@ -259,30 +259,26 @@ bf_toobj(Var arglist, Byte next, void *vdata, Objid progr)
 }
 
 static package
-bf_typeof(Var arglist, Byte next, void *vdata, Objid progr)
+bf_typeof(Var *args, int nargs, Objid progr)
 {
     Var r;
     r.type = TYPE_INT;
-    r.v.num = (int) arglist.v.list[1].type & TYPE_DB_MASK;
-    free_var(arglist);
+    r.v.num = (int) args[0].type & TYPE_DB_MASK;
     return make_var_pack(r);
 }
 
 static package
-bf_valid(Var arglist, Byte next, void *vdata, Objid progr)
+bf_valid(Var *args, int nargs, Objid progr)
 {				/* (object) */
     Var r;
 
-    if (arglist.v.list[1].is_object()) {
+    if (args[0].is_object()) {
 	r.type = TYPE_INT;
-	r.v.num = is_valid(arglist.v.list[1]);
+	r.v.num = is_valid(args[0]);
     }
-    else {
-	free_var(arglist);
+    else
 	return make_error_pack(E_TYPE);
-    }
 
-    free_var(arglist);
     return make_var_pack(r);
 }
 
@@ -437,7 +433,7 @@ bf_create(Var arglist, Byte next, void *vdata, Objid progr)
 static void
 bf_create_write(void *vdata)
 {
-    dbio_printf("bf_create data: oid = %d\n", *((Objid *) vdata));
+    dbio_printf("bf_create data: oid = %" PRIdN "\n", *((Objid *) vdata));
 }
 
 static void *
@@ -445,7 +441,7 @@ bf_create_read(void)
 {
     Objid *data = (Objid *)alloc_data(sizeof(Objid));
 
-    if (dbio_scanf("bf_create data: oid = %d\n", data) == 1)
+    if (dbio_scanf("bf_create data: oid = %" SCNdN "\n", data) == 1)
 	return data;
     else
 	return 0;
@@ -813,7 +809,7 @@ bf_recycle_write(void *vdata)
 {
     Objid *data = (Objid *)vdata;
 
-    dbio_printf("bf_recycle data: oid = %d, cont = 0\n", *data);
+    dbio_printf("bf_recycle data: oid = %" PRIdN ", cont = 0\n", *data);
 }
 
 static void *
@@ -828,7 +824,7 @@ bf_recycle_read(void)
      * suppressed assignments are not counted in determining the returned value
      * of `scanf'...
      */
-    if (dbio_scanf("bf_recycle data: oid = %d, cont = %d\n",
+    if (dbio_scanf("bf_recycle data: oid = %" SCNdN ", cont = %d\n",
 		   data, &dummy) == 2)
 	return data;
     else
@@ -946,7 +942,7 @@ register_objects(void)
     none.type = TYPE_NONE;
 
     register_function("toobj", 1, 1, bf_toobj, TYPE_ANY);
-    register_function("typeof", 1, 1, bf_typeof, TYPE_ANY);
+    register_stack_function("typeof", 1, 1, bf_typeof, TYPE_ANY);
     register_function_with_read_write("create", 1, 4, bf_create,
 				      bf_create_read, bf_create_write,
 				      TYPE_ANY, TYPE_ANY, TYPE_ANY, TYPE_ANY);
@@ -954,7 +950,7 @@ register_objects(void)
 				      bf_recycle_read, bf_recycle_write,
 				      TYPE_ANY);
     register_function("object_bytes", 1, 1, bf_object_bytes, TYPE_ANY);
-    register_function("valid", 1, 1, bf_valid, TYPE_ANY);
+    register_stack_function("valid", 1, 1, bf_valid, TYPE_ANY);
     register_function("chparents", 2, 3, bf_chparent_chparents,
 		      TYPE_ANY, TYPE_LIST, TYPE_LIST);
     register_function("chparent", 2, 3, bf_chparent_chparents,
@@ -40,6 +40,13 @@ enum Extended_Opcode {
     EOP_BITOR, EOP_BITAND, EOP_BITXOR,
     EOP_BITSHL, EOP_BITSHR, EOP_COMPLEMENT,
 
+    /* built-in function call with the arguments on the stack */
+    EOP_BI_FUNC_CALL,
+
+    /* intrinsic built-in functions (see intrinsic_func()) */
+    EOP_BF_LENGTH, EOP_BF_TYPEOF, EOP_BF_VALID, EOP_BF_IS_MEMBER,
+    EOP_BF_LISTAPPEND, EOP_BF_TOSTR,
+
     Last_Extended_Opcode = 255
 };
 
@@ -165,6 +165,11 @@
  * MP_FAKE	The server will use a nasty trick that works only if you've
  *		defined NETWORK_PROTOCOL as NP_LOCAL and NETWORK_STYLE as
  *		NS_SYSV above.
+ * MP_EPOLL	The server will assume that the Linux epoll facility exists.
+ *		Descriptors stay registered with the kernel between waits,
+ *		so the cost of a wait doesn't grow with the number of idle
+ *		connections and there's no FD_SETSIZE limit on descriptors.
+ *		This is the default for NS_BSD wherever epoll is available.
  *
  * Usually, it works best to leave MPLEX_STYLE undefined and let the code at
  * the bottom of this file pick the right value.
@@ -286,6 +291,21 @@
 
 #define BYTECODE_REDUCE_REF /* */
 
+/******************************************************************************
+ * The bytecode interpreter normally dispatches each opcode through one big
+ * `switch' statement.  Compilers that support taking the address of a label
+ * (GCC and Clang do) allow the interpreter to instead jump directly from the
+ * end of one opcode's handler to the start of the next one's through a table
+ * of label addresses, which is noticeably faster in tight loops because the
+ * hardware can predict each handler's jump separately.  Define
+ * DIRECT_THREADED_DISPATCH to use this technique.  It does not affect the
+ * bytecode itself, so databases (including suspended tasks) are compatible
+ * with servers built either way.
+ ******************************************************************************
+ */
+
+#define DIRECT_THREADED_DISPATCH /* */
+
 /******************************************************************************
  * The server can merge duplicate strings on load to conserve memory.  This
  * involves a rather expensive step at startup to dispose of the table used
@@ -299,6 +319,51 @@
 
 #define STRING_INTERNING /* */
 
+/******************************************************************************
+ * Strings, lists, maps, tasks and network buffers are allocated and freed
+ * at a tremendous rate, and most of them are small.  Define MEMORY_POOLS to
+ * keep freed blocks of these types of up to a few hundred bytes on per-size
+ * free lists and hand them out again, rather than going to malloc() each
+ * time.  Pooled memory is never returned to the system.  Either way, the
+ * `memory_usage()' function reports the number of live blocks, live bytes
+ * and the high-water mark of live bytes for each of these types.  You may
+ * want to turn this off when hunting memory bugs with a tool like Valgrind.
+ ******************************************************************************
+ */
+
+#define MEMORY_POOLS /* */
+
+/******************************************************************************
+ * Loading a database normally compiles every verb program in it, although
+ * most verbs in a large core are never called during a given run.  Define
+ * LAZY_VERB_COMPILATION to keep the text of each verb instead and compile it
+ * the first time the verb is called, listed, disassembled, etc.  Verbs that
+ * are still uncompiled at checkpoint time are written out from their text
+ * (or compiled then, for the binary format).  A verb whose text doesn't
+ * compile no longer stops the database from loading: the error is logged
+ * when the verb is first needed, the verb behaves as if it had no program,
+ * and its text is kept.  The `verb_compilation_stats()' function returns
+ * the number of verbs compiled on demand, the number still uncompiled and
+ * the number that failed to compile.
+ ******************************************************************************
+ */
+
+/* #define LAZY_VERB_COMPILATION */
+
+/******************************************************************************
+ * MOO integers (and object numbers) are normally 32 bits wide.  Define
+ * INT64_NUM to make them 64 bits wide instead, so that timestamps in
+ * milliseconds, large counters and the like can be kept as integers.
+ * Databases written by a 32-bit server load as is; a server built with
+ * this option writes databases with a newer format version, which a
+ * 32-bit server will refuse to load.  Note that `encode_binary()' and
+ * other functions that take byte values are unaffected, and the results
+ * of integer overflow differ between the two sizes.
+ ******************************************************************************
+ */
+
+/* #define INT64_NUM */
+
 /******************************************************************************
  * Store the length of the string WITH the string rather than recomputing
  * it each time it is needed.
@@ -352,6 +417,23 @@
 #define MIN_LIST_VALUE_BYTES_LIMIT 1021
 #define MIN_MAP_VALUE_BYTES_LIMIT  1021
 
+/******************************************************************************
+ * DEFAULT_TASK_RUN_SLICE is the number of milliseconds that each pass of the
+ * server's main loop may spend running ready tasks (input, forked and
+ * resumed tasks), before it goes back to doing network I/O.  Task queues are
+ * still served fairly, in order of their usage, one task at a time.  If the
+ * slice is zero, each pass runs at most one task, which was the original
+ * behavior.  Larger slices raise throughput and lower task latency under
+ * load, at the cost of network I/O waiting for up to a slice.
+ *
+ * If defined in the database, $server_options.task_run_slice overrides this
+ * default.  It can be no larger than MAX_TASK_RUN_SLICE.
+ ******************************************************************************
+ */
+
+#define DEFAULT_TASK_RUN_SLICE	0
+#define MAX_TASK_RUN_SLICE	1000
+
 /******************************************************************************
  * In the original LambdaMOO server, last chance command processing
  * occured in the `huh' verb defined on the player's location.  The
@@ -438,6 +520,10 @@
 #  error Illegal match() pattern cache size!
 #endif
 
+#if defined(DIRECT_THREADED_DISPATCH) && !defined(__GNUC__)
+#  error DIRECT_THREADED_DISPATCH requires support for labels as values
+#endif
+
 #define NP_SINGLE	1
 #define NP_TCP		2
 #define NP_LOCAL	3
@@ -448,12 +534,15 @@
 #define MP_SELECT	1
 #define MP_POLL		2
 #define MP_FAKE		3
+#define MP_EPOLL	4
 
 #include "config.h"
 
 #if NETWORK_PROTOCOL != NP_SINGLE  &&  !defined(MPLEX_STYLE)
 #  if NETWORK_STYLE == NS_BSD
-#    if HAVE_SELECT
+#    if HAVE_EPOLL_CREATE
+#      define MPLEX_STYLE MP_EPOLL
+#    elif HAVE_SELECT
 #      define MPLEX_STYLE MP_SELECT
 #    else
        #error You cannot use BSD sockets without having select()!
@@ -506,7 +595,8 @@
 #if defined(MPLEX_STYLE) 	\
     && MPLEX_STYLE != MP_SELECT \
     && MPLEX_STYLE != MP_POLL \
-    && MPLEX_STYLE != MP_FAKE
+    && MPLEX_STYLE != MP_FAKE \
+    && MPLEX_STYLE != MP_EPOLL
 #  error Illegal value for "MPLEX_STYLE"
 #endif
 
@@ -69,9 +69,9 @@ static void     check_loop_name(const char *, enum loop_exit_kind);
 %union {
   Stmt         *stmt;
   Expr         *expr;
-  int           integer;
+  Num           integer;
   Objid         object;
-  double       *real;
+  double        real;
   char         *string;
   enum error    error;
   Arg_List     *args;
@@ -592,7 +592,7 @@ expr:
 			    $2->e.var.v.num = -$2->e.var.v.num;
 			    break;
 			  case TYPE_FLOAT:
-			    *($2->e.var.v.fnum) = - (*($2->e.var.v.fnum));
+			    $2->e.var.v.fnum = - ($2->e.var.v.fnum);
 			    break;
 			  default:
 			    break;
@@ -920,7 +920,7 @@ start_over:
     }
 
     if (isdigit(c) || (c == '.'  &&  language_version >= DBV_Float)) {
-	int	n = 0;
+	Num	n = 0;
 	int	type = tINTEGER;
 
 	while (isdigit(c)) {
@@ -983,7 +983,7 @@ start_over:
 		yyerror("Floating-point literal out of range");
 		d = 0.0;
 	    }
-	    yylval.real = alloc_float(d);
+	    yylval.real = d;
 	}
 	return type;
     }
@@ -1302,6 +1302,7 @@ my_getc(void *data)
     else if (!(c = code.v.list[state->cur_string].v.str[state->cur_char])) {
 	state->cur_string++;
 	state->cur_char = 0;
+	task_time_is_up();	/* check the clock once a line */
 	return '\n';
     } else {
 	state->cur_char++;
@@ -16,6 +16,8 @@
  *****************************************************************************/
 
 #include "ast.h"
+#include "code_gen.h"
+#include "db.h"
 #include "list.h"
 #include "parser.h"
 #include "program.h"
@@ -30,10 +32,14 @@ new_program(void)
     Program *p = (Program *) mymalloc(sizeof(Program), M_PROGRAM);
 
     p->ref_count = 1;
+    p->cg_features = CG_ALL_FEATURES;
     p->first_lineno = 1;
     p->cached_lineno = 1;
     p->cached_lineno_pc = 0;
     p->cached_lineno_vec = MAIN_VECTOR;
+    p->num_prop_sites = 0;
+    p->prop_cache_mask = 0;
+    p->prop_caches = 0;
     return p;
 }
 
@@ -109,6 +115,12 @@ free_program(Program * p)
 
 	myfree(p->main_vector.vector, M_BYTECODES);
 
+	if (p->prop_caches) {
+	    for (i = 0; i <= p->prop_cache_mask; i++)
+		db_clear_prop_cache(&p->prop_caches[i]);
+	    myfree(p->prop_caches, M_PROP_CACHE);
+	}
+
 	myfree(p, M_PROGRAM);
     }
 }
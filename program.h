@@ -23,6 +23,8 @@
 
 typedef unsigned char Byte;
 
+struct db_prop_cache;		/* see db.h */
+
 typedef struct {
     Byte numbytes_label, numbytes_literal, numbytes_fork, numbytes_var_name,
      numbytes_stack;
@@ -33,6 +35,7 @@ typedef struct {
 
 typedef struct {
     DB_Version version;
+    unsigned cg_features;	/* see code_gen.h */
     unsigned first_lineno;
     unsigned ref_count;
 
@@ -50,6 +53,15 @@ typedef struct {
     unsigned cached_lineno;
     unsigned cached_lineno_pc;
     int cached_lineno_vec;
+
+    /* Inline caches for the property-referencing opcodes, allocated
+     * the first time one of them is executed.  The table is an open
+     * addressed hash table keyed on the opcode's address and is kept
+     * at least twice as large as the number of such opcodes.
+     */
+    unsigned num_prop_sites;
+    unsigned prop_cache_mask;
+    struct db_prop_cache *prop_caches;
 } Program;
 
 #define MAIN_VECTOR 	-1	/* As opposed to an index into fork_vectors */
@@ -962,8 +962,11 @@ re_match_2(bufp, string1, size1, string2, size2, pos, regs, mstop)
 #ifndef TEST_REGEXP
 	{			/* Added for LambdaMOO */
 	    extern int task_timed_out;
+	    extern int task_time_is_up(void);
+	    static unsigned steps;
 
-	    if (task_timed_out)
+	    if (task_timed_out
+		|| ((++steps & 1023) == 0 && task_time_is_up()))
 		goto error;
 	}
 #endif
@@ -169,10 +169,10 @@ static int
 start_listener(slistener * l)
 {
     if (network_listen(l->nlistener)) {
-	oklog("LISTEN: #%d now listening on %s\n", l->oid, l->name);
+	oklog("LISTEN: #%" PRIdN " now listening on %s\n", l->oid, l->name);
 	return 1;
     } else {
-	errlog("LISTEN: Can't start #%d listening on %s!\n", l->oid, l->name);
+	errlog("LISTEN: Can't start #%" PRIdN " listening on %s!\n", l->oid, l->name);
 	return 0;
     }
 }
@@ -181,7 +181,7 @@ static void
 free_slistener(slistener * l)
 {
     network_close_listener(l->nlistener);
-    oklog("UNLISTEN: #%d no longer listening on %s\n", l->oid, l->name);
+    oklog("UNLISTEN: #%" PRIdN " no longer listening on %s\n", l->oid, l->name);
 
     *(l->prev) = l->next;
     if (l->next)
@@ -375,18 +375,13 @@ setup_signals(void)
     signal(SIGCHLD, child_completed_signal);
 }
 
-static void
-checkpoint_timer(Timer_ID id, Timer_Data data)
-{
-    checkpoint_requested = CHKPT_TIMER;
-}
+static int64_t next_checkpoint;	/* by monotonic_msecs() */
 
 static void
 set_checkpoint_timer(int first_time)
 {
     Var v;
     int interval, now = time(0);
-    static Timer_ID last_checkpoint_timer;
 
     v = get_system_property("dump_interval");
     if (v.type != TYPE_INT || v.v.num < 60 || now + v.v.num < now) {
@@ -395,9 +390,7 @@ set_checkpoint_timer(int first_time)
     } else
 	interval = v.v.num;
 
-    if (!first_time)
-	cancel_timer(last_checkpoint_timer);
-    last_checkpoint_timer = set_timer(interval, checkpoint_timer, 0);
+    next_checkpoint = monotonic_msecs() + (int64_t) interval * 1000;
 }
 
 static const char *
@@ -409,9 +402,9 @@ object_name(Objid oid)
 	s = new_stream(30);
 
     if (valid(oid))
-	stream_printf(s, "%s (#%d)", db_object_name(oid), oid);
+	stream_printf(s, "%s (#%" PRIdN ")", db_object_name(oid), oid);
     else
-	stream_printf(s, "#%d", oid);
+	stream_printf(s, "#%" PRIdN, oid);
 
     return reset_stream(s);
 }
@@ -643,13 +636,17 @@ main_loop(void)
     /* Now, we enter the main server loop */
     while (!shutdown_triggered) {
 	/* Check how long we have until the next task will be ready to run.
-	 * We only care about three cases (== 0, == 1, and > 1), so we can
-	 * map a `never' result from the task subsystem into 2.
+	 * We never wait for more than a second at a time, so we can map a
+	 * `never' result from the task subsystem into anything longer.
 	 */
-	int task_seconds = next_task_start();
-	int seconds_left = task_seconds < 0 ? 2 : task_seconds;
+	int task_msecs = next_task_start();
+	int msecs_left = task_msecs < 0 ? 2000 : task_msecs;
 	shandle *h, *nexth;
 
+	if (checkpoint_requested == CHKPT_OFF
+	    && monotonic_msecs() >= next_checkpoint)
+	    checkpoint_requested = CHKPT_TIMER;
+
 #ifdef ENABLE_GC
 	if (gc_run_called || gc_roots_count > GC_ROOTS_LIMIT
 	    || checkpoint_requested != CHKPT_OFF)
@@ -680,7 +677,8 @@ main_loop(void)
 
 	recycle_anonymous_objects();
 
-	if (!network_process_io(seconds_left ? 1 : 0) && seconds_left > 1)
+	if (!network_process_io(msecs_left < 1000 ? msecs_left : 1000)
+	    && msecs_left > 1000)
 	    db_flush(FLUSH_ONE_SECOND);
 	else
 	    db_flush(FLUSH_IF_FULL);
@@ -705,7 +703,7 @@ main_loop(void)
 			: (now - h->last_activity_time
 			   > DEFAULT_CONNECT_TIMEOUT))) {
 		    call_notifier(h->player, h->listener, "user_disconnected");
-		    oklog("TIMEOUT: #%d on %s\n",
+		    oklog("TIMEOUT: #%" PRIdN " on %s\n",
 			  h->player,
 			  network_connection_name(h->nhandle));
 		    if (h->print_messages)
@@ -715,7 +713,7 @@ main_loop(void)
 		    network_close(h->nhandle);
 		    free_shandle(h);
 		} else if (h->connection_time != 0 && !valid(h->player)) {
-		    oklog("RECYCLED: #%d on %s\n",
+		    oklog("RECYCLED: #%" PRIdN " on %s\n",
 			  h->player,
 			  network_connection_name(h->nhandle));
 		    if (h->print_messages)
@@ -826,7 +824,7 @@ read_stdin_line(const char *prompt)
 static void
 emergency_notify(Objid player, const char *line)
 {
-    printf("#%d <- %s\n", player, line);
+    printf("#%" PRIdN " <- %s\n", player, line);
 }
 
 static int
@@ -855,7 +853,7 @@ emergency_mode()
 	    Objid first_valid = -1;
 
 	    if (wizard >= 0)
-		printf("** Object #%d is not a wizard...\n", wizard);
+		printf("** Object #%" PRIdN " is not a wizard...\n", wizard);
 
 	    for (wizard = 0; wizard <= db_last_used_objid(); wizard++)
 		if (is_wizard(wizard))
@@ -867,17 +865,17 @@ emergency_mode()
 		if (first_valid < 0) {
 		    first_valid = db_create_object();
 		    db_change_parents(Var::new_obj(first_valid), new_list(0), none);
-		    printf("** No objects in database; created #%d.\n",
+		    printf("** No objects in database; created #%" PRIdN ".\n",
 			   first_valid);
 		}
 		wizard = first_valid;
 		db_set_object_flag(wizard, FLAG_WIZARD);
-		printf("** No wizards in database; wizzed #%d.\n", wizard);
+		printf("** No wizards in database; wizzed #%" PRIdN ".\n", wizard);
 	    }
-	    printf("** Now running emergency commands as #%d ...\n\n", wizard);
+	    printf("** Now running emergency commands as #%" PRIdN " ...\n\n", wizard);
 	}
         char prompt[100];
-        sprintf(prompt, "(#%d)%s: ", wizard, debug ? "" : "[!d]");
+        sprintf(prompt, "(#%" PRIdN ")%s: ", wizard, debug ? "" : "[!d]");
 	line = read_stdin_line(prompt);
 
 	if (!line)
@@ -945,7 +943,7 @@ emergency_mode()
 	    } else {
 		int i;
 
-		printf("** %d errors during parsing:\n",
+		printf("** %" PRIdN " errors during parsing:\n",
 		       errors.v.list[0].v.num);
 		for (i = 1; i <= errors.v.list[0].v.num; i++)
 		    printf("  %s\n", errors.v.list[i].v.str);
@@ -988,7 +986,7 @@ emergency_mode()
 		    } else {
 			int i;
 
-			printf("** %d errors during parsing:\n",
+			printf("** %" PRIdN " errors during parsing:\n",
 			       errors.v.list[0].v.num);
 			for (i = 1; i <= errors.v.list[0].v.num; i++)
 			    printf("  %s\n", errors.v.list[i].v.str);
@@ -1031,8 +1029,8 @@ emergency_mode()
 	    } else if (!mystrcasecmp(command, "debug") && nargs == 0) {
 		debug = !debug;
 	    } else if (!mystrcasecmp(command, "wizard") && nargs == 1
-		       && sscanf(words.v.list[2].v.str, "#%d", &wizard) == 1) {
-		printf("** Switching to wizard #%d...\n", wizard);
+		       && sscanf(words.v.list[2].v.str, "#%" SCNdN, &wizard) == 1) {
+		printf("** Switching to wizard #%" PRIdN "...\n", wizard);
 	    } else if (!mystrcasecmp(command, "help") || !mystrcasecmp(command, "?")) {
 		printf(";EXPR                 "
 		       "Evaluate MOO expression, print result.\n");
@@ -1238,6 +1236,12 @@ set_server_cmdline(const char *line)
     *e = '\0';
 }
 
+int
+server_shutting_down(void)
+{
+    return shutdown_triggered;
+}
+
 int
 server_flag_option(const char *name, int defallt)
 {
@@ -1308,7 +1312,7 @@ server_new_connection(server_listener sl, network_handle nh, int outbound)
 	task_suspend_input(h->tasks);
     }
 
-    oklog("%s: #%d on %s\n",
+    oklog("%s: #%" PRIdN " on %s\n",
 	  outbound ? "CONNECT" : "ACCEPT",
 	  h->player, network_connection_name(nh));
 
@@ -1504,7 +1508,7 @@ write_active_connections(void)
     dbio_printf("%d active connections with listeners\n", count);
 
     for (h = all_shandles; h; h = h->next)
-	dbio_printf("%d %d\n", h->player, h->listener);
+	dbio_printf("%" PRIdN " %" PRIdN "\n", h->player, h->listener);
 }
 
 int
@@ -1536,7 +1540,7 @@ read_active_connections(void)
 	Var v;
 
 	if (have_listeners) {
-	    if (dbio_scanf("%d %d\n", &who, &listener) != 2) {
+	    if (dbio_scanf("%" SCNdN " %" SCNdN "\n", &who, &listener) != 2) {
 		errlog("READ_ACTIVE_CONNECTIONS: Bad conn/listener pair.\n");
 		return 0;
 	    }
@@ -1603,6 +1607,14 @@ main(int argc, char **argv)
 	    } else
 		argc = 0;
 	    break;
+	case '-':		/* Long options */
+	    if (!strcmp(argv[0], "--db-format") && argc > 1
+		&& db_set_output_format(argv[1])) {
+		argc--;
+		argv++;
+	    } else
+		argc = 0;
+	    break;
 	default:
 	    argc = 0;		/* Provoke usage message below */
 	}
@@ -1633,13 +1645,14 @@ main(int argc, char **argv)
     if ((emergency && (script_file || script_line))
 	|| !db_initialize(&argc, &argv)
 	|| !network_initialize(argc, argv, &desc)) {
-	fprintf(stderr, "Usage: %s [-e] [-f script-file] [-c script-line] [-l log-file] %s %s\n",
+	fprintf(stderr, "Usage: %s [-e] [-f script-file] [-c script-line] [-l log-file] [--db-format text|binary] %s %s\n",
 		this_program, db_usage_string(), network_usage_string());
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "\t-e\t\temergency wizard mode\n");
 	fprintf(stderr, "\t-f\t\tfile to load and pass to `#0:do_start_script()'\n");
 	fprintf(stderr, "\t-c\t\tline to pass to `#0:do_start_script()'\n");
-	fprintf(stderr, "\t-l\t\toptional log file\n\n");
+	fprintf(stderr, "\t-l\t\toptional log file\n");
+	fprintf(stderr, "\t--db-format\tformat of the databases written (default `text'); either format can be read\n\n");
 	fprintf(stderr, "The emergency mode switch (-e) may not be used with either the file (-f) or line (-c) options.\n\n");
 	fprintf(stderr, "Both the file and line options may be specified. Their order on the command line determines the order of their invocation.\n\n");
 	fprintf(stderr, "Examples: \n");
@@ -1658,8 +1671,7 @@ main(int argc, char **argv)
 
     applog(LOG_INFO1, "STARTING: Version %s of the Stunt/LambdaMOO server\n", server_version);
     oklog("          (Using %s protocol)\n", network_protocol_name());
-    oklog("          (Task timeouts measured in %s seconds.)\n",
-	  virtual_timer_available()? "server CPU" : "wall-clock");
+    oklog("          (Task timeouts measured in wall-clock seconds.)\n");
     oklog("          (Process id %d)\n", parent_pid);
 
     register_bi_functions();
@@ -1767,11 +1779,9 @@ bf_reset_max_object(Var arglist, Byte next, void *vdata, Objid progr)
 static package
 bf_memory_usage(Var arglist, Byte next, void *vdata, Objid progr)
 {
-    Var r = new_list(0);
-
     free_var(arglist);
 
-    return make_var_pack(r);
+    return make_var_pack(memory_usage());
 }
 
 static package
@@ -1830,6 +1840,84 @@ find_slistener_by_oid(Objid obj)
 
     return 0;
 }
+
+/* A task suspended in open_network_connection() until the connection
+ * attempt completes.  The listener (if any) is copied, since the real
+ * one may be closed by unlisten() in the meantime.
+ */
+typedef struct task_waiting_on_connect {
+    struct task_waiting_on_connect *next, **prev;
+    slistener listener;
+    int has_listener;
+    vm the_vm;
+} task_waiting_on_connect;
+
+static task_waiting_on_connect *connect_waiters = 0;
+
+static void
+free_task_waiting_on_connect(task_waiting_on_connect *tw)
+{
+    *(tw->prev) = tw->next;
+    if (tw->next)
+	tw->next->prev = tw->prev;
+    myfree(tw, M_TASK);
+}
+
+static task_enum_action
+connect_waiter_enumerator(task_closure closure, void *data)
+{
+    task_waiting_on_connect *tw;
+    task_enum_action action;
+
+    for (tw = connect_waiters; tw; tw = tw->next) {
+	action = (*closure) (tw->the_vm, "open_network_connection", data);
+	if (action == TEA_KILL) {
+	    network_cancel_open_connection(tw);
+	    free_task_waiting_on_connect(tw);
+	}
+	if (action != TEA_CONTINUE)
+	    return action;
+    }
+
+    return TEA_CONTINUE;
+}
+
+static enum error
+connect_waiter_suspender(vm the_vm, void *data)
+{
+    task_waiting_on_connect *tw = (task_waiting_on_connect *)data;
+
+    tw->the_vm = the_vm;
+    tw->prev = &connect_waiters;
+    tw->next = connect_waiters;
+    if (connect_waiters)
+	connect_waiters->prev = &(tw->next);
+    connect_waiters = tw;
+
+    return E_NONE;
+}
+
+static void
+connection_opened(void *data, enum error e)
+{
+    task_waiting_on_connect *tw = (task_waiting_on_connect *)data;
+    Var r;
+
+    if (e == E_NONE) {
+	/* The connection was successfully opened, implying that
+	 * server_new_connection was called, implying and a new negative
+	 * player number was allocated for the connection.  Thus, the old
+	 * value of next_unconnected_player is the number of our connection.
+	 */
+	r.type = TYPE_OBJ;
+	r.v.obj = next_unconnected_player + 1;
+    } else {
+	r.type = TYPE_ERR;
+	r.v.err = e;
+    }
+    resume_task(tw->the_vm, r);
+    free_task_waiting_on_connect(tw);
+}
 #endif /* OUTBOUND_NETWORK */
 
 static package
@@ -1837,56 +1925,51 @@ bf_open_network_connection(Var arglist, Byte next, void *vdata, Objid progr)
 {
 #ifdef OUTBOUND_NETWORK
 
-    Var r;
     enum error e;
     server_listener sl;
-    slistener l;
+    task_waiting_on_connect *tw;
 
     if (!is_wizard(progr)) {
         free_var(arglist);
         return make_error_pack(E_PERM);
     }
 
+    tw = (task_waiting_on_connect *)
+	mymalloc(sizeof(task_waiting_on_connect), M_TASK);
+    tw->has_listener = 0;
+
     if (arglist.v.list[0].v.num == 3) {
+	slistener *l;
 	Objid oid;
 
 	if (arglist.v.list[3].type != TYPE_OBJ) {
+	    myfree(tw, M_TASK);
+	    free_var(arglist);
 	    return make_error_pack(E_TYPE);
 	}
 	oid = arglist.v.list[3].v.obj;
 	arglist = listdelete(arglist, 3);
 
-	sl.ptr = find_slistener_by_oid(oid);
-	if (!sl.ptr) {
-	    /* Create a temporary */
-	    l.print_messages = 0;
-	    l.name = "open_network_connection";
-	    l.desc = zero;
-	    l.oid = oid;
-	    sl.ptr = &l;
-	}
-    } else {
-	sl.ptr = NULL;
+	/* Only the object and print_messages are looked at by
+	 * server_new_connection().
+	 */
+	l = find_slistener_by_oid(oid);
+	tw->listener.print_messages = l ? l->print_messages : 0;
+	tw->listener.name = "open_network_connection";
+	tw->listener.desc = zero;
+	tw->listener.oid = oid;
+	tw->has_listener = 1;
     }
+    sl.ptr = tw->has_listener ? &tw->listener : NULL;
 
-    e = network_open_connection(arglist, sl);
+    e = network_open_connection(arglist, sl, connection_opened, tw);
     free_var(arglist);
-    if (e == E_NONE) {
-	/* The connection was successfully opened, implying that
-	 * server_new_connection was called, implying and a new negative
-	 * player number was allocated for the connection.  Thus, the old
-	 * value of next_unconnected_player is the number of our connection.
-	 */
-	r.type = TYPE_OBJ;
-	r.v.obj = next_unconnected_player + 1;
-    } else {
-	r.type = TYPE_ERR;
-	r.v.err = e;
+    if (e != E_NONE) {
+	myfree(tw, M_TASK);
+	return make_error_pack(e);
     }
-    if (r.type == TYPE_ERR)
-	return make_error_pack(r.v.err);
-    else
-	return make_var_pack(r);
+
+    return make_suspend_pack(connect_waiter_suspender, tw);
 
 #else				/* !OUTBOUND_NETWORK */
 
@@ -2014,7 +2097,7 @@ bf_notify(Var arglist, Byte next, void *vdata, Objid progr)
 	    }
 	    r.v.num = network_send_bytes(h->nhandle, line, length, !no_flush);
 	} else
-	    r.v.num = network_send_line(h->nhandle, line, !no_flush);
+	    r.v.num = network_send_string(h->nhandle, line, !no_flush);
     } else {
 	if (in_emergency_mode)
 	    emergency_notify(conn, line);
@@ -2201,6 +2284,30 @@ bf_buffered_output_length(Var arglist, Byte next, void *vdata, Objid progr)
     return make_var_pack(r);
 }
 
+static package
+bf_connection_output_stats(Var arglist, Byte next, void *vdata, Objid progr)
+{				/* (connection) */
+    Objid conn = arglist.v.list[1].v.obj;
+    shandle *h = find_shandle(conn);
+    unsigned writes, bytes;
+    Var r;
+
+    free_var(arglist);
+    if (!h)
+	return make_error_pack(E_INVARG);
+    else if (progr != conn && !is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    network_output_stats(h->nhandle, &writes, &bytes);
+    r = new_list(2);
+    r.v.list[1].type = TYPE_INT;
+    r.v.list[1].v.num = writes > MAXINT ? MAXINT : writes;
+    r.v.list[2].type = TYPE_INT;
+    r.v.list[2].v.num = bytes > MAXINT ? MAXINT : bytes;
+
+    return make_var_pack(r);
+}
+
 static package
 bf_process_id(Var arglist, Byte next, void *vdata, Objid progr)
 {
@@ -2224,6 +2331,9 @@ register_server(void)
     register_function("shutdown", 0, 1, bf_shutdown, TYPE_STR);
     register_function("dump_database", 0, 0, bf_dump_database);
     register_function("db_disk_size", 0, 0, bf_db_disk_size);
+#ifdef OUTBOUND_NETWORK
+    register_task_queue(connect_waiter_enumerator);
+#endif
     register_function("open_network_connection", 0, -1,
 		      bf_open_network_connection);
     register_function("connected_players", 0, 1, bf_connected_players,
@@ -2245,4 +2355,6 @@ register_server(void)
     register_function("listeners", 0, 0, bf_listeners);
     register_function("buffered_output_length", 0, 1,
 		      bf_buffered_output_length, TYPE_OBJ);
+    register_function("connection_output_stats", 1, 1,
+		      bf_connection_output_stats, TYPE_OBJ);
 }
@@ -101,6 +101,12 @@ extern void server_resume_input(Objid connection);
 				 * tasks for the given connection.
 				 */
 
+extern int server_shutting_down(void);
+				/* True once a shutdown has been requested; the
+				 * server stops running tasks at the end of the
+				 * current pass of its main loop.
+				 */
+
 extern void set_server_cmdline(const char *line);
 				/* If possible, the server's command line, as
 				 * shown in the output of the `ps' command, is
@@ -209,7 +215,21 @@ extern int read_values_pending_finalization(void);
 								\
   DEFINE( SVO_MAX_CONCAT_CATCHABLE, max_concat_catchable,	\
 	  flag, 0, /* already canonical */			\
-	  )
+	  )							\
+								\
+  DEFINE( SVO_OPTIMIZE_BYTECODE, optimize_bytecode,		\
+	  flag, 0, /* already canonical */			\
+	  )							\
+								\
+  DEFINE( SVO_TASK_RUN_SLICE, task_run_slice,			\
+								\
+	  int, DEFAULT_TASK_RUN_SLICE,				\
+	 _STATEMENT({						\
+	     if (value < 0)					\
+		 value = 0;					\
+	     else if (MAX_TASK_RUN_SLICE < value)		\
+		 value = MAX_TASK_RUN_SLICE;			\
+	   }))
 
 /* List of all category (2) and (3) cached server options */
 enum Server_Option {
@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include "my-stdlib.h"
+#include "my-string.h"
 
 #include "config.h"
 #include "list.h"
@@ -35,15 +36,12 @@ refcount_overhead(Memory_Type type)
      * refcount slot for allocations that won't need it.
      */
     switch (type) {
-    /* deal with systems with picky alignment issues */
-    case M_FLOAT:
-	return MAX(sizeof(int), sizeof(double *));
     case M_LIST:
-#ifdef MEMO_VALUE_BYTES
-	return MAX(sizeof(int), sizeof(Var *)) * 2;
-#else
-	return MAX(sizeof(int), sizeof(Var *));
-#endif /* MEMO_VALUE_BYTES */
+	/* refcount, memoized size and capacity (see list.cc), rounded
+	 * up to keep the elements aligned
+	 */
+	return (sizeof(int) * 3 + sizeof(Var *) - 1)
+	       / sizeof(Var *) * sizeof(Var *);
     case M_TREE:
 #ifdef MEMO_VALUE_BYTES
 	return MAX(sizeof(int), sizeof(rbtree *)) * 2;
@@ -53,11 +51,8 @@ refcount_overhead(Memory_Type type)
     case M_TRAV:
 	return MAX(sizeof(int), sizeof(rbtrav *));
     case M_STRING:
-#ifdef MEMO_STRLEN
-	return sizeof(int) * 2;
-#else
-	return sizeof(int);
-#endif /* MEMO_STRLEN */
+	/* refcount, memoized length and capacity */
+	return sizeof(int) * 3;
     case M_ANON:
 	return MAX(sizeof(int), sizeof(struct Object *));
     default:
@@ -65,6 +60,113 @@ refcount_overhead(Memory_Type type)
     }
 }
 
+/*
+ * Allocations of the types below carry a header (in front of the
+ * reference count overhead) recording their size, so that they can be
+ * counted by `memory_usage()' and, with MEMORY_POOLS, recycled through
+ * free lists of blocks in a handful of size classes.
+ */
+
+typedef union pool_header {
+    unsigned size;		/* as passed to mymalloc()/myrealloc() */
+    union pool_header *next;	/* when on a free list */
+    double align;
+} pool_header;
+
+#define POOL_GRAIN		16
+#define POOL_CLASSES		32	/* blocks of up to 512 bytes */
+#define POOL_CHUNK_SIZE		(64 * 1024)
+
+static pool_header *pool_free_list[POOL_CLASSES + 1];
+static unsigned pool_nfree[POOL_CLASSES + 1];
+static unsigned pool_nblocks[POOL_CLASSES + 1];
+
+static unsigned live_bytes[Sizeof_Memory_Type];
+static unsigned peak_bytes[Sizeof_Memory_Type];
+
+static inline bool
+counted_type(Memory_Type type)
+{
+    switch (type) {
+    case M_STRING:
+    case M_LIST:
+    case M_TREE:
+    case M_TASK:
+    case M_NETWORK:
+	return true;
+    default:
+	return false;
+    }
+}
+
+/* The size class of a block holding `size' bytes, header and all, or 0
+ * if it is too big for the pools (or there are no pools).
+ */
+static inline int
+pool_class(unsigned size)
+{
+#ifdef MEMORY_POOLS
+    int c = (size + POOL_GRAIN - 1) / POOL_GRAIN;
+
+    return c <= POOL_CLASSES ? c : 0;
+#else
+    return 0;
+#endif
+}
+
+static pool_header *
+pool_alloc(unsigned size)
+{
+    int c = pool_class(size);
+    pool_header *h;
+
+    if (!c)
+	return (pool_header *) malloc(size);
+
+    if (!pool_free_list[c]) {
+	int block = c * POOL_GRAIN;
+	int n = POOL_CHUNK_SIZE / block;
+	char *chunk = (char *) malloc(n * block);
+
+	if (!chunk)
+	    return 0;
+	while (n--) {
+	    h = (pool_header *) (chunk + n * block);
+	    h->next = pool_free_list[c];
+	    pool_free_list[c] = h;
+	    pool_nfree[c]++;
+	    pool_nblocks[c]++;
+	}
+    }
+    h = pool_free_list[c];
+    pool_free_list[c] = h->next;
+    pool_nfree[c]--;
+
+    return h;
+}
+
+static void
+pool_free(pool_header *h, unsigned size)
+{
+    int c = pool_class(size);
+
+    if (!c)
+	free(h);
+    else {
+	h->next = pool_free_list[c];
+	pool_free_list[c] = h;
+	pool_nfree[c]++;
+    }
+}
+
+static inline void
+count_bytes(Memory_Type type, int delta)
+{
+    live_bytes[type] += delta;
+    if (live_bytes[type] > peak_bytes[type])
+	peak_bytes[type] = live_bytes[type];
+}
+
 void *
 mymalloc(unsigned size, Memory_Type type)
 {
@@ -76,7 +178,16 @@ mymalloc(unsigned size, Memory_Type type)
 	size = 1;
 
     offs = refcount_overhead(type);
-    memptr = (char *) malloc(offs + size);
+    if (counted_type(type)) {
+	pool_header *h = pool_alloc(sizeof(pool_header) + offs + size);
+
+	if ((memptr = (char *) h)) {
+	    h->size = size;
+	    memptr += sizeof(pool_header);
+	    count_bytes(type, size);
+	}
+    } else
+	memptr = (char *) malloc(offs + size);
     if (!memptr) {
 	sprintf(msg, "memory allocation (size %u) failed!", size);
 	panic(msg);
@@ -90,10 +201,12 @@ mymalloc(unsigned size, Memory_Type type)
 	((reference_overhead *)memptr)[-1].buffered = 0;
 	((reference_overhead *)memptr)[-1].color = (type == M_ANON) ? GC_BLACK : GC_GREEN;
 #endif /* ENABLE_GC */
+	if (type == M_STRING) {
 #ifdef MEMO_STRLEN
-	if (type == M_STRING)
 	    ((int *) memptr)[-2] = size - 1;
 #endif /* MEMO_STRLEN */
+	    str_capacity(memptr) = size - 1;
+	}
 #ifdef MEMO_VALUE_BYTES
 	if (type == M_LIST)
 	    ((int *) memptr)[-2] = 0;
@@ -132,13 +245,62 @@ str_dup(const char *s)
     return r;
 }
 
+char *
+str_append(char *s, int slen, const char *t, int tlen)
+{
+    int len = slen + tlen;
+    int capacity = str_capacity(s);
+
+    if (len > capacity) {
+	capacity = MAX(capacity * 2, 16);
+	if (capacity < len)
+	    capacity = len;
+	s = (char *) myrealloc(s, capacity + 1, M_STRING);
+	str_capacity(s) = capacity;
+    }
+    memcpy(s + slen, t, tlen);
+    s[len] = '\0';
+#ifdef MEMO_STRLEN
+    ((int *) s)[-2] = len;
+#endif /* MEMO_STRLEN */
+
+    return s;
+}
+
 void *
 myrealloc(void *ptr, unsigned size, Memory_Type type)
 {
     int offs = refcount_overhead(type);
     static char msg[100];
 
-    ptr = realloc((char *) ptr - offs, size + offs);
+    if (counted_type(type)) {
+	pool_header *h = (pool_header *) ((char *) ptr - offs) - 1;
+	unsigned old_size = h->size;
+	int old_class = pool_class(sizeof(pool_header) + offs + old_size);
+	int new_class = pool_class(sizeof(pool_header) + offs + size);
+
+	if (old_class && old_class == new_class)
+	    ;			/* still fits */
+	else if (!old_class && !new_class)
+	    h = (pool_header *) realloc(h, sizeof(pool_header) + offs + size);
+	else {
+	    pool_header *_new = pool_alloc(sizeof(pool_header) + offs + size);
+
+	    if (_new) {
+		memcpy(_new, h, sizeof(pool_header) + offs
+				 + MIN(old_size, size));
+		pool_free(h, sizeof(pool_header) + offs + old_size);
+	    }
+	    h = _new;
+	}
+	if (h) {
+	    h->size = size;
+	    count_bytes(type, (int) size - (int) old_size);
+	    ptr = h + 1;
+	} else
+	    ptr = 0;
+    } else
+	ptr = realloc((char *) ptr - offs, size + offs);
     if (!ptr) {
 	sprintf(msg, "memory re-allocation (size %u) failed!", size);
 	panic(msg);
@@ -150,9 +312,66 @@ myrealloc(void *ptr, unsigned size, Memory_Type type)
 void
 myfree(void *ptr, Memory_Type type)
 {
+    int offs = refcount_overhead(type);
+
     alloc_num[type]--;
 
-    free((char *) ptr - refcount_overhead(type));
+    if (counted_type(type)) {
+	pool_header *h = (pool_header *) ((char *) ptr - offs) - 1;
+
+	live_bytes[type] -= h->size;
+	pool_free(h, sizeof(pool_header) + offs + h->size);
+    } else
+	free((char *) ptr - offs);
+}
+
+Var
+memory_usage(void)
+{
+    static const struct {
+	Memory_Type type;
+	const char *name;
+    } types[] = {
+	{ M_STRING, "string" },
+	{ M_LIST, "list" },
+	{ M_TREE, "map" },
+	{ M_TASK, "task" },
+	{ M_NETWORK, "network" },
+    };
+    int ntypes = sizeof(types) / sizeof(*types);
+    int i, c, nclasses = 0;
+    Var r, v;
+
+    for (c = 1; c <= POOL_CLASSES; c++)
+	if (pool_nblocks[c])
+	    nclasses++;
+
+    r = new_list(2);
+    r.v.list[1] = new_list(ntypes);
+    r.v.list[2] = new_list(nclasses);
+
+    for (i = 0; i < ntypes; i++) {
+	Memory_Type type = types[i].type;
+
+	v = new_list(4);
+	v.v.list[1].type = TYPE_STR;
+	v.v.list[1].v.str = str_dup(types[i].name);
+	v.v.list[2] = Var::new_int(alloc_num[type]);
+	v.v.list[3] = Var::new_int(live_bytes[type]);
+	v.v.list[4] = Var::new_int(peak_bytes[type]);
+	r.v.list[1].v.list[i + 1] = v;
+    }
+
+    for (c = 1, i = 1; c <= POOL_CLASSES; c++)
+	if (pool_nblocks[c]) {
+	    v = new_list(3);
+	    v.v.list[1] = Var::new_int(c * POOL_GRAIN);
+	    v.v.list[2] = Var::new_int(pool_nblocks[c] - pool_nfree[c]);
+	    v.v.list[3] = Var::new_int(pool_nfree[c]);
+	    r.v.list[2].v.list[i++] = v;
+	}
+
+    return r;
 }
 
 /* XXX stupid fix for non-gcc compilers, already in storage.h */
@@ -100,10 +100,12 @@ typedef enum Memory_Type {
 
     M_RT_STACK, M_RT_ENV, M_BI_FUNC_DATA, M_VM,
 
-    M_REF_ENTRY, M_REF_TABLE, M_VC_ENTRY, M_VC_TABLE, M_STRING_PTRS,
+    M_REF_ENTRY, M_REF_TABLE, M_VC_ENTRY, M_VC_TABLE, M_PROP_CACHE,
+    M_ANCESTORS,
+    M_STRING_PTRS,
     M_INTERN_POINTER, M_INTERN_ENTRY, M_INTERN_HUNK,
 
-    M_TREE, M_NODE, M_TRAV,
+    M_TREE, M_NODE, M_TRAV, M_MAP_INDEX,
 
     M_ANON, /* anonymous object */
 
@@ -116,11 +118,29 @@ typedef enum Memory_Type {
 
 extern char *str_dup(const char *);
 extern const char *str_ref(const char *);
+extern char *str_append(char *s, int slen, const char *t, int tlen);
+				/* Appends the `tlen' characters of `t' to
+				 * `s' (which is `slen' characters long) in
+				 * place and returns the result, which may
+				 * have moved.  `s' must not be referenced
+				 * from anywhere else.  Strings grow
+				 * geometrically, so building one up a piece
+				 * at a time costs amortized linear time.
+				 */
 
 extern void myfree(void *where, Memory_Type type);
 extern void *mymalloc(unsigned size, Memory_Type type);
 extern void *myrealloc(void *where, unsigned size, Memory_Type type);
 
+struct Var;
+extern struct Var memory_usage(void);
+				/* Returns {TYPES, POOLS}: a list of
+				 * {name, blocks, bytes, peak bytes} for each
+				 * type of memory that is counted, and a list
+				 * of {block size, used, free} for each size
+				 * class of pooled blocks.
+				 */
+
 static inline void		/* XXX was extern, fix for non-gcc compilers */
 free_str(const char *s)
 {
@@ -139,4 +159,10 @@ free_str(const char *s)
 
 #endif /* MEMO_STRLEN */
 
+/*
+ * The number of characters (not counting the terminating null) a string's
+ * allocation has room for, kept in the storage below the memoized length.
+ */
+#define str_capacity(X)		(((int *)(X))[-3])
+
 #endif				/* Storage_h */
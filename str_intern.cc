@@ -120,6 +120,7 @@ str_intern_open(int table_size)
     }
     intern_table = make_intern_table(table_size);
     intern_table_size = table_size;
+    intern_table_count = 0;
     
     intern_bytes_saved = 0;
     intern_allocations_saved = 0;
@@ -16,6 +16,7 @@
  *****************************************************************************/
 
 #include <float.h>
+#include <stdint.h>
 #include "my-stdarg.h"
 #include "my-string.h"
 #include "my-stdio.h"
@@ -108,38 +109,41 @@ stream_add_string(Stream * s, const char *string)
     s->current += len;
 }
 
+void
+stream_add_bytes(Stream * s, const char *bytes, int len)
+{
+    if (s->current + len >= s->buflen) {
+	int newlen = s->buflen * 2;
+
+	if (newlen <= s->current + len)
+	    newlen = s->current + len + 1;
+	grow(s, newlen, len);
+    }
+    memcpy(s->buffer + s->current, bytes, len);
+    s->current += len;
+}
+
 static const char *
-itoa(int n, int radix)
+itoa(intmax_t n, int radix)
 {
     if (n == 0)			/* zero produces "" below. */
 	return "0";
-    else if (n == -2147483647 - 1)	/* min. integer won't work below. */
-	switch (radix) {
-	case 16:
-	    return "-7FFFFFFF";
-	case 10:
-	    return "-2147483648";
-	case 8:
-	    return "-17777777777";
-	default:
-	    errlog("STREAM_PRINTF: Illegal radix %d!\n", radix);
-	    return "0";
+    else if (radix != 8 && radix != 10 && radix != 16) {
+	errlog("STREAM_PRINTF: Illegal radix %d!\n", radix);
+	return "0";
     } else {
-	static char buffer[20];
-	char *ptr = buffer + 19;
-	int neg = 0;
+	static char buffer[32];
+	char *ptr = buffer + 31;
+	/* negate as unsigned, so that the minimum integer works too */
+	uintmax_t u = (n < 0 ? -(uintmax_t) n : (uintmax_t) n);
 
-	if (n < 0) {
-	    neg = 1;
-	    n = -n;
-	}
 	*(ptr) = '\0';
-	while (n != 0) {
-	    int digit = n % radix;
+	while (u != 0) {
+	    int digit = u % radix;
 	    *(--ptr) = (digit < 10 ? '0' + digit : 'A' + digit - 10);
-	    n /= radix;
+	    u /= radix;
 	}
-	if (neg)
+	if (n < 0)
 	    *(--ptr) = '-';
 	return ptr;
     }
@@ -170,7 +174,7 @@ stream_printf(Stream * s, const char *fmt,...)
 
 	if (c == '%') {
 	    char pad = ' ';
-	    int width = 0, base;
+	    int width = 0, base, longs = 0;
 	    const char *string = "";	/* initialized to silence warning */
 
 	    while ((c = *(++fmt)) != '\0') {
@@ -187,8 +191,13 @@ stream_printf(Stream * s, const char *fmt,...)
 		case 'd':
 		    base = 10;
 		  finish_number:
-		    string = itoa(va_arg(args, int), base);
+		    string = itoa(longs == 0 ? va_arg(args, int)
+				  : longs == 1 ? va_arg(args, long)
+				  : va_arg(args, long long), base);
 		    break;
+		case 'l':
+		    longs++;
+		    continue;
 		case 'g':
 		    sprintf(buffer, dbl_fmt(), va_arg(args, double));
 		    if (!strchr(buffer, '.') && !strchr(buffer, 'e'))
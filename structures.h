@@ -20,22 +20,35 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
 
 #include "my-stdio.h"
 
 #include "config.h"
+#include "options.h"
 
 #include "storage.h"
 
-#define MAXINT	((int32) 2147483647L)
-#define MININT	((int32) -2147483648L)
-#define MAXOBJ	((Objid) MAXINT)
-#define MINOBJ	((Objid) MININT)
-
+#ifdef INT64_NUM
+typedef int64_t Num;
+typedef uint64_t UNum;
+#define MAXINT	((Num) INT64_MAX)
+#define MININT	((Num) INT64_MIN)
+#define PRIdN	PRId64		/* printf() and dbio_scanf() formats for Num */
+#define SCNdN	SCNd64
+#else
 typedef int32_t Num;
 typedef uint32_t UNum;
+#define MAXINT	((Num) INT32_MAX)
+#define MININT	((Num) INT32_MIN)
+#define PRIdN	PRId32
+#define SCNdN	SCNd32
+#endif
 typedef Num Objid;
 
+#define MAXOBJ	((Objid) MAXINT)
+#define MINOBJ	((Objid) MININT)
+
 /*
  * Special Objid's
  */
@@ -84,8 +97,8 @@ typedef enum {
     _TYPE_ITER,			/* map iterator; not visible */
     _TYPE_ANON,			/* anonymous object; user-visible */
     /* THE END - complex aliases come next */
+    TYPE_FLOAT = _TYPE_FLOAT,	/* held in the Var itself, not allocated */
     TYPE_STR = (_TYPE_STR | TYPE_COMPLEX_FLAG),
-    TYPE_FLOAT = (_TYPE_FLOAT | TYPE_COMPLEX_FLAG),
     TYPE_LIST = (_TYPE_LIST | TYPE_COMPLEX_FLAG),
     TYPE_MAP = (_TYPE_MAP | TYPE_COMPLEX_FLAG),
     TYPE_ITER = (_TYPE_ITER | TYPE_COMPLEX_FLAG),
@@ -124,13 +137,13 @@ typedef struct Object Object;
 struct Var {
     union {
 	const char *str;	/* STR */
-	int32 num;		/* NUM, CATCH, FINALLY */
+	Num num;		/* NUM, CATCH, FINALLY */
 	Objid obj;		/* OBJ */
 	enum error err;		/* ERR */
 	Var *list;		/* LIST */
 	rbtree *tree;		/* MAP */
 	rbtrav *trav;		/* ITER */
-	double *fnum;		/* FLOAT */
+	double fnum;		/* FLOAT */
 	Object *anon;		/* ANON */
     } v;
     var_type type;
@@ -164,7 +177,7 @@ struct Var {
     }
 
     static Var
-    new_int(int32 num) {
+    new_int(Num num) {
 	Var v;
 	v.type = TYPE_INT;
 	v.v.num = num;
@@ -42,6 +42,7 @@
 #include "streams.h"
 #include "structures.h"
 #include "tasks.h"
+#include "timers.h"
 #include "utils.h"
 #include "verbs.h"
 #include "version.h"
@@ -63,12 +64,12 @@ typedef struct forked_task {
     activation a;
     Var *rt_env;
     int f_index;
-    time_t start_time;
+    int64_t start_ms;		/* see `task_clock()' */
 } forked_task;
 
 typedef struct suspended_task {
     vm the_vm;
-    time_t start_time;
+    int64_t start_ms;
     Var value;
 } suspended_task;
 
@@ -81,6 +82,8 @@ typedef struct {
 typedef struct task {
     struct task *next;
     task_kind kind;
+    int wait_pos;		/* index in `waiting_tasks' while waiting */
+    unsigned wait_seq;		/* orders tasks with equal start times */
     union {
 	input_task input;
 	forked_task forked;
@@ -88,10 +91,56 @@ typedef struct task {
     } t;
 } task;
 
-inline time_t
+inline int64_t
 get_start_time(task *t)
 {
-    return t->kind == TASK_FORKED ? t->t.forked.start_time : t->t.suspended.start_time;
+    return t->kind == TASK_FORKED ? t->t.forked.start_ms : t->t.suspended.start_ms;
+}
+
+/* Start times are kept in milliseconds on the monotonic clock, so that
+ * setting the system time doesn't make waiting tasks run early or late.
+ * They're reported (and written to the database) as whole seconds of
+ * wall-clock time, as they always have been.  A start time of zero
+ * means `right away' and FOREVER_MS means `never'.
+ */
+#define FOREVER_MS	INT64_MAX
+
+static inline int64_t
+task_clock(void)
+{
+    return monotonic_msecs();
+}
+
+static int
+start_seconds(int64_t start_ms)
+{
+    int64_t secs, delta;
+
+    if (start_ms <= 0)
+	return 0;
+    if (start_ms == FOREVER_MS)
+	return INT32_MAX;
+    delta = start_ms - task_clock();
+    secs = time(0) + (delta > 0 ? (delta + 999) / 1000 : delta / 1000);
+    return secs < 0 ? 0 : secs > INT32_MAX ? INT32_MAX : (int) secs;
+}
+
+static int64_t
+start_msecs(int seconds)
+{				/* the inverse of `start_seconds()' */
+    if (seconds <= 0)
+	return 0;
+    if (seconds == INT32_MAX)
+	return FOREVER_MS;
+    return task_clock() + ((int64_t) seconds - time(0)) * 1000;
+}
+
+static inline int64_t
+after_ms(double seconds)
+{				/* `seconds' from now, saturating at `forever' */
+    if (seconds >= INT32_MAX)
+	return FOREVER_MS;
+    return task_clock() + (int64_t)(seconds * 1000 + 0.5);
 }
 
 enum icmd_flag {
@@ -214,7 +263,23 @@ typedef struct ext_queue {
 Var current_local;
 int current_task_id;
 static tqueue *idle_tqueues = 0, *active_tqueues = 0;
-static task *waiting_tasks = 0;	/* forked and suspended tasks */
+
+/* Statistics for `task_run_stats()', about the passes of
+ * `run_ready_tasks()' that ran at least one task.
+ */
+static struct {
+    int passes;			/* number of such passes */
+    int tasks;			/* tasks run by them */
+    int last_tasks, max_tasks;	/* tasks run in a single pass */
+    int last_depth, max_depth;	/* active tqueues at the start of a pass */
+} run_stats;
+/* Forked and suspended tasks that aren't ready to run yet, kept as a
+ * binary heap ordered by start time (and, for equal start times, by
+ * the order in which they were queued).
+ */
+static task **waiting_tasks = 0;
+static int num_waiting = 0, max_waiting = 0;
+static unsigned waiting_seq = 0;
 static ext_queue *external_queues = 0;
 
 /*
@@ -1124,34 +1189,110 @@ new_input_task(task_queue q, const char *input, int binary)
     enqueue_input_task(tq, input, 0/*at-rear*/, binary);
 }
 
+static inline int
+waits_before(task * a, task * b)
+{
+    int64_t sa = get_start_time(a), sb = get_start_time(b);
+
+    return sa < sb || (sa == sb && (int) (a->wait_seq - b->wait_seq) < 0);
+}
+
+static inline void
+place_waiting(task * t, int i)
+{
+    waiting_tasks[i] = t;
+    t->wait_pos = i;
+}
+
+static void
+sift_waiting(int i)
+{				/* restore the heap after waiting_tasks[i] moved */
+    task *t = waiting_tasks[i];
+
+    while (i > 0 && waits_before(t, waiting_tasks[(i - 1) / 2])) {
+	place_waiting(waiting_tasks[(i - 1) / 2], i);
+	i = (i - 1) / 2;
+    }
+    for (;;) {
+	int c = 2 * i + 1;
+
+	if (c >= num_waiting)
+	    break;
+	if (c + 1 < num_waiting
+	    && waits_before(waiting_tasks[c + 1], waiting_tasks[c]))
+	    c++;
+	if (!waits_before(waiting_tasks[c], t))
+	    break;
+	place_waiting(waiting_tasks[c], i);
+	i = c;
+    }
+    place_waiting(t, i);
+}
+
+static task *
+dequeue_waiting(int i)
+{				/* remove and return waiting_tasks[i] */
+    task *t = waiting_tasks[i];
+
+    if (--num_waiting > i) {
+	place_waiting(waiting_tasks[num_waiting], i);
+	sift_waiting(i);
+    }
+    t->next = 0;
+    return t;
+}
+
 static void
 enqueue_waiting(task * t)
 {				/* either FORKED or SUSPENDED */
-
-    time_t start_time = get_start_time(t);
     Objid progr = (t->kind == TASK_FORKED
 		   ? t->t.forked.a.progr
 		   : progr_of_cur_verb(t->t.suspended.the_vm));
     tqueue *tq = find_tqueue(progr, 1);
 
     tq->num_bg_tasks++;
-    if (!waiting_tasks || start_time < get_start_time(waiting_tasks)) {
-	t->next = waiting_tasks;
-	waiting_tasks = t;
-    } else {
-	task *tt;
-
-	for (tt = waiting_tasks; tt->next; tt = tt->next)
-	    if (start_time < get_start_time(tt->next))
-		break;
-	t->next = tt->next;
-	tt->next = t;
+    if (num_waiting == max_waiting) {
+	if (!waiting_tasks) {
+	    max_waiting = 64;
+	    waiting_tasks = (task **)mymalloc(max_waiting * sizeof(task *),
+					      M_TASK);
+	} else {
+	    max_waiting *= 2;
+	    waiting_tasks = (task **)myrealloc(waiting_tasks,
+					       max_waiting * sizeof(task *),
+					       M_TASK);
+	}
     }
+    t->next = 0;
+    t->wait_seq = waiting_seq++;
+    place_waiting(t, num_waiting++);
+    sift_waiting(num_waiting - 1);
+}
+
+static int
+cmp_waiting(const void *a, const void *b)
+{
+    task *ta = *(task **) a, *tb = *(task **) b;
+
+    return waits_before(ta, tb) ? -1 : waits_before(tb, ta) ? 1 : 0;
+}
+
+static task **
+sorted_waiting_tasks(void)
+{				/* a copy of `waiting_tasks' in start order */
+    task **sorted;
+
+    if (num_waiting == 0)
+	return 0;
+    sorted = (task **)mymalloc(num_waiting * sizeof(task *), M_TASK);
+    memcpy(sorted, waiting_tasks, num_waiting * sizeof(task *));
+    qsort(sorted, num_waiting, sizeof(task *), cmp_waiting);
+    return sorted;
 }
 
 static void
 enqueue_forked(Program * program, activation a, Var * rt_env,
-	   int f_index, time_t start_time, int id)
+	   int f_index, int64_t start_ms, int id)
 {
     task *t = (task *)mymalloc(sizeof(task), M_TASK);
 
@@ -1170,7 +1311,7 @@ enqueue_forked(Program * program, activation a, Var * rt_env,
     t->t.forked.a = a;
     t->t.forked.rt_env = rt_env;
     t->t.forked.f_index = f_index;
-    t->t.forked.start_time = start_time;
+    t->t.forked.start_ms = start_ms;
     t->t.forked.id = id;
 
     enqueue_waiting(t);
@@ -1200,7 +1341,7 @@ check_user_task_limit(Objid user)
 }
 
 enum error
-enqueue_forked_task2(activation a, int f_index, unsigned after_seconds, int vid)
+enqueue_forked_task2(activation a, int f_index, double after_seconds, int vid)
 {
     int id;
     Var *rt_env;
@@ -1230,7 +1371,7 @@ enqueue_forked_task2(activation a, int f_index, unsigned after_seconds, int vid)
 	a.rt_env[vid].v.num = id;
     }
     rt_env = copy_rt_env(a.rt_env, a.prog->num_var_names);
-    enqueue_forked(a.prog, a, rt_env, f_index, time(0) + after_seconds, id);
+    enqueue_forked(a.prog, a, rt_env, f_index, after_ms(after_seconds), id);
 
     return E_NONE;
 }
@@ -1238,21 +1379,18 @@ enqueue_forked_task2(activation a, int f_index, unsigned after_seconds, int vid)
 enum error
 enqueue_suspended_task(vm the_vm, void *data)
 {
-    int after_seconds = *((int *) data);
-    int now = time(0);
-    int when;
+    double after_seconds = *((double *) data);
     task *t;
 
     if (check_user_task_limit(progr_of_cur_verb(the_vm))) {
 	t = (task *)mymalloc(sizeof(task), M_TASK);
 	t->kind = TASK_SUSPENDED;
 	t->t.suspended.the_vm = the_vm;
-	if (now + after_seconds < now)
-	    /* overflow or suspend `forever' code */
-	    when = INT32_MAX;
+	if (after_seconds < 0)
+	    /* suspend `forever' code */
+	    t->t.suspended.start_ms = FOREVER_MS;
 	else
-	    when = now + after_seconds;
-	t->t.suspended.start_time = when;
+	    t->t.suspended.start_ms = after_ms(after_seconds);
 	t->t.suspended.value = zero;
 
 	enqueue_waiting(t);
@@ -1270,7 +1408,7 @@ resume_task(vm the_vm, Var value)
 
     t->kind = TASK_SUSPENDED;
     t->t.suspended.the_vm = the_vm;
-    t->t.suspended.start_time = 0;	/* ready now */
+    t->t.suspended.start_ms = 0;	/* ready now */
     t->t.suspended.value = value;
 
     enqueue_bg_task(tq, t);
@@ -1378,11 +1516,10 @@ next_task_start(void)
 	if (tq->first_input != 0 || tq->first_bg != 0)
 	    return 0;
 
-    if (waiting_tasks != 0) {
-	int wait = (waiting_tasks->kind == TASK_FORKED
-		    ? waiting_tasks->t.forked.start_time
-		    : waiting_tasks->t.suspended.start_time) - time(0);
-	return (wait >= 0) ? wait : 0;
+    if (num_waiting > 0) {
+	int64_t wait = get_start_time(waiting_tasks[0]) - task_clock();
+
+	return wait <= 0 ? 0 : wait > INT32_MAX ? INT32_MAX : (int) wait;
     }
     return -1;
 }
@@ -1562,25 +1699,30 @@ static http_parser_settings settings = {on_message_begin_callback,
 void
 run_ready_tasks(void)
 {
-    task *t, *next_t;
-    time_t now = time(0);
+    task *t;
+    int64_t now = task_clock();
     tqueue *tq, *next_tq;
 
-    for (t = waiting_tasks; t && get_start_time(t) <= now; t = next_t) {
+    while (num_waiting > 0 && get_start_time(waiting_tasks[0]) <= now) {
+	t = dequeue_waiting(0);
+
 	Objid progr = (t->kind == TASK_FORKED
 		       ? t->t.forked.a.progr
 		       : progr_of_cur_verb(t->t.suspended.the_vm));
 	tqueue *tq = find_tqueue(progr, 1);
 
-	next_t = t->next;
 	ensure_usage(tq);
 	enqueue_bg_task(tq, t);
     }
-    waiting_tasks = t;
 
     {
 	int did_one = 0;
-	time_t start = time(0);
+	int64_t start = task_clock(), slice_start = start;
+	int slice = server_int_option_cached(SVO_TASK_RUN_SLICE);
+	int ran = 0, depth = 0;
+
+	for (tq = active_tqueues; tq; tq = tq->next)
+	    depth++;
 
 	/* Loop over tqueues, looking for a task */
 	while (active_tqueues && !did_one) {
@@ -1733,16 +1875,41 @@ run_ready_tasks(void)
 	    active_tqueues = tq->next;
 
 	    if (did_one) {
-		/* Bump the usage level of this tqueue */
-		time_t end = time(0);
+		/* Bump the usage level of this tqueue (by the number of
+		 * second boundaries the task ran across)
+		 */
+		int64_t end = task_clock();
 
-		tq->usage += end - start;
+		tq->usage += end / 1000 - start / 1000;
 		activate_tqueue(tq);
+		ran++;
+
+		/* If there's time left in the slice, go round again for
+		 * the next task.  `activate_tqueue()' put this tqueue
+		 * behind any others with the same usage, so they take
+		 * turns.
+		 */
+		if (slice > 0 && !server_shutting_down()
+		    && end - slice_start < slice) {
+		    did_one = 0;
+		    start = end;
+		}
 	    } else {
 		/* There was nothing to do on this tqueue, so deactivate it */
 		deactivate_tqueue(tq);
 	    }
 	}
+
+	if (ran) {
+	    run_stats.passes++;
+	    run_stats.tasks += ran;
+	    run_stats.last_tasks = ran;
+	    if (ran > run_stats.max_tasks)
+		run_stats.max_tasks = ran;
+	    run_stats.last_depth = depth;
+	    if (depth > run_stats.max_depth)
+		run_stats.max_depth = depth;
+	}
     }
 
     /* Free any unconnected and empty tqueues */
@@ -1837,7 +2004,7 @@ write_forked_task(forked_task ft)
 {
     unsigned lineno = find_line_number(ft.program, ft.f_index, 0);
 
-    dbio_printf("0 %d %d %d\n", lineno, ft.start_time, ft.id);
+    dbio_printf("0 %d %d %d\n", lineno, start_seconds(ft.start_ms), ft.id);
     write_activ_as_pi(ft.a);
     write_rt_env(ft.program->var_names, ft.rt_env, ft.program->num_var_names);
     dbio_write_forked_program(ft.program, ft.f_index);
@@ -1846,7 +2013,7 @@ write_forked_task(forked_task ft)
 static void
 write_suspended_task(suspended_task st)
 {
-    dbio_printf("%d %d ", st.start_time, st.the_vm->task_id);
+    dbio_printf("%d %d ", start_seconds(st.start_ms), st.the_vm->task_id);
     dbio_write_var(st.value);
     write_vm(st.the_vm);
 }
@@ -1856,13 +2023,20 @@ write_task_queue(void)
 {
     int forked_count = 0;
     int suspended_count = 0;
-    task *t;
+    task *t, **sorted;
     tqueue *tq;
+    int w;
 
     dbio_printf("0 clocks\n");	/* for compatibility's sake */
 
-    for (t = waiting_tasks; t; t = t->next)
-	if (t->kind == TASK_FORKED)
+    /* The DB only keeps start times to the second, so waiting tasks are
+     * written in the order they'll start; that way tasks due in the same
+     * second still run first in, first out once they're read back.
+     */
+    sorted = sorted_waiting_tasks();
+
+    for (w = 0; w < num_waiting; w++)
+	if (waiting_tasks[w]->kind == TASK_FORKED)
 	    forked_count++;
 	else			/* t->kind == TASK_SUSPENDED */
 	    suspended_count++;
@@ -1876,8 +2050,8 @@ write_task_queue(void)
 
     dbio_printf("%d queued tasks\n", forked_count);
 
-    for (t = waiting_tasks; t; t = t->next)
-	if (t->kind == TASK_FORKED)
+    for (w = 0; w < num_waiting; w++)
+	if ((t = sorted[w])->kind == TASK_FORKED)
 	    write_forked_task(t->t.forked);
 
     for (tq = active_tqueues; tq; tq = tq->next)
@@ -1887,9 +2061,11 @@ write_task_queue(void)
 
     dbio_printf("%d suspended tasks\n", suspended_count);
 
-    for (t = waiting_tasks; t; t = t->next)
-	if (t->kind == TASK_SUSPENDED)
+    for (w = 0; w < num_waiting; w++)
+	if ((t = sorted[w])->kind == TASK_SUSPENDED)
 	    write_suspended_task(t->t.suspended);
+    if (sorted)
+	myfree(sorted, M_TASK);
 
     for (tq = active_tqueues; tq; tq = tq->next)
 	for (t = tq->first_bg; t; t = t->next)
@@ -1897,8 +2073,8 @@ write_task_queue(void)
 		write_suspended_task(t->t.suspended);
 
     /* All tasks held in external queues are interrupted -- this
-     * currently comprises tasks that are waiting on a fork/exec that
-     * has not completed.
+     * currently comprises tasks that are waiting on a fork/exec or an
+     * outbound network connection that has not completed.
      */
     int interrupted_count = 0;
     struct qcl_data qdata;
@@ -1964,7 +2140,7 @@ read_task_queue(void)
     for (; count > 0; count--) {
 	int first_lineno, id, old_size, st;
 	char c;
-	time_t start_time;
+	int64_t start_ms;
 	Program *program;
 	Var *rt_env, *old_rt_env;
 	const char **old_names;
@@ -1976,7 +2152,7 @@ read_task_queue(void)
 	    errlog("READ_TASK_QUEUE: Bad numbers, count = %d.\n", count);
 	    return 0;
 	}
-	start_time = st;
+	start_ms = start_msecs(st);
 	if (!read_activ_as_pi(&a)) {
 	    errlog("READ_TASK_QUEUE: Bad activation, count = %d.\n", count);
 	    return 0;
@@ -1994,7 +2170,7 @@ read_task_queue(void)
 	rt_env = reorder_rt_env(old_rt_env, old_names, old_size, program);
 	program->first_lineno = first_lineno;
 
-	enqueue_forked(program, a, rt_env, MAIN_VECTOR, start_time, id);
+	enqueue_forked(program, a, rt_env, MAIN_VECTOR, start_ms, id);
     }
 
     suspended_task_header = dbio_scanf("%d suspended tasks\n",
@@ -2016,7 +2192,7 @@ read_task_queue(void)
 		   suspended_count);
 	    return 0;
 	}
-	t->t.suspended.start_time = start_time;
+	t->t.suspended.start_ms = start_msecs(start_time);
 	if (c == ' ')
 	    t->t.suspended.value = dbio_read_var();
 	else if (c == '\n')
@@ -2070,7 +2246,7 @@ read_task_queue(void)
 
 	task *t = (task *)mymalloc(sizeof(task), M_TASK);
 	t->kind = TASK_SUSPENDED;
-	t->t.suspended.start_time = 0;
+	t->t.suspended.start_ms = 0;
 	t->t.suspended.value.type = TYPE_ERR;
 	t->t.suspended.value.v.err = E_INTRPT;
 	t->t.suspended.the_vm = the_vm;
@@ -2190,6 +2366,27 @@ bf_queue_info(Var arglist, Byte next, void *vdata, Objid progr)
     return make_var_pack(res);
 }
 
+static package
+bf_task_run_stats(Var arglist, Byte next, void *vdata, Objid progr)
+{
+    Var r;
+
+    free_var(arglist);
+
+    if (!is_wizard(progr))
+	return make_error_pack(E_PERM);
+
+    r = new_list(6);
+    r.v.list[1] = Var::new_int(run_stats.passes);
+    r.v.list[2] = Var::new_int(run_stats.tasks);
+    r.v.list[3] = Var::new_int(run_stats.last_tasks);
+    r.v.list[4] = Var::new_int(run_stats.max_tasks);
+    r.v.list[5] = Var::new_int(run_stats.last_depth);
+    r.v.list[6] = Var::new_int(run_stats.max_depth);
+
+    return make_var_pack(r);
+}
+
 static package
 bf_task_id(Var arglist, Byte next, void *vdata, Objid progr)
 {
@@ -2246,7 +2443,7 @@ list_for_forked_task(forked_task ft, Objid progr)
     list.v.list[1].type = TYPE_INT;
     list.v.list[1].v.num = ft.id;
     list.v.list[2].type = TYPE_INT;
-    list.v.list[2].v.num = ft.start_time;
+    list.v.list[2].v.num = start_seconds(ft.start_ms);
     list.v.list[3].type = TYPE_INT;
     list.v.list[3].v.num = 0;			/* OBSOLETE: was clock ID */
     list.v.list[4].type = TYPE_INT;
@@ -2312,7 +2509,7 @@ list_for_suspended_task(suspended_task st, Objid progr)
 
     list = list_for_vm(st.the_vm, progr);
     list.v.list[2].type = TYPE_INT;
-    list.v.list[2].v.num = st.start_time;
+    list.v.list[2].v.num = start_seconds(st.start_ms);
 
     return list;
 }
@@ -2377,8 +2574,8 @@ bf_queued_tasks(Var arglist, Byte next, void *vdata, Objid progr)
     Var tasks;
     int show_all = is_wizard(progr);
     tqueue *tq;
-    task *t;
-    int i, count = 0;
+    task *t, **sorted;
+    int i, w, count = 0;
     ext_queue *eq;
     struct qcl_data qdata;
 
@@ -2399,9 +2596,9 @@ bf_queued_tasks(Var arglist, Byte next, void *vdata, Objid progr)
 		count++;
     }
 
-    for (t = waiting_tasks; t; t = t->next)
+    for (w = 0; w < num_waiting; w++)
 	if (show_all
-	    || (t->kind == TASK_FORKED
+	    || ((t = waiting_tasks[w])->kind == TASK_FORKED
 		? t->t.forked.a.progr == progr
 		: progr_of_cur_verb(t->t.suspended.the_vm) == progr))
 	    count++;
@@ -2441,7 +2638,9 @@ bf_queued_tasks(Var arglist, Byte next, void *vdata, Objid progr)
 						            progr);
     }
 
-    for (t = waiting_tasks; t; t = t->next) {
+    sorted = sorted_waiting_tasks();
+    for (w = 0; w < num_waiting; w++) {
+	t = sorted[w];
 	if (t->kind == TASK_FORKED && (show_all ||
 				       t->t.forked.a.progr == progr))
 	    tasks.v.list[i++] = list_for_forked_task(t->t.forked,
@@ -2452,6 +2651,8 @@ bf_queued_tasks(Var arglist, Byte next, void *vdata, Objid progr)
 	    tasks.v.list[i++] = list_for_suspended_task(t->t.suspended,
 						        progr);
     }
+    if (sorted)
+	myfree(sorted, M_TASK);
 
     qdata.tasks = tasks;
     qdata.i = i;
@@ -2480,15 +2681,17 @@ finding_closure(vm the_vm, const char *status, void *data)
 }
 
 vm
-find_suspended_task(int id)
+find_suspended_task(Num id)
 {
     tqueue *tq;
     task *t;
     ext_queue *eq;
     struct fcl_data fdata;
+    int w;
 
-    for (t = waiting_tasks; t; t = t->next)
-	if (t->kind == TASK_SUSPENDED && t->t.suspended.the_vm->task_id == id)
+    for (w = 0; w < num_waiting; w++)
+	if ((t = waiting_tasks[w])->kind == TASK_SUSPENDED
+	    && t->t.suspended.the_vm->task_id == id)
 	    return t->t.suspended.the_vm;
 
     for (tq = idle_tqueues; tq; tq = tq->next)
@@ -2543,16 +2746,16 @@ killing_closure(vm the_vm, const char *status, void *data)
 }
 
 static enum error
-kill_task(int id, Objid owner)
+kill_task(Num id, Objid owner)
 {
-    task **tt;
     tqueue *tq;
+    int w;
 
     if (id == current_task_id) {
 	return E_NONE;
     }
-    for (tt = &waiting_tasks; *tt; tt = &((*tt)->next)) {
-	task *t = *tt;
+    for (w = 0; w < num_waiting; w++) {
+	task *t = waiting_tasks[w];
 	Objid progr;
 
 	if (t->kind == TASK_FORKED && t->t.forked.id == id)
@@ -2568,7 +2771,7 @@ kill_task(int id, Objid owner)
 	tq = find_tqueue(progr, 0);
 	if (tq)
 	    tq->num_bg_tasks--;
-	*tt = t->next;
+	dequeue_waiting(w);
 	free_task(t, 1);
 	return E_NONE;
     }
@@ -2587,6 +2790,7 @@ kill_task(int id, Objid owner)
     }
 
     for (tq = active_tqueues; tq; tq = tq->next) {
+	task **tt;
 
 	if (tq->reading && tq->reading_vm->task_id == id) {
 	    if (!is_wizard(owner) && owner != tq->player)
@@ -2640,7 +2844,7 @@ kill_task(int id, Objid owner)
 static package
 bf_kill_task(Var arglist, Byte next, void *vdata, Objid progr)
 {
-    int id = arglist.v.list[1].v.num;
+    Num id = arglist.v.list[1].v.num;
     enum error e = kill_task(id, progr);
 
     free_var(arglist);
@@ -2653,15 +2857,16 @@ bf_kill_task(Var arglist, Byte next, void *vdata, Objid progr)
 }
 
 static enum error
-do_resume(int id, Var value, Objid progr)
+do_resume(Num id, Var value, Objid progr)
 {
-    task **tt;
     tqueue *tq;
+    task *t;
+    int w;
 
-    for (tt = &waiting_tasks; *tt; tt = &((*tt)->next)) {
-	task *t = *tt;
+    for (w = 0; w < num_waiting; w++) {
 	Objid owner;
 
+	t = waiting_tasks[w];
 	if (t->kind == TASK_SUSPENDED && t->t.suspended.the_vm->task_id == id)
 	    owner = progr_of_cur_verb(t->t.suspended.the_vm);
 	else
@@ -2669,20 +2874,18 @@ do_resume(int id, Var value, Objid progr)
 
 	if (!is_wizard(progr) && progr != owner)
 	    return E_PERM;
-	t->t.suspended.start_time = time(0);	/* runnable now */
+	dequeue_waiting(w);
+	t->t.suspended.start_ms = task_clock();	/* runnable now */
 	free_var(t->t.suspended.value);
 	t->t.suspended.value = value;
 	tq = find_tqueue(owner, 1);
-	*tt = t->next;
 	ensure_usage(tq);
 	enqueue_bg_task(tq, t);
 	return E_NONE;
     }
 
     for (tq = active_tqueues; tq; tq = tq->next) {
-	for (tt = &(tq->first_bg); *tt; tt = &((*tt)->next)) {
-	    task *t = *tt;
-
+	for (t = tq->first_bg; t; t = t->next) {
 	    if (t->kind == TASK_SUSPENDED
 		&& t->t.suspended.the_vm->task_id == id) {
 		if (!is_wizard(progr) && progr != tq->player)
@@ -2891,6 +3094,7 @@ register_tasks(void)
     register_function("output_delimiters", 1, 1, bf_output_delimiters,
 		      TYPE_OBJ);
     register_function("queue_info", 0, 1, bf_queue_info, TYPE_OBJ);
+    register_function("task_run_stats", 0, 0, bf_task_run_stats);
     register_function("resume", 1, 2, bf_resume, TYPE_INT, TYPE_ANY);
     register_function("force_input", 2, 3, bf_force_input,
 		      TYPE_OBJ, TYPE_STR, TYPE_ANY);
@@ -38,9 +38,10 @@ extern int tasks_set_connection_option(task_queue, const char *,
 extern void new_input_task(task_queue, const char *, int);
 extern void task_suspend_input(task_queue);
 extern enum error enqueue_forked_task2(activation a, int f_index,
-			       unsigned after_seconds, int vid);
+			       double after_seconds, int vid);
 extern enum error enqueue_suspended_task(vm the_vm, void *data);
-				/* data == &(int after_seconds) */
+				/* data == &(double after_seconds), where a
+				 * negative value means `forever' */
 extern enum error make_reading_task(vm the_vm, void *data);
 				/* data == &(Objid connection) */
 extern enum error make_parsing_http_request_task(vm the_vm, void *data);
@@ -55,7 +56,7 @@ extern void resume_task(vm the_vm, Var value);
 				 * is TYPE_ERR, then VALUE is raised instead of
 				 * returned.
 				 */
-extern vm find_suspended_task(int id);
+extern vm find_suspended_task(Num id);
 
 /* External task queues:
 
@@ -84,6 +85,10 @@ extern void register_task_queue(task_enumerator);
 extern Var read_input_now(Objid connection);
 
 extern int next_task_start(void);
+				/* Returns the number of milliseconds until
+				 * a task will be ready to run, or -1 if
+				 * there's nothing waiting.
+				 */
 extern void run_ready_tasks(void);
 extern enum outcome run_server_task(Objid player, Var what,
 				    const char *verb, Var args,
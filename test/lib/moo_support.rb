@@ -515,6 +515,13 @@ module MooSupport
     simplify command %Q|; return disassemble(#{obj_ref(object)}, #{value_ref(verb)});|
   end
 
+  def object_with_verb(verb, code)
+    object = create(:nothing)
+    add_verb(object, ['player', 'xd', verb], ['this', 'none', 'this'])
+    set_verb_code(object, verb, code)
+    object
+  end
+
   ## Operations on Network Connections
 
   def read(connection = nil, non_blocking = nil)
@@ -623,6 +630,14 @@ module MooSupport
     simplify command %|; return verb_cache_stats();|
   end
 
+  def property_cache_stats
+    simplify command %|; return property_cache_stats();|
+  end
+
+  def verb_compilation_stats
+    simplify command %|; return verb_compilation_stats();|
+  end
+
   ## FileIO Operations
 
   def file_version
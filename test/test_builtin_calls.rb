@@ -0,0 +1,28 @@
+require 'test_helper'
+
+class TestBuiltinCalls < Test::Unit::TestCase
+
+  def test_that_builtin_function_calls_decompile_and_run_the_same_with_or_without_splicing
+    run_test_as('programmer') do
+      code = [
+        %Q|l = {1, 2, 3};|,
+        %Q|return {length(l), length(@{l}), typeof(l) == LIST, is_member(2, l), is_member(@{2, l}), valid(this), `length(1) ! ANY', `length() ! ANY', `is_member(1, 2) ! ANY'};|
+      ]
+      o = object_with_verb('foo', code)
+      assert_equal code, verb_code(o, 'foo')
+      assert_equal [3, 3, 1, 2, 2, 1, E_TYPE, E_ARGS, E_INVARG], call(o, 'foo')
+    end
+  end
+
+  def test_that_builtin_function_calls_check_their_arguments
+    run_test_as('programmer') do
+      code = [
+        %Q|return {`abs("a") ! ANY', `abs() ! ANY', `abs(1, 2) ! ANY', abs(-2), `abs(@{"a"}) ! ANY', abs(@{-2})};|
+      ]
+      o = object_with_verb('foo', code)
+      assert_equal code, verb_code(o, 'foo')
+      assert_equal [E_TYPE, E_ARGS, E_ARGS, 2, E_TYPE, 2], call(o, 'foo')
+    end
+  end
+
+end
@@ -25,8 +25,8 @@ class TestCannedDbs < Test::Unit::TestCase
     diff.readlines.map(&:chomp)
   end
 
-  def log_and_diff(original, backup)
-    _, _, log, wait = Open3.popen3 %[./moo #{original} #{backup} 9899]
+  def log_and_diff(original, backup, server = './moo')
+    _, _, log, wait = Open3.popen3 %[#{server} #{original} #{backup} 9899]
     wait.value
 
     _, diff, _, wait = Open3.popen3 %[diff #{original} #{backup}]
@@ -210,4 +210,43 @@ class TestCannedDbs < Test::Unit::TestCase
     assert log.any? { |l| l =~ /#2 not in it's content's \(#3\) location/ }
   end
 
+  def test_that_tasks_suspended_in_built_in_function_overrides_resume_after_a_restart
+    ['./moo', './moo --db-format binary'].each do |server|
+      log1, _ = log_and_diff('test/Suspended2.db', '/tmp/Foo.db', server)
+      log2, _ = log_and_diff('/tmp/Foo.db', '/tmp/Bar.db', server)
+
+      assert log1.any? { |l| l =~ /> suspended: 3$/ }
+      assert log2.any? { |l| l =~ /> abs: \{"before", \{"bf_abs", -3\}, "after"\}$/ }
+      assert log2.any? { |l| l =~ /> length: \{"before", \{"bf_length", "abcd"\}, "after"\}$/ }
+      assert log2.any? { |l| l =~ /> tostr: \{"before", \{"bf_tostr", 1, "a"\}, "after"\}$/ }
+    end
+  end
+
+  # `make moo_lazy' builds a server with LAZY_VERB_COMPILATION defined.
+  def test_that_verbs_are_compiled_lazily_when_first_called
+    log1, _ = log_and_diff('test/Lazy1.db', '/tmp/Foo.db', './moo_lazy')
+    log2, _ = log_and_diff('/tmp/Foo.db', '/tmp/Bar.db', './moo_lazy')
+
+    stats = [
+      '> before: {1, 3, 0}',
+      '> double: 42',
+      '> after: {2, 2, 0}',
+      '> double: 8',
+      '> again: {2, 2, 0}',
+      '> broken: 0',
+      '> failed: {2, 2, 1}',
+      '> code: {"return args[1] * 2;"}'
+    ]
+
+    assert log1.any? { |l| l =~ /Compilation of 4 verb programs deferred until use/ }
+    assert log1.map { |l| l.sub(/^.*?: > /, '> ') }.include_sequence? stats
+    assert log1.any? { |l| l =~ /Error in #0:broken/ }
+
+    # the verbs that weren't called, including the broken one, were
+    # dumped from their text and are still pending after a reload
+    assert log2.any? { |l| l =~ /Compilation of 4 verb programs deferred until use/ }
+    assert log2.map { |l| l.sub(/^.*?: > /, '> ') }.include_sequence? stats
+    assert File.read('/tmp/Foo.db').include? %Q|#0:2\nreturn "never called";\n.\n#0:3\nreturn (1;\n.\n|
+  end
+
 end
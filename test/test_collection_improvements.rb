@@ -190,4 +190,41 @@ class TestCollectionImprovements < Test::Unit::TestCase
     end
   end
 
+  def test_that_appending_in_place_does_not_affect_other_references
+    run_test_as('programmer') do
+      o = create(:nothing)
+      add_verb(o, [player, 'xd', 'foobar'], ['this', 'none', 'this'])
+      set_verb_code(o, 'foobar') do |vc|
+        vc << 'x = {};'
+        vc << 'for i in [1..100]'
+        vc << 'x = {@x, i};'
+        vc << 'endfor'
+        vc << 'y = x;'
+        vc << 'x = {@x, 101};'
+        vc << 'z = x;'
+        vc << 'x = listinsert(x, 0, 1);'
+        vc << 'x = {@x, @{102, 103}};'
+        vc << 'return {length(x), length(y), length(z), x[1], x[$], y[$], z[$]};'
+      end
+      assert_equal [104, 100, 101, 0, 103, 100, 101], call(o, 'foobar')
+    end
+  end
+
+  def test_that_value_bytes_is_correct_for_lists_built_in_place
+    run_test_as('programmer') do
+      o = create(:nothing)
+      add_verb(o, [player, 'xd', 'foobar'], ['this', 'none', 'this'])
+      set_verb_code(o, 'foobar') do |vc|
+        vc << 'x = {};'
+        vc << 'for i in [1..50]'
+        vc << 'value_bytes(x);'
+        vc << 'x = {@x, @{i, "abc", {i}}};'
+        vc << 'x = listappend(x, 1.5);'
+        vc << 'endfor'
+        vc << 'return value_bytes(x) == value_bytes(eval("return " + toliteral(x) + ";")[2]);'
+      end
+      assert_equal 1, call(o, 'foobar')
+    end
+  end
+
 end
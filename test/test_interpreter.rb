@@ -0,0 +1,27 @@
+require 'test_helper'
+
+class TestInterpreter < Test::Unit::TestCase
+
+  def test_that_intrinsic_functions_decompile_and_honor_protection
+    run_test_as('wizard') do
+      code = [%Q|return {listappend(args, 3), tostr(), tostr(1, "a"), length(args)};|]
+      o = object_with_verb('foo', code)
+      assert_equal code, verb_code(o, 'foo')
+      assert_equal [[1, 2, 3], '', '1a', 2], call(o, 'foo', 1, 2)
+      begin
+        evaluate('add_property($server_options, "protect_length", 1, {player, "r"})')
+        add_verb(0, ['player', 'xd', 'bf_length'], ['this', 'none', 'this'])
+        set_verb_code(0, 'bf_length') do |vc|
+          vc << %Q|return -1;|
+        end
+        evaluate('load_server_options()')
+        assert_equal [[1, 2, 3], '', '1a', -1], call(o, 'foo', 1, 2)
+      ensure
+        evaluate('delete_property($server_options, "protect_length")')
+        evaluate('delete_verb(#0, "bf_length")')
+        evaluate('load_server_options()')
+      end
+    end
+  end
+
+end
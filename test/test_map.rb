@@ -203,4 +203,13 @@ class TestMap < Test::Unit::TestCase
     end
   end
 
+
+  def test_that_large_maps_work
+    run_test_as('programmer') do
+      assert_equal [500, 7, 499, E_RANGE], simplify(command(%Q|; x = []; for i in [1..500]; x[tostr("Key", i)] = i; endfor; return {length(x), x["key7"], x["KEY499"], `x["key501"] ! E_RANGE'};|))
+      assert_equal [300, "seven", 300, 1], simplify(command(%Q|; x = []; for i in [1..300]; x[i] = i; x[tostr(i)] = "a"; endfor; x[7] = "seven"; for i in [1..300]; x = mapdelete(x, tostr(i)); endfor; return {length(x), x[7], x[300], mapkeys(x)[1]};|))
+      assert_equal({1.5 => 'a', 'b' => 2}, simplify(command(%Q|; x = []; for i in [1..200]; x[i] = i; endfor; x[1.5] = "a"; x["B"] = 2; for i in [1..200]; x = mapdelete(x, i); endfor; x["b"] = 2; return x;|)))
+    end
+  end
+
 end
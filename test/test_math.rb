@@ -23,6 +23,34 @@ class TestMath < Test::Unit::TestCase
     end
   end
 
+  def test_that_random_covers_ranges_wider_than_32_bits
+    run_test_as('programmer') do
+      # only meaningful when the server was built with INT64_NUM
+      if simplify(command(%Q|; return 2147483647 + 1 > 0;|)) == 1
+        rs = simplify(command(%Q|; r = {}; for i in [1..200] r = {@r, random(1099511627776)}; endfor return r;|))
+        assert rs.all? { |r| r >= 1 && r <= 1099511627776 }
+        assert rs.any? { |r| r > 4294967296 }
+      end
+    end
+  end
+
+  def test_that_builtins_do_not_truncate_wide_integer_arguments
+    run_test_as('programmer') do
+      # only meaningful when the server was built with INT64_NUM
+      if simplify(command(%Q|; return 2147483647 + 1 > 0;|)) == 1
+        assert_equal E_RANGE, simplify(command(%Q|; return listset({1, 2, 3}, 9, 4294967297);|))
+        assert_equal [1, 2, 3], simplify(command(%Q|; return listappend({1, 2}, 3, 4294967297);|))
+        assert_equal [1, 2, 3], simplify(command(%Q|; return listinsert({1, 2}, 3, 9223372036854775807);|))
+        assert_equal [3, 1, 2], simplify(command(%Q|; return listappend({1, 2}, 3, -4294967297);|))
+        assert_equal E_INVARG, simplify(command(%Q|; return random_bytes(4294967297);|))
+        assert_equal '1.5000000000000000000', simplify(command(%Q|; return floatstr(1.5, 4294967300);|))
+        assert_equal E_INVARG, simplify(command(%Q|; return kill_task(4294967296 + task_id());|))
+        assert_equal E_INVARG, simplify(command(%Q|; return resume(4294967296 + task_id());|))
+        assert_equal E_INVARG, simplify(command(%Q|; return task_stack(4294967296 + task_id());|))
+      end
+    end
+  end
+
   def test_that_random_requires_a_positive_integer
     run_test_as('programmer') do
       assert_equal E_INVARG, random(-1)
@@ -37,4 +37,72 @@ class TestMiscellaneous < Test::Unit::TestCase
     end
   end
 
+  def test_that_fork_and_suspend_accept_fractional_seconds
+    run_test_as('programmer') do
+      o = create(:nothing)
+      add_property(o, 'l', [], ['player', 'rw'])
+
+      assert_equal 1, simplify(command(%Q|; suspend(0.1); return 1; |))
+      assert_equal E_INVARG, simplify(command(%Q|; suspend(-0.5); |))
+      assert_equal E_INVARG, simplify(command(%Q|; fork (-0.5) endfork |))
+      assert_equal E_TYPE, simplify(command(%Q|; fork ("1") endfork |))
+      assert_equal [3, 2, 1], simplify(command(%Q|; for i in [1..3] fork (0.1 * tofloat(4 - i)) #{o}.l = {@#{o}.l, i}; endfork endfor suspend(0.5); return #{o}.l; |))
+    end
+  end
+
+  def test_that_connection_output_stats_counts_writes_and_bytes
+    run_test_as('wizard') do
+      assert_equal E_INVARG, simplify(command(%Q|; return connection_output_stats(#0); |))
+      writes, bytes = simplify(command(%Q|; return connection_output_stats(player); |))
+      assert writes > 0
+      assert bytes > 0
+    end
+  end
+
+  def test_that_open_network_connection_suspends_until_the_connection_is_made
+    run_test_as('wizard') do
+      c = simplify(command(%Q|; return open_network_connection("#{options['host']}", #{options['port']}); |))
+      assert c.to_s.start_with?('#-')
+      assert_equal 1, simplify(command(%Q|; return #{c} in connected_players(1); |))
+      simplify(command(%Q|; boot_player(#{c}); |))
+      o = create(:nothing)
+      add_property(o, 'l', [], ['player', 'rw'])
+      simplify(command(%Q|; for i in [1..3] fork (0) c = open_network_connection("#{options['host']}", #{options['port']}); #{o}.l = {@#{o}.l, c}; endfork endfor |))
+      assert_equal 3, simplify(command(%Q|; suspend(1); return length(#{o}.l); |))
+      simplify(command(%Q|; for c in (#{o}.l) boot_player(c); endfor |))
+      assert_equal E_INVARG, simplify(command(%Q|; return open_network_connection("#{options['host']}", 1); |))
+      assert_equal E_TYPE, simplify(command(%Q|; return open_network_connection("#{options['host']}", "#{options['port']}"); |))
+    end
+  end
+
+  def test_that_open_network_connection_works_after_a_connect_times_out
+    # A listener with a full backlog never completes another connect.
+    full = Socket.new(:INET, :STREAM)
+    full.bind(Addrinfo.tcp('127.0.0.1', 0))
+    full.listen(0)
+    address = full.local_address
+    fillers = (1..4).map do
+      f = Socket.new(:INET, :STREAM)
+      begin
+        f.connect_nonblock(address)
+      rescue IO::WaitWritable, Errno::EISCONN
+      end
+      f
+    end
+    run_test_as('wizard') do
+      evaluate('add_property($server_options, "outbound_connect_timeout", 1, {player, "r"})')
+      begin
+        r = simplify(command(%Q|; r = {`open_network_connection("127.0.0.1", #{address.ip_port}) ! ANY'}; for i in [1..3] r = {@r, `open_network_connection("#{options['host']}", #{options['port']}) ! ANY'}; endfor return r; |))
+        assert_equal E_INVARG, r[0]
+        r[1..-1].each { |c| assert c.to_s.start_with?('#-') }
+        simplify(command(%Q|; for c in ({#{r[1..-1].map(&:to_s).join(', ')}}) boot_player(c); endfor |))
+      ensure
+        evaluate('delete_property($server_options, "outbound_connect_timeout")')
+      end
+    end
+  ensure
+    fillers.each(&:close)
+    full.close
+  end
+
 end
@@ -0,0 +1,42 @@
+require 'test_helper'
+
+class TestOptimizer < Test::Unit::TestCase
+
+  def test_that_optimized_code_decompiles_to_equivalent_code_and_runs
+    run_test_as('wizard') do
+      code = [
+        'r = {};',
+        'unused = 2 * 3 + 1;',
+        'for i in [1..3]',
+        '  if (i == 1)',
+        '    r = {@r, -(4 - 10) % 4};',
+        '  elseif (i == 2)',
+        %Q|    r = {@r, `1 / 0 ! ANY'};|,
+        '  else',
+        '    r = {@r, i};',
+        '  endif',
+        'endfor',
+        'return r;'
+      ]
+      begin
+        evaluate('add_property($server_options, "optimize_bytecode", 1, {player, "r"})')
+        evaluate('load_server_options()')
+        o = object_with_verb('foo', code)
+        optimized = code.dup
+        optimized[1] = '7;'
+        optimized[4] = '    r = {@r, 2};'
+        assert_equal optimized, verb_code(o, 'foo')
+        assert_equal [2, E_DIV, 3], call(o, 'foo')
+        set_verb_code(o, 'foo', verb_code(o, 'foo'))
+        assert_equal optimized, verb_code(o, 'foo')
+        assert_equal [2, E_DIV, 3], call(o, 'foo')
+      ensure
+        evaluate('delete_property($server_options, "optimize_bytecode")')
+        evaluate('load_server_options()')
+      end
+      o = object_with_verb('foo', ['unused = 2 * 3 + 1;'])
+      assert_equal ['unused = 2 * 3 + 1;'], verb_code(o, 'foo')
+    end
+  end
+
+end
@@ -0,0 +1,28 @@
+require 'test_helper'
+
+class TestPropertyCache < Test::Unit::TestCase
+
+  def test_that_cached_lookups_see_changes_to_inherited_values
+    run_test_as('wizard') do
+      assert_equal [1, 1, 1, 2, 3, 2, 1], simplify(command(%Q|; a = create($nothing); b = create(a); c = create(b); add_property(a, "foo", 1, {player, "rw"}); r = {}; for i in [1..3] r = {@r, c.foo}; endfor; b.foo = 2; r = {@r, c.foo}; c.foo = 3; r = {@r, c.foo}; clear_property(c, "foo"); r = {@r, c.foo}; clear_property(b, "foo"); r = {@r, c.foo}; return r;|))
+      assert_equal [42, 42, 7, 42], simplify(command(%Q|; a = create($nothing); b = create(a); c = create(b); d = create(c); e = create(d); f = create(e); add_property(a, "deep", 42, {player, "r"}); r = {f.deep, f.deep}; c.deep = 7; r = {@r, f.deep}; clear_property(c, "deep"); r = {@r, f.deep}; return r;|))
+    end
+  end
+
+  def test_that_cached_lookups_see_changes_to_property_definitions
+    run_test_as('wizard') do
+      assert_equal [1, 1, E_PROPNF, 1], simplify(command(%Q|; a = create($nothing); add_property(a, "foo", 1, {player, "rw"}); r = {}; for i in [1..2] r = {@r, a.foo}; endfor; set_property_info(a, "foo", {player, "rw", "bar"}); r = {@r, `a.foo ! ANY', a.bar}; return r;|))
+      assert_equal ['ax', 'ax', 'dx', 'dx'], simplify(command(%Q|; a = create($nothing); b = create(a); add_property(a, "x", "ax", {player, ""}); d = create($nothing); add_property(d, "x", "dx", {player, ""}); r = {}; for o in ({b, b}) r = {@r, o.x}; endfor; delete_property(a, "x"); chparent(b, d); for o in ({b, b}) r = {@r, o.x}; endfor; return r;|))
+    end
+  end
+
+  def test_that_repeated_lookups_hit_the_cache
+    run_test_as('wizard') do
+      x = property_cache_stats
+      simplify(command(%Q|; a = create($nothing); add_property(a, "p", 0, {player, "rw"}); for i in [1..10] a.p; endfor;|))
+      y = property_cache_stats
+      assert y[0] - x[0] >= 9
+    end
+  end
+
+end
@@ -151,4 +151,23 @@ class TestStringOperations < Test::Unit::TestCase
     end
   end
 
+  def test_that_appending_to_a_string_does_not_affect_other_references
+    run_test_as('programmer') do
+      o = create(:nothing)
+      add_verb(o, [player, 'xd', 'foobar'], ['this', 'none', 'this'])
+      set_verb_code(o, 'foobar') do |vc|
+        vc << 's = "";'
+        vc << 'for i in [1..100]'
+        vc << 's = s + tostr(i % 10);'
+        vc << 'endfor'
+        vc << 't = s;'
+        vc << 's = s + "abc";'
+        vc << 'u = s;'
+        vc << 's = s + "def";'
+        vc << 'return {length(s), length(t), length(u), s[$ - 5..$], u[$ - 2..$], t[$ - 2..$]};'
+      end
+      assert_equal [106, 100, 103, 'abcdef', 'abc', '890'], call(o, 'foobar')
+    end
+  end
+
 end
@@ -32,4 +32,29 @@ class TestSystemBuiltins < Test::Unit::TestCase
     end
   end
 
+  def test_that_memory_usage_reports_live_and_peak_bytes
+    run_test_as('wizard') do
+      types, pools = simplify(command(%Q|; return memory_usage();|))
+      assert_equal ['string', 'list', 'map', 'task', 'network'], types.map { |t| t[0] }
+      types.each do |name, blocks, bytes, peak|
+        assert blocks >= 0
+        assert bytes >= 0
+        assert peak >= bytes
+      end
+      pools.each do |size, used, free|
+        assert size > 0
+        assert used >= 0
+        assert free >= 0
+      end
+    end
+  end
+
+  def test_that_memory_usage_tracks_the_high_water_mark
+    run_test_as('wizard') do
+      before = simplify(command(%Q|; return memory_usage()[1][1];|))
+      after = simplify(command(%Q|; s = ""; for i in [1..1000] s = s + "0123456789"; endfor return memory_usage()[1][1];|))
+      assert after[3] >= before[2] + 10000
+    end
+  end
+
 end
@@ -27,4 +27,48 @@ class TestVerbCache < Test::Unit::TestCase
     end
   end
 
+  def test_that_changing_an_unrelated_object_does_not_clear_the_verb_cache
+    run_test_as('wizard') do
+      a = create(:nothing)
+      b = create(:nothing)
+      add_verb(a, [player, 'xd', 'test'], ['this', 'none', 'this'])
+      set_verb_code(a, 'test', ['return "a";'])
+      add_verb(b, [player, 'xd', 'test'], ['this', 'none', 'this'])
+      set_verb_code(b, 'test', ['return "b";'])
+
+      assert_equal 'a', call(a, 'test')
+      x = verb_cache_stats()
+      assert_equal 'a', call(a, 'test')
+      y = verb_cache_stats()
+      assert_equal 1, y[0] - x[0]
+
+      add_verb(b, [player, 'xd', 'other'], ['this', 'none', 'this'])
+      y = verb_cache_stats()
+      assert_equal 'a', call(a, 'test')
+      z = verb_cache_stats()
+      assert_equal 1, z[0] - y[0]
+      assert_equal y[2], z[2]
+    end
+  end
+
+  def test_that_changing_an_ancestor_evicts_cached_lookups
+    run_test_as('wizard') do
+      a = create(:nothing)
+      b = create(a)
+      add_verb(a, [player, 'xd', 'test'], ['this', 'none', 'this'])
+      set_verb_code(a, 'test', ['return "a";'])
+
+      assert_equal 'a', call(b, 'test')
+      x = verb_cache_stats()
+      set_verb_code(a, 'test', ['return "a";'])
+      add_verb(a, [player, 'xd', 'other'], ['this', 'none', 'this'])
+      y = verb_cache_stats()
+      assert_equal 1, y[5][0][1] - x[5][0][1]
+
+      add_verb(b, [player, 'xd', 'test'], ['this', 'none', 'this'])
+      set_verb_code(b, 'test', ['return "b";'])
+      assert_equal 'b', call(b, 'test')
+    end
+  end
+
 end
@@ -0,0 +1,41 @@
+require 'test_helper'
+
+class TestVerbCompilation < Test::Unit::TestCase
+
+  def test_that_verbs_loaded_from_the_database_can_be_listed_and_called
+    run_test_as('wizard') do
+      code = simplify(command(%Q|; return verb_code(#0, 1);|))
+      assert_kind_of Array, code
+      assert code.length > 0
+    end
+  end
+
+  def test_that_verb_compilation_stats_returns_counts
+    run_test_as('wizard') do
+      stats = verb_compilation_stats
+      assert_equal 3, stats.length
+      stats.each { |n| assert n >= 0 }
+    end
+  end
+
+  def test_that_verbs_compiled_at_runtime_are_not_counted_as_pending
+    run_test_as('wizard') do
+      x = verb_compilation_stats
+      o = create(:nothing)
+      add_verb(o, ['player', 'xd', 'foo'], ['this', 'none', 'this'])
+      set_verb_code(o, 'foo') do |vc|
+        vc << %Q|return 42;|
+      end
+      assert_equal 42, call(o, 'foo')
+      y = verb_compilation_stats
+      assert_equal x[1], y[1]
+    end
+  end
+
+  def test_that_verb_compilation_stats_is_wizardly
+    run_test_as('programmer') do
+      assert_equal E_PERM, simplify(command(%Q|; return verb_compilation_stats();|))
+    end
+  end
+
+end
@@ -275,6 +275,23 @@ cancel_timer(Timer_ID id)
     return found;
 }
 
+int64_t
+monotonic_msecs(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+    {
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+}
+
 void
 reenable_timers(void)
 {
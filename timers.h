@@ -18,6 +18,8 @@
 #ifndef Timers_H
 #define Timers_H 1
 
+#include <stdint.h>
+
 #include "my-time.h"
 
 typedef int Timer_ID;
@@ -32,4 +34,12 @@ extern unsigned timer_wakeup_interval(Timer_ID);
 extern void timer_sleep(unsigned seconds);
 extern int virtual_timer_available();
 
+extern int64_t monotonic_msecs(void);
+				/* Milliseconds on a clock that never goes
+				 * backwards (or jumps when the system time
+				 * is set), from some arbitrary starting
+				 * point.  Good for measuring intervals and
+				 * setting deadlines, not for telling time.
+				 */
+
 #endif				/* !Timers_H */
@@ -179,10 +179,6 @@ complex_free_var(Var v)
 	if (v.v.str)
 	    free_str(v.v.str);
 	break;
-    case TYPE_FLOAT:
-	if (delref(v.v.fnum) == 0)
-	    myfree(v.v.fnum, M_FLOAT);
-	break;
     case TYPE_LIST:
 	if (delref(v.v.list) == 0) {
 	    destroy_list(v);
@@ -249,10 +245,6 @@ complex_free_var(Var v)
 	if (v.v.str)
 	    free_str(v.v.str);
 	break;
-    case TYPE_FLOAT:
-	if (delref(v.v.fnum) == 0)
-	    myfree(v.v.fnum, M_FLOAT);
-	break;
     case TYPE_LIST:
 	if (delref(v.v.list) == 0)
 	    destroy_list(v);
@@ -293,9 +285,6 @@ complex_var_ref(Var v)
     case TYPE_STR:
 	addref(v.v.str);
 	break;
-    case TYPE_FLOAT:
-	addref(v.v.fnum);
-	break;
     case TYPE_LIST:
 	addref(v.v.list);
 	break;
@@ -323,9 +312,6 @@ complex_var_ref(Var v)
     case TYPE_STR:
 	addref(v.v.str);
 	break;
-    case TYPE_FLOAT:
-	addref(v.v.fnum);
-	break;
     case TYPE_LIST:
 	addref(v.v.list);
 	break;
@@ -351,9 +337,6 @@ complex_var_dup(Var v)
     case TYPE_STR:
 	v.v.str = str_dup(v.v.str);
 	break;
-    case TYPE_FLOAT:
-	v = new_float(*v.v.fnum);
-	break;
     case TYPE_LIST:
 	v = list_dup(v);
 	break;
@@ -389,9 +372,6 @@ var_refcount(Var v)
     case TYPE_ITER:
 	return refcount(v.v.trav);
 	break;
-    case TYPE_FLOAT:
-	return refcount(v.v.fnum);
-	break;
     case TYPE_ANON:
 	if (v.v.anon)
 	    return refcount(v.v.anon);
@@ -404,7 +384,7 @@ int
 is_true(Var v)
 {
     return ((v.type == TYPE_INT && v.v.num != 0)
-	    || (v.type == TYPE_FLOAT && *v.v.fnum != 0.0)
+	    || (v.type == TYPE_FLOAT && v.v.fnum != 0.0)
 	    || (v.type == TYPE_STR && v.v.str && *v.v.str != '\0')
 	    || (v.type == TYPE_LIST && v.v.list[0].v.num != 0)
 	    || (v.type == TYPE_MAP && !mapempty(v)));
@@ -421,9 +401,9 @@ compare(Var lhs, Var rhs, int case_matters)
     if (lhs.type == rhs.type) {
 	switch (lhs.type) {
 	case TYPE_INT:
-	    return lhs.v.num - rhs.v.num;
+	    return compare_integers(lhs.v.num, rhs.v.num);
 	case TYPE_OBJ:
-	    return lhs.v.obj - rhs.v.obj;
+	    return compare_integers(lhs.v.obj, rhs.v.obj);
 	case TYPE_ERR:
 	    return lhs.v.err - rhs.v.err;
 	case TYPE_STR:
@@ -437,7 +417,7 @@ compare(Var lhs, Var rhs, int case_matters)
 	    if (lhs.v.fnum == rhs.v.fnum)
 		return 0;
 	    else
-		return *(lhs.v.fnum) - *(rhs.v.fnum);
+		return lhs.v.fnum - rhs.v.fnum;
 	default:
 	    panic("COMPARE: Invalid value type");
 	}
@@ -468,10 +448,7 @@ equality(Var lhs, Var rhs, int case_matters)
 	    else
 		return !mystrcasecmp(lhs.v.str, rhs.v.str);
 	case TYPE_FLOAT:
-	    if (lhs.v.fnum == rhs.v.fnum)
-		return 1;
-	    else
-		return *(lhs.v.fnum) == *(rhs.v.fnum);
+	    return lhs.v.fnum == rhs.v.fnum;
 	case TYPE_LIST:
 	    return listequal(lhs, rhs, case_matters);
 	case TYPE_MAP:
@@ -607,9 +584,6 @@ value_bytes(Var v)
     case TYPE_STR:
 	size += memo_strlen(v.v.str) + 1;
 	break;
-    case TYPE_FLOAT:
-	size += sizeof(double);
-	break;
     case TYPE_LIST:
 	size += list_sizeof(v.v.list);
 	break;
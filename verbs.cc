@@ -535,7 +535,7 @@ bf_set_verb_code(Var arglist, Byte next, void *vdata, Objid progr)
     }
     program = parse_list_as_program(code, &errors);
     if (program) {
-	if (task_timed_out)
+	if (task_time_is_up())
 	    free_program(program);
 	else
 	    db_set_verb_program(h, program);
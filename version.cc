@@ -238,5 +238,5 @@ server_version_full(Var arg)
 int
 check_db_version(DB_Version version)
 {
-    return version < Num_DB_Versions;
+    return version <= current_db_version;
 }
@@ -76,14 +76,22 @@ typedef enum {
 				 */
     DBV_Anon,			/* Addition of anonymous objects
 				 */
-    Num_DB_Versions		/* Special: the current version is this - 1. */
+    DBV_Num64,			/* Integers and object numbers may not fit
+				 * in 32 bits.  Only written by servers built
+				 * with INT64_NUM.
+				 */
+    Num_DB_Versions		/* Special: the last version is this - 1. */
 } DB_Version;
 
-#define current_db_version	((DB_Version) (Num_DB_Versions - 1))
+#ifdef INT64_NUM
+#define current_db_version	DBV_Num64
+#else
+#define current_db_version	DBV_Anon
+#endif
 
 extern int check_db_version(DB_Version);
 				/* Returns true iff given version is within the
-				 * known range.
+				 * range this server can read.
 				 */
 
 #endif				/* !Version_H */
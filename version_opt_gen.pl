@@ -55,7 +55,9 @@ my @options =
 
    # optimizations
    _DDEF => [qw(UNFORKED_CHECKPOINTS
+		LAZY_VERB_COMPILATION
 		BYTECODE_REDUCE_REF
+		DIRECT_THREADED_DISPATCH
 		STRING_INTERNING
 		MEMO_STRLEN
 		MEMO_VALUE_BYTES
@@ -79,11 +79,21 @@ _DDEF("UNFORKED_CHECKPOINTS")
 #else
 _DNDEF("UNFORKED_CHECKPOINTS")
 #endif
+#ifdef LAZY_VERB_COMPILATION
+_DDEF("LAZY_VERB_COMPILATION")
+#else
+_DNDEF("LAZY_VERB_COMPILATION")
+#endif
 #ifdef BYTECODE_REDUCE_REF
 _DDEF("BYTECODE_REDUCE_REF")
 #else
 _DNDEF("BYTECODE_REDUCE_REF")
 #endif
+#ifdef DIRECT_THREADED_DISPATCH
+_DDEF("DIRECT_THREADED_DISPATCH")
+#else
+_DNDEF("DIRECT_THREADED_DISPATCH")
+#endif
 #ifdef STRING_INTERNING
 _DDEF("STRING_INTERNING")
 #else